@@ -29,6 +29,21 @@ typedef enum {
     EmuiiboVirtualAmiiboStatus_Disconnected,  
 } EmuiiboVirtualAmiiboStatus;
 
+typedef enum {
+    EmuiiboLogLevel_Off,
+    EmuiiboLogLevel_Error,
+    EmuiiboLogLevel_Info,
+    EmuiiboLogLevel_Verbose,
+} EmuiiboLogLevel;
+
+typedef struct {
+    u64 sequence_number;
+    // Only valid when there is an active virtual amiibo
+    u64 active_virtual_amiibo_id;
+    u32 emulation_status;
+    u32 active_virtual_amiibo_status;
+} EmuiiboEmulationStatusSnapshot;
+
 typedef struct {
     u8 major;
     u8 minor;
@@ -44,6 +59,211 @@ NX_CONSTEXPR bool emuiiboVersionMatches(const EmuiiboVersion *ver, u8 major, u8
     return (ver->major == major) && (ver->minor == minor) && (ver->micro == micro);
 }
 
+typedef struct {
+    u32 amiibo_scan_interval_ms;
+    u32 emu_max_sessions;
+    u8 log_level; // EmuiiboLogLevel
+    bool dump_miis_on_boot;
+    bool convert_legacy_amiibos_on_boot;
+    bool update_cache_on_emu_session;
+    bool use_amiibo_metadata_cache;
+    u8 amiibo_scan_thread_count;
+    u8 catalog_cache_page_count;
+    bool persist_emulation_state;
+    u32 emulation_state_flush_delay_ms;
+    u8 reserved[0x2C];
+} EmuiiboSettings;
+
+typedef struct {
+    u64 heap_size;
+    u64 arena_size;
+    u64 arena_peak_size;
+    u64 in_use_size;
+    u64 in_use_peak_size;
+    u64 free_size;
+    u64 free_chunk_count;
+    u64 scratch_size;
+    u64 scratch_peak_size;
+    u64 scratch_fallback_count;
+} EmuiiboHeapStats;
+
+typedef enum {
+    EmuiiboVirtualAmiiboQueryFlag_Series = BIT(0),
+    EmuiiboVirtualAmiiboQueryFlag_GameCharacterId = BIT(1),
+    EmuiiboVirtualAmiiboQueryFlag_FigureType = BIT(2)
+} EmuiiboVirtualAmiiboQueryFlag;
+
+typedef struct {
+    u32 flags;
+    u32 cursor;
+    u8 series;
+    u8 figure_type;
+    u16 game_character_id;
+    char name_prefix[40 + 1];
+    u8 reserved[0xB];
+} EmuiiboVirtualAmiiboQuery;
+
+#define EMUIIBO_VIRTUAL_AMIIBO_QUERY_END_CURSOR UINT32_MAX
+
+typedef enum {
+    EmuiiboVirtualAmiiboFolderItemType_Folder = 0,
+    EmuiiboVirtualAmiiboFolderItemType_VirtualAmiibo = 1
+} EmuiiboVirtualAmiiboFolderItemType;
+
+typedef struct {
+    u64 id;
+    u8 type;
+    u8 reserved[3];
+    char name[0x74];
+} EmuiiboVirtualAmiiboFolderItem;
+
+#define EMUIIBO_ROOT_FOLDER_ID 0
+
+typedef enum {
+    EmuiiboIoSubsystem_Other = 0,
+    EmuiiboIoSubsystem_Areas = 1,
+    EmuiiboIoSubsystem_VirtualAmiibo = 2,
+    EmuiiboIoSubsystem_Mii = 3,
+    EmuiiboIoSubsystem_Locator = 4,
+    EmuiiboIoSubsystem_Settings = 5,
+    EmuiiboIoSubsystem_Log = 6,
+    EmuiiboIoSubsystem_Emulation = 7,
+
+    EmuiiboIoSubsystem_Count
+} EmuiiboIoSubsystem;
+
+typedef struct {
+    u32 stat_count;
+    u32 open_count;
+    u32 read_count;
+    u32 write_count;
+    u32 dir_open_count;
+    u32 dir_entry_count;
+    // Creating or deleting files and directories
+    u32 metadata_count;
+    u32 reserved;
+    u64 read_size;
+    u64 written_size;
+} EmuiiboIoStats;
+
+typedef enum {
+    EmuiiboCommandStatsInterface_Nfp = 0,
+    EmuiiboCommandStatsInterface_Emulation = 1
+} EmuiiboCommandStatsInterface;
+
+#define EMUIIBO_COMMAND_STATS_BUCKET_COUNT 0x10
+
+typedef struct {
+    u32 iface;
+    u32 command_id;
+    u32 count;
+    u32 reserved;
+    u64 total_time_us;
+    u64 max_time_us;
+    // Bucket i holds latencies in [2^i, 2^(i + 1)) microseconds, the last one also holds anything slower
+    u32 buckets[EMUIIBO_COMMAND_STATS_BUCKET_COUNT];
+    EmuiiboIoStats io;
+} EmuiiboCommandStats;
+
+typedef enum {
+    EmuiiboBootPhase_SmInitialize = 0,
+    EmuiiboBootPhase_FsInitialize = 1,
+    EmuiiboBootPhase_SdCardMount = 2,
+    EmuiiboBootPhase_TimeInitialize = 3,
+    EmuiiboBootPhase_HidInitialize = 4,
+    EmuiiboBootPhase_MiiInitialize = 5,
+    EmuiiboBootPhase_Settings = 6,
+    // Entry count: miis dumped
+    EmuiiboBootPhase_MiiDump = 7,
+    // Entry count: directories listed
+    EmuiiboBootPhase_AmiiboScan = 8,
+    // Entry count: legacy virtual amiibos converted
+    EmuiiboBootPhase_LegacyConversion = 9,
+    // Entry count: virtual amiibos in the catalog
+    EmuiiboBootPhase_CatalogBuild = 10,
+    EmuiiboBootPhase_ServiceRegistration = 11,
+    EmuiiboBootPhase_EmulationStateRestore = 12,
+
+    EmuiiboBootPhase_Count
+} EmuiiboBootPhase;
+
+#define EMUIIBO_BOOT_REPORT_MAX_PHASE_COUNT 0x10
+
+typedef struct {
+    // Relative to the start of the first phase
+    u64 start_time_us;
+    u64 duration_us;
+    u32 entry_count;
+    bool done;
+    u8 reserved[3];
+} EmuiiboBootPhaseRecord;
+
+typedef struct {
+    // Since the console booted
+    u64 process_start_time_us;
+    // Relative to the start of the first phase, the library is initialized after this
+    u64 services_registered_time_us;
+    // Zero until the boot finishes
+    u64 total_time_us;
+    u32 phase_count;
+    u32 reserved;
+    // Indexed by EmuiiboBootPhase
+    EmuiiboBootPhaseRecord phases[EMUIIBO_BOOT_REPORT_MAX_PHASE_COUNT];
+} EmuiiboBootReport;
+
+typedef enum {
+    // When the active virtual amiibo is connected again after being disconnected
+    EmuiiboPlaylistAdvanceFlag_Reconnect = BIT(0),
+    // When a title stops scanning after reading the active virtual amiibo
+    EmuiiboPlaylistAdvanceFlag_TagSession = BIT(1)
+} EmuiiboPlaylistAdvanceFlag;
+
+#define EMUIIBO_PLAYLIST_MAX_ENTRY_COUNT 0x400
+
+typedef struct {
+    u32 entry_count;
+    // Index of the active entry
+    u32 position;
+    u32 advance_flags;
+    // Whether the entry after the active one is already loaded
+    bool next_entry_ready;
+    u8 reserved[3];
+} EmuiiboPlaylistStatus;
+
+#define EMUIIBO_HANDHELD_NPAD_ID 0x20
+
+typedef struct {
+    // Only valid when the device has a valid virtual amiibo
+    u64 virtual_amiibo_id;
+    EmuiiboVirtualAmiiboStatus virtual_amiibo_status;
+    u32 npad_id;
+    // Whether the device has its own virtual amiibo, instead of following the active one
+    bool has_own_virtual_amiibo;
+    bool connected;
+    u8 reserved[6];
+} EmuiiboDeviceStatus;
+
+#define EMUIIBO_VIRTUAL_AMIIBO_ARCHIVE_MAGIC 0x43524145 // "EARC"
+#define EMUIIBO_VIRTUAL_AMIIBO_ARCHIVE_MAX_FILE_COUNT 0x40
+
+// Archives are this header followed by file_count files, each one a EmuiiboVirtualAmiiboArchiveFileHeader and then its data
+
+typedef struct {
+    u32 magic;
+    u32 format_version;
+    u32 file_count;
+    u32 reserved;
+    // The whole archive, header included
+    u64 size;
+    u8 reserved_2[0x8];
+} EmuiiboVirtualAmiiboArchiveHeader;
+
+typedef struct {
+    // Relative to the virtual amiibo directory, areas are "areas/0x<area id>.bin"
+    char name[0x38];
+    u64 size;
+} EmuiiboVirtualAmiiboArchiveFileHeader;
+
 typedef enum {
     Module_Emuiibo = 352
 } EmuiiboResultModule;
@@ -51,7 +271,16 @@ typedef enum {
 typedef enum {
     EmuiiboError_NoAmiiboLoaded = 1,
     EmuiiboError_UnableToMove = 2,
-    EmuiiboError_StatusOff = 3
+    EmuiiboError_StatusOff = 3,
+    EmuiiboError_VirtualAmiiboNotFound = 6,
+    EmuiiboError_FolderNotFound = 7,
+    EmuiiboError_LibraryNotReady = 8,
+    EmuiiboError_InvalidPlaylist = 9,
+    EmuiiboError_DeviceNotFound = 10,
+    EmuiiboError_InvalidArchive = 11,
+    EmuiiboError_InvalidImportPath = 12,
+    EmuiiboError_VirtualAmiiboAlreadyExists = 13,
+    EmuiiboError_ImportFailed = 14
 } EmuiiboResultDescription;
 
 // Note: the service's name is "nfp:emu"
@@ -74,6 +303,65 @@ Result emuiiboOpenVirtualAmiibo(u32 idx, EmuiiboVirtualAmiibo *out_amiibo);
 
 EmuiiboVersion emuiiboGetVersion();
 
+void emuiiboGetSettings(EmuiiboSettings *out_settings);
+void emuiiboSetSettings(const EmuiiboSettings *settings);
+void emuiiboReloadSettings();
+
+void emuiiboGetHeapStats(EmuiiboHeapStats *out_stats);
+
+// Ids are stable across rescans and reboots, unlike indices
+Result emuiiboOpenVirtualAmiiboById(u64 id, EmuiiboVirtualAmiibo *out_amiibo);
+Result emuiiboSetActiveVirtualAmiiboById(u64 id);
+Result emuiiboGetActiveVirtualAmiiboId(u64 *out_id);
+u32 emuiiboGetVirtualAmiiboIds(u32 offset, u64 *out_ids, size_t out_ids_count);
+
+// Keep calling with the returned cursor (set as the query's cursor) until it's EMUIIBO_VIRTUAL_AMIIBO_QUERY_END_CURSOR
+u32 emuiiboQueryVirtualAmiibos(const EmuiiboVirtualAmiiboQuery *query, u64 *out_ids, size_t out_ids_count, u32 *out_next_cursor);
+
+// Child folders come first, then virtual amiibos; folder items' ids can be listed again
+Result emuiiboListFolder(u64 folder_id, u32 offset, EmuiiboVirtualAmiiboFolderItem *out_items, size_t out_items_count, u32 *out_count, u32 *out_total_count);
+
+// The event is signaled every time the emulation status, the active virtual amiibo or its status changes (also for per-device virtual amiibos)
+Result emuiiboGetStatusChangeEvent(Event *out_event, bool autoclear);
+void emuiiboGetEmulationStatusSnapshot(EmuiiboEmulationStatusSnapshot *out_snapshot);
+
+// Only commands which were called at least once are listed
+u32 emuiiboGetCommandStats(u32 offset, EmuiiboCommandStats *out_stats, size_t out_stats_count);
+void emuiiboResetCommandStats();
+
+// Stats are indexed by EmuiiboIoSubsystem
+u32 emuiiboGetIoStats(EmuiiboIoStats *out_stats, size_t out_stats_count);
+void emuiiboResetIoStats();
+
+// The report is also saved to sdmc:/emuiibo/boot_report.bin
+void emuiiboGetBootReport(EmuiiboBootReport *out_report);
+
+// The virtual amiibo library is initialized after the services are up: until then, library calls fail with EmuiiboError_LibraryNotReady (or list nothing)
+// The active virtual amiibo works meanwhile
+bool emuiiboIsVirtualAmiiboLibraryReady();
+// The event stays signaled once the library is ready
+Result emuiiboGetVirtualAmiiboLibraryReadyEvent(Event *out_event);
+
+// Playlists rotate the active virtual amiibo through a list of ids (wrapping around), advancing as set by EmuiiboPlaylistAdvanceFlag
+// The first entry is activated right away, the next one is always loaded in the background
+Result emuiiboSetPlaylist(const u64 *ids, size_t ids_count, u32 advance_flags);
+void emuiiboClearPlaylist();
+void emuiiboGetPlaylistStatus(EmuiiboPlaylistStatus *out_status);
+Result emuiiboAdvancePlaylist();
+
+// Devices are npads (0-7 for players 1-8, EMUIIBO_HANDHELD_NPAD_ID for handheld), which follow the active virtual amiibo unless they are given their own one
+Result emuiiboSetDeviceVirtualAmiiboById(u32 npad_id, u64 id);
+Result emuiiboResetDeviceVirtualAmiibo(u32 npad_id);
+// Devices following the active virtual amiibo change its status instead
+Result emuiiboSetDeviceVirtualAmiiboStatus(u32 npad_id, EmuiiboVirtualAmiiboStatus status);
+Result emuiiboGetDeviceStatus(u32 npad_id, EmuiiboDeviceStatus *out_status);
+
+// Archives a whole virtual amiibo (amiibo.json, amiibo.flag, mii charinfo and areas) in a single call
+// Nothing is written if the buffer is smaller than the returned size, so just call it again with a big enough one
+Result emuiiboExportVirtualAmiibo(u64 id, void *out_archive, size_t out_archive_size, u64 *out_size);
+// Imports an archive as a new virtual amiibo at the given path (relative to sdmc:/emuiibo/amiibo), which is added to the library without a rescan
+Result emuiiboImportVirtualAmiibo(const void *archive, size_t archive_size, const char *path, u64 *out_id);
+
 void emuiiboVirtualAmiiboSetAsActiveVirtualAmiibo(EmuiiboVirtualAmiibo *amiibo);
 void emuiiboVirtualAmiiboGetName(EmuiiboVirtualAmiibo *amiibo, char *out_name, size_t out_name_size);
 void emuiiboVirtualAmiiboGetPath(EmuiiboVirtualAmiibo *amiibo, char *out_path, size_t out_path_size);
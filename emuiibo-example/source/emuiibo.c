@@ -84,6 +84,217 @@ EmuiiboVersion emuiiboGetVersion() {
     return ver;
 }
 
+void emuiiboGetSettings(EmuiiboSettings *out_settings) {
+    serviceDispatchOut(&g_emuiibo_nfpemu_srv, 9, *out_settings);
+}
+
+void emuiiboSetSettings(const EmuiiboSettings *settings) {
+    serviceDispatchIn(&g_emuiibo_nfpemu_srv, 10, *settings);
+}
+
+void emuiiboReloadSettings() {
+    serviceDispatch(&g_emuiibo_nfpemu_srv, 11);
+}
+
+void emuiiboGetHeapStats(EmuiiboHeapStats *out_stats) {
+    serviceDispatchOut(&g_emuiibo_nfpemu_srv, 12, *out_stats);
+}
+
+Result emuiiboOpenVirtualAmiiboById(u64 id, EmuiiboVirtualAmiibo *out_amiibo) {
+    return serviceDispatchIn(&g_emuiibo_nfpemu_srv, 13, id,
+        .out_num_objects = 1,
+        .out_objects = &out_amiibo->s,
+    );
+}
+
+Result emuiiboSetActiveVirtualAmiiboById(u64 id) {
+    return serviceDispatchIn(&g_emuiibo_nfpemu_srv, 14, id);
+}
+
+Result emuiiboGetActiveVirtualAmiiboId(u64 *out_id) {
+    return serviceDispatchOut(&g_emuiibo_nfpemu_srv, 15, *out_id);
+}
+
+u32 emuiiboGetVirtualAmiiboIds(u32 offset, u64 *out_ids, size_t out_ids_count) {
+    u32 count = 0;
+    serviceDispatchInOut(&g_emuiibo_nfpemu_srv, 16, offset, count,
+        .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out },
+        .buffers = { { out_ids, out_ids_count * sizeof(u64) } },
+    );
+    return count;
+}
+
+u32 emuiiboQueryVirtualAmiibos(const EmuiiboVirtualAmiiboQuery *query, u64 *out_ids, size_t out_ids_count, u32 *out_next_cursor) {
+    struct {
+        u32 count;
+        u32 next_cursor;
+    } out = { 0, EMUIIBO_VIRTUAL_AMIIBO_QUERY_END_CURSOR };
+    serviceDispatchInOut(&g_emuiibo_nfpemu_srv, 17, *query, out,
+        .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out },
+        .buffers = { { out_ids, out_ids_count * sizeof(u64) } },
+    );
+    if(out_next_cursor) {
+        *out_next_cursor = out.next_cursor;
+    }
+    return out.count;
+}
+
+Result emuiiboGetStatusChangeEvent(Event *out_event, bool autoclear) {
+    Handle event_handle = INVALID_HANDLE;
+    Result rc = serviceDispatch(&g_emuiibo_nfpemu_srv, 19,
+        .out_handle_attrs = { SfOutHandleAttr_HipcCopy },
+        .out_handles = &event_handle,
+    );
+    if(R_SUCCEEDED(rc)) {
+        eventLoadRemote(out_event, event_handle, autoclear);
+    }
+    return rc;
+}
+
+void emuiiboGetEmulationStatusSnapshot(EmuiiboEmulationStatusSnapshot *out_snapshot) {
+    serviceDispatchOut(&g_emuiibo_nfpemu_srv, 20, *out_snapshot);
+}
+
+u32 emuiiboGetCommandStats(u32 offset, EmuiiboCommandStats *out_stats, size_t out_stats_count) {
+    u32 count = 0;
+    serviceDispatchInOut(&g_emuiibo_nfpemu_srv, 21, offset, count,
+        .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out },
+        .buffers = { { out_stats, out_stats_count * sizeof(EmuiiboCommandStats) } },
+    );
+    return count;
+}
+
+void emuiiboResetCommandStats() {
+    serviceDispatch(&g_emuiibo_nfpemu_srv, 22);
+}
+
+u32 emuiiboGetIoStats(EmuiiboIoStats *out_stats, size_t out_stats_count) {
+    u32 count = 0;
+    serviceDispatchOut(&g_emuiibo_nfpemu_srv, 23, count,
+        .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out },
+        .buffers = { { out_stats, out_stats_count * sizeof(EmuiiboIoStats) } },
+    );
+    return count;
+}
+
+void emuiiboResetIoStats() {
+    serviceDispatch(&g_emuiibo_nfpemu_srv, 24);
+}
+
+void emuiiboGetBootReport(EmuiiboBootReport *out_report) {
+    serviceDispatch(&g_emuiibo_nfpemu_srv, 25,
+        .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out },
+        .buffers = { { out_report, sizeof(EmuiiboBootReport) } },
+    );
+}
+
+bool emuiiboIsVirtualAmiiboLibraryReady() {
+    bool ready = false;
+    serviceDispatchOut(&g_emuiibo_nfpemu_srv, 26, ready);
+    return ready;
+}
+
+Result emuiiboGetVirtualAmiiboLibraryReadyEvent(Event *out_event) {
+    Handle event_handle = INVALID_HANDLE;
+    Result rc = serviceDispatch(&g_emuiibo_nfpemu_srv, 27,
+        .out_handle_attrs = { SfOutHandleAttr_HipcCopy },
+        .out_handles = &event_handle,
+    );
+    if(R_SUCCEEDED(rc)) {
+        eventLoadRemote(out_event, event_handle, false);
+    }
+    return rc;
+}
+
+Result emuiiboSetPlaylist(const u64 *ids, size_t ids_count, u32 advance_flags) {
+    return serviceDispatchIn(&g_emuiibo_nfpemu_srv, 28, advance_flags,
+        .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_In },
+        .buffers = { { ids, ids_count * sizeof(u64) } },
+    );
+}
+
+void emuiiboClearPlaylist() {
+    serviceDispatch(&g_emuiibo_nfpemu_srv, 29);
+}
+
+void emuiiboGetPlaylistStatus(EmuiiboPlaylistStatus *out_status) {
+    serviceDispatchOut(&g_emuiibo_nfpemu_srv, 30, *out_status);
+}
+
+Result emuiiboAdvancePlaylist() {
+    return serviceDispatch(&g_emuiibo_nfpemu_srv, 31);
+}
+
+Result emuiiboSetDeviceVirtualAmiiboById(u32 npad_id, u64 id) {
+    const struct {
+        u64 id;
+        u32 npad_id;
+        u32 pad;
+    } in = { id, npad_id, 0 };
+    return serviceDispatchIn(&g_emuiibo_nfpemu_srv, 32, in);
+}
+
+Result emuiiboResetDeviceVirtualAmiibo(u32 npad_id) {
+    return serviceDispatchIn(&g_emuiibo_nfpemu_srv, 33, npad_id);
+}
+
+Result emuiiboSetDeviceVirtualAmiiboStatus(u32 npad_id, EmuiiboVirtualAmiiboStatus status) {
+    const struct {
+        u32 npad_id;
+        u32 status;
+    } in = { npad_id, status };
+    return serviceDispatchIn(&g_emuiibo_nfpemu_srv, 34, in);
+}
+
+Result emuiiboGetDeviceStatus(u32 npad_id, EmuiiboDeviceStatus *out_status) {
+    return serviceDispatchInOut(&g_emuiibo_nfpemu_srv, 35, npad_id, *out_status);
+}
+
+Result emuiiboExportVirtualAmiibo(u64 id, void *out_archive, size_t out_archive_size, u64 *out_size) {
+    return serviceDispatchInOut(&g_emuiibo_nfpemu_srv, 36, id, *out_size,
+        .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out },
+        .buffers = { { out_archive, out_archive_size } },
+    );
+}
+
+Result emuiiboImportVirtualAmiibo(const void *archive, size_t archive_size, const char *path, u64 *out_id) {
+    return serviceDispatchOut(&g_emuiibo_nfpemu_srv, 37, *out_id,
+        .buffer_attrs = {
+            SfBufferAttr_HipcMapAlias | SfBufferAttr_In,
+            SfBufferAttr_HipcMapAlias | SfBufferAttr_In,
+        },
+        .buffers = {
+            { archive, archive_size },
+            { path, strlen(path) + 1 },
+        },
+    );
+}
+
+Result emuiiboListFolder(u64 folder_id, u32 offset, EmuiiboVirtualAmiiboFolderItem *out_items, size_t out_items_count, u32 *out_count, u32 *out_total_count) {
+    const struct {
+        u64 folder_id;
+        u32 offset;
+        u32 pad;
+    } in = { folder_id, offset, 0 };
+    struct {
+        u32 count;
+        u32 total_count;
+    } out = {};
+    Result rc = serviceDispatchInOut(&g_emuiibo_nfpemu_srv, 18, in, out,
+        .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out },
+        .buffers = { { out_items, out_items_count * sizeof(EmuiiboVirtualAmiiboFolderItem) } },
+    );
+    if(R_SUCCEEDED(rc)) {
+        if(out_count) {
+            *out_count = out.count;
+        }
+        if(out_total_count) {
+            *out_total_count = out.total_count;
+        }
+    }
+    return rc;
+}
+
 void emuiiboVirtualAmiiboSetAsActiveVirtualAmiibo(EmuiiboVirtualAmiibo *amiibo) {
     serviceDispatch(&amiibo->s, 0);
 }
@@ -14,27 +14,28 @@ namespace amiibo {
 
         private:
             std::string dir;
+            // Once prewarmed, existing areas (and their sizes) are tracked here instead of being checked on the SD card on every area command
+            std::vector<std::pair<AreaId, size_t>> area_sizes;
+            bool area_sizes_loaded;
 
             inline std::string EncodeAreaDirectory() {
                 return fs::Concat(this->dir, "areas");
             }
 
-            inline std::string EncodeAreaName(AreaId id) {
-                std::stringstream strm;
-                strm << "0x" << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << id << ".bin";
-                return strm.str();
-            }
-
-            inline std::string EncodeAreaFilePath(AreaId id) {
-                return fs::Concat(this->EncodeAreaDirectory(), EncodeAreaName(id));
+            // Area paths are formatted into stack buffers, since area commands are the most frequent ones
+            inline void EncodeAreaFilePath(AreaId id, char (&out_path)[FS_MAX_PATH]) {
+                snprintf(out_path, FS_MAX_PATH, "%s/areas/0x%08X.bin", this->dir.c_str(), id);
             }
 
             void CreateImpl(AreaId id, const void *data, size_t size, bool recreate);
+            const std::pair<AreaId, size_t> *FindAreaSize(AreaId id);
+            void UpdateAreaSize(AreaId id, size_t size);
 
         public:
-            AreaManager() {}
+            AreaManager() : area_sizes_loaded(false) {}
 
-            AreaManager(const std::string &amiibo_dir) : dir(amiibo_dir) {
+            AreaManager(const std::string &amiibo_dir) : dir(amiibo_dir), area_sizes_loaded(false) {
+                EMU_FS_SUBSYSTEM_SCOPE(Areas);
                 fs::CreateDirectory(this->EncodeAreaDirectory());
             }
 
@@ -51,6 +52,26 @@ namespace amiibo {
             void Write(AreaId id, const void *data, size_t size);
             size_t GetSize(AreaId id);
 
+            // Answered from the area index once it's loaded, the areas directory is listed otherwise
+            bool FindAny(AreaId &out_id);
+            void DeleteAll();
+
+            // Always lists the areas directory, reporting every area file's id and path
+            template<typename F>
+            inline void ListAreaFiles(F fn) {
+                const auto areas_dir = this->EncodeAreaDirectory();
+                fs::ListDirectory(areas_dir, [&](const char *name, bool is_dir) {
+                    // Area files are named "0x<area id>.bin"
+                    char *name_end = nullptr;
+                    const auto id = static_cast<AreaId>(strtoul(name, &name_end, 16));
+                    if(!is_dir && (strncmp(name, "0x", 2) == 0) && (strcmp(name_end, ".bin") == 0)) {
+                        fn(id, fs::Concat(areas_dir, name));
+                    }
+                });
+            }
+
+            void Prewarm();
+
     };
 
 }
\ No newline at end of file
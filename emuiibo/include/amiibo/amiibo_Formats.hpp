@@ -3,6 +3,7 @@
 #include <emu_Types.hpp>
 #include <amiibo/amiibo_Areas.hpp>
 #include <ipc/mii/mii_Utils.hpp>
+#include <vector>
 
 namespace amiibo {
 
@@ -11,26 +12,47 @@ namespace amiibo {
         u8 uuid[10];
     };
 
+    // Decoded virtual amiibo fields, common to every format
+
+    struct VirtualAmiiboData {
+        std::string name;
+        AmiiboUuidInfo uuid_info;
+        AmiiboId id;
+        std::string mii_charinfo_file;
+        Date first_write_date;
+        Date last_write_date;
+        u16 write_counter;
+        u32 version;
+    };
+
+    // Binary sidecar (amiibo.cache) holding the decoded amiibo.json fields, loaded with a single read
+    // It's only valid while amiibo.json keeps the size and modification time it was generated from
+
+    struct VirtualAmiiboCache {
+        static inline constexpr u32 Magic = 0x43494D45; // "EMIC"
+        static inline constexpr u32 CurrentFormatVersion = 1;
+        static inline constexpr size_t MiiCharInfoFileNameLength = 0x80;
+
+        u32 magic;
+        u32 format_version;
+        u64 json_size;
+        u64 json_mtime;
+        char name[RegisterInfoImpl::AmiiboNameLength + 1];
+        char mii_charinfo_file[MiiCharInfoFileNameLength];
+        AmiiboUuidInfo uuid_info;
+        AmiiboId id;
+        Date first_write_date;
+        Date last_write_date;
+        u16 write_counter;
+        u32 version;
+    };
+
     class IVirtualAmiiboBase {
 
         protected:
             std::string path;
             bool valid;
 
-            template<typename T>
-            inline T ReadPlain(JSON &json, const std::string &key) {
-                return json.value<T>(key, T());
-            }
-
-            template<typename T>
-            inline void WritePlain(JSON &json, const std::string &key, T t) {
-                json[key] = t;
-            }
-
-            inline bool HasKey(JSON &json, const std::string &key) {
-                return json.count(key);
-            }
-
         public:
             IVirtualAmiiboBase() : valid(false) {}
 
@@ -64,6 +86,7 @@ namespace amiibo {
             }
 
             inline CharInfo ReadMiiCharInfo() {
+                EMU_FS_SUBSYSTEM_SCOPE(Mii);
                 CharInfo charinfo = {};
                 auto charinfo_path = this->GetMiiCharInfoPath();
                 if(fs::IsFile(charinfo_path)) {
@@ -86,6 +109,29 @@ namespace amiibo {
 
     };
 
+    enum class VirtualAmiiboFormat {
+        Invalid,
+        Bin,
+        V2,
+        V3,
+        Current,
+    };
+
+    // Result of listing a directory once: the directory's own format (Invalid if it's not a virtual amiibo)
+    // If it's not a virtual amiibo, its subdirectories and raw bin files are also reported
+
+    struct DirectoryScanInfo {
+        VirtualAmiiboFormat format;
+        std::vector<std::string> child_dirs;
+        std::vector<std::string> bin_files;
+    };
+
+    bool ScanDirectory(const std::string &path, DirectoryScanInfo &out_info);
+
+    // Decodes a current format virtual amiibo's fields from its amiibo.cache (if it's up to date) or from its amiibo.json, without writing anything
+    // Unlike loading the virtual amiibo, an outdated cache isn't regenerated and no directories are created
+    bool ReadVirtualAmiiboData(const std::string &amiibo_path, VirtualAmiiboData &out_data, bool &out_from_cache);
+
     // Old formats supported by emuiibo (how are they named here):
     // - Bin (raw binaries, always supported but mainly used in emuiibo 0.1)
     // - V2 (format used in emuiibo 0.2.x)
@@ -104,50 +150,28 @@ namespace amiibo {
             static inline constexpr u32 DefaultTagType = UINT32_MAX;
 
         private:
-            JSON amiibo_data;
+            VirtualAmiiboData data;
             AreaManager area_manager;
-
-            inline void ReadByteArray(u8 *out_arr, const std::string &key) {
-                auto array = this->amiibo_data[key];
-                for(u32 i = 0; i < array.size(); i++) {
-                    auto item = array[i];
-                    auto value = item.get<u32>();
-                    auto byte = (u8)(value & 0xff);
-                    out_arr[i] = byte;
-                }
+            // Read from the SD card the first time it's needed (or when prewarming)
+            // Loading it has its own lock, since it happens while reading
+            CharInfo mii_charinfo;
+            bool mii_charinfo_loaded;
+            Lock mii_charinfo_lock;
+            // Held (shared) by sessions reading the virtual amiibo's data or areas, and (exclusively) by sessions changing them
+            RwMutex rw_lock;
+
+            inline std::string GetJSONPath() {
+                return fs::Concat(this->path, "amiibo.json");
             }
 
-            inline void WriteByteArray(u8 *arr, u32 len, const std::string &key) {
-                auto array = JSON::array();
-                for(u32 i = 0; i < len; i++) {
-                    auto byte = (u32)arr[i];
-                    array[i] = byte;
-                }
-                this->amiibo_data[key] = array;
+            inline std::string GetCachePath() {
+                return fs::Concat(this->path, "amiibo.cache");
             }
 
-            inline Date ReadDate(const std::string &key) {
-                Date date = {};
-                auto date_item = this->amiibo_data[key];
-                auto y_item = date_item["y"];
-                auto m_item = date_item["m"];
-                auto d_item = date_item["d"];
-                date.year = y_item.get<u16>();
-                date.month = m_item.get<u8>();
-                date.day = m_item.get<u8>();
-                return date;
-            }
-
-            inline void WriteDate(const std::string &key, Date date) {
-                auto date_obj = JSON::object();
-                date_obj["y"] = date.year;
-                date_obj["m"] = date.month;
-                date_obj["d"] = date.day;
-                this->amiibo_data[key] = date_obj;
-            }
+            void SaveCache();
 
         public:
-            VirtualAmiibo() : IVirtualAmiiboBase() {}
+            VirtualAmiibo() : IVirtualAmiiboBase(), data(), mii_charinfo(), mii_charinfo_loaded(false) {}
 
             VirtualAmiibo(const std::string &amiibo_dir);
 
@@ -181,15 +205,30 @@ namespace amiibo {
 
             void FullyRemove() override;
 
+            CharInfo GetMiiCharInfo();
+            // Loads everything game commands need from the SD card in advance, so that the first ones don't have to
+            // Takes the lock by itself, so it must not be held when calling this
+            void Prewarm();
+
             TagInfo ProduceTagInfo();
             RegisterInfo ProduceRegisterInfo();
             ModelInfo ProduceModelInfo();
             CommonInfo ProduceCommonInfo();
+            // nfp:sys info, store data isn't available (only charinfo is kept) so the Mii is left empty
+            RegisterInfoPrivate ProduceRegisterInfoPrivate();
+            AdminInfo ProduceAdminInfo();
+            // Only updates the data in memory, it needs to be saved afterwards
+            void UpdateRegisterInfo(const RegisterInfoPrivate &info);
 
             inline AreaManager &GetAreaManager() {
                 return this->area_manager;
             }
 
+            // Sessions lock the virtual amiibo for a whole command, since they check and access areas (or data) in several steps
+            inline RwMutex &GetLock() {
+                return this->rw_lock;
+            }
+
             template<typename V>
             static inline constexpr bool HasMiiCharInfo() {
                 static_assert(std::is_base_of_v<IVirtualAmiiboBase, V>, "Invalid amiibo type");
@@ -272,41 +311,7 @@ namespace amiibo {
     class VirtualAmiiboV3 : public IVirtualAmiiboBase {
 
         private:
-            JSON tag_data;
-            JSON register_data;
-            JSON common_data;
-            JSON model_data;
-
-            inline std::string GetJSONFileName(const std::string &name) {
-                return fs::Concat(this->path, name + ".json");
-            }
-
-            inline void ReadStringByteArray(JSON &json, u8 *out_arr, const std::string &key) {
-                auto array = this->ReadPlain<std::string>(json, key);
-                if(!array.empty()) {
-                    std::stringstream strm;
-                    for(u32 i = 0; i < array.length(); i += 2) {
-                        strm << std::hex << array.substr(i, 2);
-                        u32 tmpbyte = 0;
-                        strm >> tmpbyte;
-                        out_arr[i / 2] = (u8)(tmpbyte & 0xff);
-                        strm.str("");
-                        strm.clear();
-                    }
-                }
-            }
-
-            inline Date ReadStringDate(JSON &json, const std::string &key) {
-                auto date_str = this->ReadPlain<std::string>(json, key);
-                auto date_year_str = date_str.substr(0, 4);
-                auto date_month_str = date_str.substr(5, 2);
-                auto date_day_str = date_str.substr(8, 2);
-                Date date = {};
-                date.year = (u16)std::stoi(date_year_str);
-                date.month = (u8)std::stoi(date_month_str);
-                date.day = (u8)std::stoi(date_day_str);
-                return date;
-            }
+            VirtualAmiiboData data;
 
         public:
             VirtualAmiiboV3(const std::string &amiibo_dir);
@@ -335,9 +340,6 @@ namespace amiibo {
 
     class VirtualAmiiboV2 : public IVirtualAmiiboBase {
 
-        private:
-            JSON amiibo_data;
-
     };
 
     // Raw binary, 0.1 virtual amiibo format
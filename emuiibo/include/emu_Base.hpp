@@ -5,14 +5,18 @@
 #include <sstream>
 #include <fstream>
 #include <mutex>
+#include <shared_mutex>
 #include <stratosphere.hpp>
 #include <json.hpp>
+#include <emu_Memory.hpp>
+#include <fs/fs_Stats.hpp>
 
 using i32 = s32;
 
 static inline constexpr Result Success = 0;
 
-using JSON = nlohmann::json;
+// JSON DOMs are allocated from the current scratch arena when inside a mem::ScratchScope
+using JSON = nlohmann::basic_json<std::map, std::vector, std::string, bool, s64, u64, double, mem::ScratchAllocator>;
 
 struct Version {
     u8 major;
@@ -30,23 +34,92 @@ namespace consts {
     static inline const std::string EmuDir = "sdmc:/emuiibo";
     static inline const std::string SettingsPath = EmuDir + "/settings.json";
     static inline const std::string LogFilePath = EmuDir + "/emuiibo.log";
+    static inline const std::string BootReportPath = EmuDir + "/boot_report.bin";
+    static inline const std::string EmulationStatePath = EmuDir + "/emulation_state.bin";
+    static inline const std::string TitleProfilesPath = EmuDir + "/title_profiles.json";
     static inline const std::string AmiiboDir = EmuDir + "/amiibo";
     static inline const std::string DumpedMiisDir = EmuDir + "/miis";
+    static inline const std::string CatalogDir = EmuDir + "/catalog";
+    static inline const std::string CatalogRunsDir = CatalogDir + "/runs";
+    static inline const std::string ImportDir = EmuDir + "/import";
 
 }
 
-#define EMU_LOG_FMT(...) { \
-    std::stringstream strm; \
-    strm << "[ emuiibo v" << EMUIIBO_VERSION << " | " << __PRETTY_FUNCTION__ << " ] " << __VA_ARGS__; \
-    auto f = fopen(consts::LogFilePath.c_str(), "a+"); \
-    if(f) { \
-        fprintf(f, "%s\n", strm.str().c_str()); \
-        fclose(f); \
-    } \
+namespace sys {
+
+    // Each level also logs everything the previous ones do
+    enum class LogLevel : u8 {
+        Off,
+        Error,
+        Info,
+        Verbose,
+        Count
+    };
+
+    // Defined with the rest of the settings, declared here for the logging macros
+    LogLevel GetLogLevel();
+
 }
 
+// Wrapped in a do/while, so that an else after the macro (in an unbraced if) doesn't bind to the logging check
+#define EMU_LOG_LEVEL_FMT(level, ...) do { \
+    if((level) <= ::sys::GetLogLevel()) { \
+        std::stringstream strm; \
+        strm << "[ emuiibo v" << EMUIIBO_VERSION << " | " << __PRETTY_FUNCTION__ << " ] " << __VA_ARGS__; \
+        auto f = fopen(consts::LogFilePath.c_str(), "a+"); \
+        if(f) { \
+            const auto log_line = strm.str(); \
+            fprintf(f, "%s\n", log_line.c_str()); \
+            fclose(f); \
+            ::fs::RecordLogWrite(log_line.length() + 1); \
+        } \
+    } \
+} while(0);
+
+// Failures worth knowing about even when nothing else is logged
+#define EMU_LOG_ERR_FMT(...) EMU_LOG_LEVEL_FMT(::sys::LogLevel::Error, __VA_ARGS__)
+// Boot, settings and emulation changes
+#define EMU_LOG_FMT(...) EMU_LOG_LEVEL_FMT(::sys::LogLevel::Info, __VA_ARGS__)
+// Per-command/per-amiibo tracing, which costs an SD write for every line
+#define EMU_LOG_VERBOSE_FMT(...) EMU_LOG_LEVEL_FMT(::sys::LogLevel::Verbose, __VA_ARGS__)
+
 #define EMU_DEFINE_RESULT(name, mod, desc) static constexpr Result Result##name = MAKERESULT(mod, desc);
 
 using Lock = ams::os::RecursiveMutex;
 
-#define EMU_LOCK_SCOPE_WITH(mtx_name) std::scoped_lock lk(mtx_name);
\ No newline at end of file
+#define EMU_LOCK_SCOPE_WITH(mtx_name) std::scoped_lock lk(mtx_name);
+
+// Readers share it, writers get it exclusively (usable with std::shared_lock)
+class RwMutex {
+
+    private:
+        RwLock rw_lock;
+
+    public:
+        RwMutex() {
+            rwlockInit(&this->rw_lock);
+        }
+
+        RwMutex(const RwMutex&) = delete;
+        RwMutex &operator=(const RwMutex&) = delete;
+
+        inline void lock() {
+            rwlockWriteLock(&this->rw_lock);
+        }
+
+        inline void unlock() {
+            rwlockWriteUnlock(&this->rw_lock);
+        }
+
+        inline void lock_shared() {
+            rwlockReadLock(&this->rw_lock);
+        }
+
+        inline void unlock_shared() {
+            rwlockReadUnlock(&this->rw_lock);
+        }
+
+};
+
+#define EMU_READ_LOCK_SCOPE_WITH(rw_mtx_name) std::shared_lock<RwMutex> rlk(rw_mtx_name);
+#define EMU_WRITE_LOCK_SCOPE_WITH(rw_mtx_name) std::scoped_lock wlk(rw_mtx_name);
\ No newline at end of file
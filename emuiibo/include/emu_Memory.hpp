@@ -0,0 +1,221 @@
+
+#pragma once
+#include <switch.h>
+#include <cstddef>
+
+namespace mem {
+
+    // Bump allocator over a fixed buffer, meant for short-lived allocations (temporary JSON DOMs, conversions...)
+    // If the buffer gets exhausted, allocations just fall back to the regular heap
+
+    class ScratchArena {
+
+        private:
+            u8 *buf;
+            size_t size;
+            size_t offset;
+            size_t peak;
+            u32 fallback_count;
+
+        public:
+            ScratchArena(void *buf, size_t size);
+
+            void *Allocate(size_t size, size_t align);
+
+            inline bool Contains(const void *ptr) {
+                auto ptr8 = reinterpret_cast<const u8*>(ptr);
+                return (ptr8 >= this->buf) && (ptr8 < (this->buf + this->size));
+            }
+
+            inline size_t GetOffset() {
+                return this->offset;
+            }
+
+            inline void Rewind(size_t offset) {
+                this->offset = offset;
+            }
+
+            inline size_t GetSize() {
+                return this->size;
+            }
+
+            inline size_t GetPeak() {
+                return this->peak;
+            }
+
+            inline u32 GetFallbackCount() {
+                return this->fallback_count;
+            }
+
+            inline void NotifyFallback() {
+                this->fallback_count++;
+            }
+
+    };
+
+    // Arena used by the IPC server thread
+    ScratchArena &GetServerScratchArena();
+    // Arena used by the persist thread, which saves virtual amiibos and runs the boot work (legacy conversions included)
+    ScratchArena &GetPersistScratchArena();
+
+    // Binds an arena to the calling thread: scratch scopes opened on threads without an arena are no-ops (everything comes from the heap)
+    // The playlist prefetch thread and the scan workers have none, since they only decode JSON with the SAX reader (which doesn't use scratch memory)
+    void BindThreadScratchArena(ScratchArena *arena);
+
+    // Makes the thread's arena the current scratch arena, and rewinds it (releasing everything allocated inside the scope) once the scope ends
+    // Every IPC command runs inside one (see ipc::CommandStatsScope), scopes can be nested for work that allocates a lot (like JSON loading/saving)
+    // Nothing allocated with ScratchAllocator inside the scope must outlive it!
+
+    class ScratchScope {
+
+        private:
+            ScratchArena *arena;
+            ScratchArena *prev_arena;
+            size_t start_offset;
+
+        public:
+            ScratchScope();
+            ~ScratchScope();
+
+    };
+
+    // The heap fallback only guarantees the default alignment (like operator new), which is all ScratchAllocator users get
+    void *AllocateScratch(size_t size, size_t align);
+    void FreeScratch(void *ptr);
+
+    // Stateless allocator which allocates from the current thread's scratch arena (if any), otherwise from the heap
+
+    template<typename T>
+    struct ScratchAllocator {
+        using value_type = T;
+
+        ScratchAllocator() = default;
+
+        template<typename U>
+        constexpr ScratchAllocator(const ScratchAllocator<U>&) {}
+
+        inline T *allocate(size_t n) {
+            static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types can't come from the heap fallback");
+            return reinterpret_cast<T*>(AllocateScratch(n * sizeof(T), alignof(T)));
+        }
+
+        inline void deallocate(T *ptr, size_t n) {
+            FreeScratch(ptr);
+        }
+
+        template<typename U>
+        inline constexpr bool operator==(const ScratchAllocator<U>&) const {
+            return true;
+        }
+
+        template<typename U>
+        inline constexpr bool operator!=(const ScratchAllocator<U>&) const {
+            return false;
+        }
+    };
+
+    // Fixed-size block pool over a static buffer, for long-lived objects which are created and destroyed over and over (virtual amiibos)
+    // Keeping them out of the heap avoids them splitting it into fragments between short-lived allocations
+    // Blocks which don't fit (or once the pool is exhausted) are allocated from the regular heap instead
+
+    class ObjectPool {
+
+        private:
+            u8 *buf;
+            size_t block_size;
+            u32 block_count;
+            void *free_list;
+            u32 in_use_count;
+            u32 peak_count;
+            u32 fallback_count;
+            Mutex lock;
+
+        public:
+            ObjectPool(void *buf, size_t block_size, u32 block_count);
+
+            void *Allocate(size_t size);
+            // Returns whether the block belonged to the pool
+            bool Free(void *ptr);
+
+            inline size_t GetBlockSize() {
+                return this->block_size;
+            }
+
+            inline u32 GetBlockCount() {
+                return this->block_count;
+            }
+
+            inline u32 GetInUseCount() {
+                return this->in_use_count;
+            }
+
+            inline u32 GetPeakCount() {
+                return this->peak_count;
+            }
+
+            inline u32 GetFallbackCount() {
+                return this->fallback_count;
+            }
+
+    };
+
+    // Blocks are big enough for a virtual amiibo allocated along with its shared pointer control block
+    static inline constexpr size_t ObjectPoolBlockSize = 0x200;
+
+    ObjectPool &GetObjectPool();
+
+    void *AllocatePooled(size_t size);
+    void FreePooled(void *ptr);
+
+    // Stateless allocator over the object pool, meant for std::allocate_shared
+
+    template<typename T>
+    struct PoolAllocator {
+        using value_type = T;
+
+        PoolAllocator() = default;
+
+        template<typename U>
+        constexpr PoolAllocator(const PoolAllocator<U>&) {}
+
+        inline T *allocate(size_t n) {
+            return reinterpret_cast<T*>(AllocatePooled(n * sizeof(T)));
+        }
+
+        inline void deallocate(T *ptr, size_t n) {
+            FreePooled(ptr);
+        }
+
+        template<typename U>
+        inline constexpr bool operator==(const PoolAllocator<U>&) const {
+            return true;
+        }
+
+        template<typename U>
+        inline constexpr bool operator!=(const PoolAllocator<U>&) const {
+            return false;
+        }
+    };
+
+    struct HeapStats {
+        u64 heap_size;
+        u64 arena_size;
+        u64 arena_peak_size;
+        u64 in_use_size;
+        u64 in_use_peak_size;
+        u64 free_size;
+        u64 free_chunk_count;
+        u64 scratch_size;
+        u64 scratch_peak_size;
+        u64 scratch_fallback_count;
+        u64 pool_block_count;
+        u64 pool_in_use_count;
+        u64 pool_peak_count;
+        u64 pool_fallback_count;
+    };
+
+    // Samples the heap usage, updating the tracked peak
+    void SampleHeapUsage();
+    HeapStats GetHeapStats();
+
+}
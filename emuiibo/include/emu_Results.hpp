@@ -29,6 +29,15 @@ namespace result {
         EMU_DEFINE_RESULT(StatusOff, Module, 3)
         EMU_DEFINE_RESULT(NoMiisFound, Module, 4)
         EMU_DEFINE_RESULT(MiiIndexOOB, Module, 5)
+        EMU_DEFINE_RESULT(VirtualAmiiboNotFound, Module, 6)
+        EMU_DEFINE_RESULT(FolderNotFound, Module, 7)
+        EMU_DEFINE_RESULT(LibraryNotReady, Module, 8)
+        EMU_DEFINE_RESULT(InvalidPlaylist, Module, 9)
+        EMU_DEFINE_RESULT(DeviceNotFound, Module, 10)
+        EMU_DEFINE_RESULT(InvalidArchive, Module, 11)
+        EMU_DEFINE_RESULT(InvalidImportPath, Module, 12)
+        EMU_DEFINE_RESULT(VirtualAmiiboAlreadyExists, Module, 13)
+        EMU_DEFINE_RESULT(ImportFailed, Module, 14)
 
     }
 
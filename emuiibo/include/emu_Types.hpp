@@ -93,8 +93,47 @@ struct CommonInfo : public ams::sf::LargeData {
     NfpCommonInfo info;
 };
 
-// TODO: RE this struct
+// nfp:sys's register info has the Mii as store data instead of charinfo
+
+struct RegisterInfoPrivateImpl {
+    u8 mii_store_data[0x44];
+    Date first_write_date;
+    char name[RegisterInfoImpl::AmiiboNameLength + 1];
+    u8 font_region;
+    u8 reserved[0x8e];
+} PACKED;
+
+static_assert(sizeof(RegisterInfoPrivateImpl) == sizeof(NfpRegisterInfo), "Invalid RegisterInfoPrivate type");
+
+struct RegisterInfoPrivate : public ams::sf::LargeData {
+    RegisterInfoPrivateImpl info;
+};
+
+enum AdminInfoFlag : u8 {
+    AdminInfoFlag_Registered = BIT(0),
+    AdminInfoFlag_HasApplicationArea = BIT(1),
+};
+
+enum class ApplicationAreaVersion : u8 {
+    Nintendo3DS = 0,
+    WiiU = 1,
+    Nintendo3DSv2 = 2,
+    Switch = 3,
+    NotSet = 0xFF,
+};
+
+struct AdminInfoImpl {
+    u64 program_id;
+    u32 application_area_id;
+    u16 crc_change_counter;
+    u8 flags;
+    u8 tag_type;
+    ApplicationAreaVersion application_area_version;
+    u8 reserved[0x2F];
+} PACKED;
+
+static_assert(sizeof(AdminInfoImpl) == 0x40, "Invalid AdminInfo type");
 
 struct AdminInfo : public ams::sf::LargeData {
-    u8 raw[0x40];
+    AdminInfoImpl info;
 };
\ No newline at end of file
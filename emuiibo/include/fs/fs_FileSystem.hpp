@@ -3,17 +3,43 @@
 #include <emu_Types.hpp>
 #include <iomanip>
 #include <sys/stat.h>
+#include <dirent.h>
 
 namespace fs {
 
+    // Every SD card access goes through these helpers, so that it's accounted for
+
+    inline FILE *OpenFile(const char *path, const char *mode) {
+        RecordIo(IoOperation::Open);
+        return fopen(path, mode);
+    }
+
+    inline size_t ReadFile(void *data, size_t size, size_t count, FILE *f) {
+        const auto read_count = fread(data, size, count, f);
+        RecordIo(IoOperation::Read, read_count * size);
+        return read_count;
+    }
+
+    inline size_t WriteFile(const void *data, size_t size, size_t count, FILE *f) {
+        const auto written_count = fwrite(data, size, count, f);
+        RecordIo(IoOperation::Write, written_count * size);
+        return written_count;
+    }
+
+    inline bool StatFile(const char *path, struct stat &out_st) {
+        RecordIo(IoOperation::Stat);
+        return stat(path, &out_st) == 0;
+    }
+
     inline void CreateDirectory(const std::string &path) {
+        RecordIo(IoOperation::Metadata);
         mkdir(path.c_str(), 777);
     }
 
     template<mode_t Mode>
-    inline bool StatImpl(const std::string &path) {
+    inline bool StatImpl(const char *path) {
         struct stat st;
-        if(stat(path.c_str(), &st) == 0) {
+        if(StatFile(path, st)) {
             if(st.st_mode & Mode) {
                 return true;
             }
@@ -21,23 +47,39 @@ namespace fs {
         return false;
     }
 
-    inline bool IsFile(const std::string &path) {
+    // Plain C string overloads allow using stack path buffers, without any heap allocations
+
+    inline bool IsFile(const char *path) {
         return StatImpl<S_IFREG>(path);
     }
 
-    inline bool IsDirectory(const std::string &path) {
+    inline bool IsFile(const std::string &path) {
+        return IsFile(path.c_str());
+    }
+
+    inline bool IsDirectory(const char *path) {
         return StatImpl<S_IFDIR>(path);
     }
 
+    inline bool IsDirectory(const std::string &path) {
+        return IsDirectory(path.c_str());
+    }
+
     inline bool MatchesExtension(const std::string &path, const std::string &ext) {
         return path.substr(path.find_last_of(".") + 1) == ext;
     }
 
+    inline void DeleteFile(const char *path) {
+        RecordIo(IoOperation::Metadata);
+        remove(path);
+    }
+
     inline void DeleteFile(const std::string &path) {
-        remove(path.c_str());
+        DeleteFile(path.c_str());
     }
 
     inline void DeleteDirectory(const std::string &path) {
+        RecordIo(IoOperation::Metadata);
         fsdevDeleteDirectoryRecursively(path.c_str());
     }
 
@@ -46,18 +88,41 @@ namespace fs {
         CreateDirectory(path);
     }
 
+    // Works for directories too, as long as both paths are in the same filesystem
+    inline bool Rename(const std::string &old_path, const std::string &new_path) {
+        RecordIo(IoOperation::Metadata);
+        return rename(old_path.c_str(), new_path.c_str()) == 0;
+    }
+
     inline void CreateEmptyFile(const std::string &path) {
-        std::ofstream ofs(path);
+        auto f = OpenFile(path.c_str(), "wb");
+        if(f) {
+            fclose(f);
+        }
     }
 
-    inline size_t GetFileSize(const std::string &path) {
+    inline size_t GetFileSize(const char *path) {
         struct stat st;
-        if(stat(path.c_str(), &st) == 0) {
+        if(StatFile(path, st)) {
             return st.st_size;
         }
         return 0;
     }
 
+    inline size_t GetFileSize(const std::string &path) {
+        return GetFileSize(path.c_str());
+    }
+
+    inline bool GetFileSizeAndTime(const std::string &path, u64 &out_size, u64 &out_mtime) {
+        struct stat st;
+        if(StatFile(path.c_str(), st)) {
+            out_size = st.st_size;
+            out_mtime = st.st_mtime;
+            return true;
+        }
+        return false;
+    }
+
     inline void ConcatImpl(std::string &base, const std::string &p) {
         if(base.back() != '/') {
             if(p.front() != '/') {
@@ -75,26 +140,83 @@ namespace fs {
         return ret;
     }
 
+    // Lists a directory once, reporting every entry's name and whether it's a directory
+    // The entry type comes from the listing itself (d_type), only falling back to stat when it's unknown
+    template<typename F>
+    inline bool ListDirectory(const std::string &path, F fn) {
+        RecordIo(IoOperation::DirectoryOpen);
+        auto dir = opendir(path.c_str());
+        if(dir) {
+            while(true) {
+                auto dt = readdir(dir);
+                if(dt == nullptr) {
+                    break;
+                }
+                RecordIo(IoOperation::DirectoryEntry);
+                if((strcmp(dt->d_name, ".") == 0) || (strcmp(dt->d_name, "..") == 0)) {
+                    continue;
+                }
+                bool is_dir = false;
+                switch(dt->d_type) {
+                    case DT_DIR:
+                        is_dir = true;
+                        break;
+                    case DT_UNKNOWN:
+                        is_dir = IsDirectory(Concat(path, dt->d_name));
+                        break;
+                    default:
+                        break;
+                }
+                fn(dt->d_name, is_dir);
+            }
+            closedir(dir);
+            return true;
+        }
+        return false;
+    }
+
+    inline bool ReadFileContents(const std::string &path, std::string &out_data) {
+        auto f = OpenFile(path.c_str(), "rb");
+        if(f) {
+            struct stat st;
+            RecordIo(IoOperation::Stat);
+            auto ok = fstat(fileno(f), &st) == 0;
+            if(ok) {
+                out_data.resize(st.st_size);
+                ok = ReadFile(out_data.data(), 1, out_data.length(), f) == out_data.length();
+            }
+            fclose(f);
+            return ok;
+        }
+        return false;
+    }
+
     inline JSON LoadJSONFile(const std::string &path) {
-        std::ifstream ifs(path);
-        if(ifs.good()) {
-            return JSON::parse(ifs);
+        std::string json_data;
+        if(ReadFileContents(path, json_data)) {
+            // Don't abort on malformed files (exceptions are disabled), just treat them as empty
+            auto json = JSON::parse(json_data, nullptr, false);
+            if(!json.is_discarded()) {
+                return json;
+            }
         }
         return JSON::object();
     }
 
     inline void SaveJSONFile(const std::string &path, JSON &json) {
-        std::ofstream ofs(path);
-        if(ofs.good()) {
-            ofs << std::setw(4) << json;
+        auto f = OpenFile(path.c_str(), "wb");
+        if(f) {
+            const auto json_data = json.dump(4);
+            WriteFile(json_data.data(), 1, json_data.length(), f);
+            fclose(f);
         }
     }
 
     template<typename T>
     inline void Save(const std::string &path, T t) {
-        auto f = fopen(path.c_str(), "wb");
+        auto f = OpenFile(path.c_str(), "wb");
         if(f) {
-            fwrite(&t, 1, sizeof(T), f);
+            WriteFile(&t, 1, sizeof(T), f);
             fclose(f);
         }
     }
@@ -104,9 +226,9 @@ namespace fs {
         T t = T();
         const size_t file_sz = GetFileSize(path);
         if(file_sz >= sizeof(T)) {
-            auto f = fopen(path.c_str(), "rb");
+            auto f = OpenFile(path.c_str(), "rb");
             if(f) {
-                fread(&t, 1, sizeof(T), f);
+                ReadFile(&t, 1, sizeof(T), f);
                 fclose(f);
             }
         }
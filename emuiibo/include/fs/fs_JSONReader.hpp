@@ -0,0 +1,172 @@
+
+#pragma once
+#include <fs/fs_FileSystem.hpp>
+
+namespace fs {
+
+    // SAX-based JSON reader: values are reported together with their dotted key path (like "id.series"), without building any DOM
+    // Array items are reported with the array's path and their index inside it
+
+    class JSONReader : public nlohmann::json_sax<JSON> {
+
+        private:
+            static inline constexpr u32 MaxDepth = 8;
+
+            struct Level {
+                size_t base_path_len;
+                bool is_array;
+                u32 index;
+            };
+
+            std::string cur_path;
+            Level levels[MaxDepth];
+            u32 depth;
+
+            inline bool PushLevel(bool is_array) {
+                if(this->depth >= MaxDepth) {
+                    // Nothing we read is nested this deep, so this is either malformed or not an amiibo file
+                    return false;
+                }
+                this->levels[this->depth] = { this->cur_path.length(), is_array, 0 };
+                this->depth++;
+                return true;
+            }
+
+            inline bool PopLevel() {
+                if(this->depth == 0) {
+                    return false;
+                }
+                this->depth--;
+                this->cur_path.resize(this->levels[this->depth].base_path_len);
+                this->NotifyValueEnd();
+                return true;
+            }
+
+            inline u32 GetCurrentIndex() {
+                if(this->depth > 0) {
+                    return this->levels[this->depth - 1].index;
+                }
+                return 0;
+            }
+
+            inline void NotifyValueEnd() {
+                if(this->depth > 0) {
+                    auto &level = this->levels[this->depth - 1];
+                    if(level.is_array) {
+                        level.index++;
+                    }
+                }
+            }
+
+            template<typename F>
+            inline bool HandleValue(F fn) {
+                const auto ok = fn(this->cur_path, this->GetCurrentIndex());
+                this->NotifyValueEnd();
+                return ok;
+            }
+
+        protected:
+            // Any of these may return false to abort parsing (invalid data)
+
+            virtual bool OnKey(const std::string &path) {
+                return true;
+            }
+
+            virtual bool OnString(const std::string &path, u32 index, const std::string &value) {
+                return true;
+            }
+
+            virtual bool OnNumber(const std::string &path, u32 index, u64 value) {
+                return true;
+            }
+
+            // Negative values are skipped (like floats) unless the reader knows the path and rejects them
+            virtual bool OnNegativeNumber(const std::string &path, u32 index, s64 value) {
+                return true;
+            }
+
+            virtual bool OnBoolean(const std::string &path, u32 index, bool value) {
+                return true;
+            }
+
+        public:
+            JSONReader() : depth(0) {}
+
+            bool null() override {
+                this->NotifyValueEnd();
+                return true;
+            }
+
+            bool boolean(bool val) override {
+                return this->HandleValue([&](const std::string &path, u32 index) {
+                    return this->OnBoolean(path, index, val);
+                });
+            }
+
+            bool number_integer(number_integer_t val) override {
+                if(val < 0) {
+                    return this->HandleValue([&](const std::string &path, u32 index) {
+                        return this->OnNegativeNumber(path, index, val);
+                    });
+                }
+                return this->number_unsigned(static_cast<number_unsigned_t>(val));
+            }
+
+            bool number_unsigned(number_unsigned_t val) override {
+                return this->HandleValue([&](const std::string &path, u32 index) {
+                    return this->OnNumber(path, index, val);
+                });
+            }
+
+            bool number_float(number_float_t val, const string_t &s) override {
+                this->NotifyValueEnd();
+                return true;
+            }
+
+            bool string(string_t &val) override {
+                return this->HandleValue([&](const std::string &path, u32 index) {
+                    return this->OnString(path, index, val);
+                });
+            }
+
+            bool start_object(std::size_t elements) override {
+                return this->PushLevel(false);
+            }
+
+            bool key(string_t &val) override {
+                this->cur_path.resize(this->levels[this->depth - 1].base_path_len);
+                if(!this->cur_path.empty()) {
+                    this->cur_path += '.';
+                }
+                this->cur_path += val;
+                return this->OnKey(this->cur_path);
+            }
+
+            bool end_object() override {
+                return this->PopLevel();
+            }
+
+            bool start_array(std::size_t elements) override {
+                return this->PushLevel(true);
+            }
+
+            bool end_array() override {
+                return this->PopLevel();
+            }
+
+            bool parse_error(std::size_t position, const std::string &last_token, const nlohmann::detail::exception &ex) override {
+                return false;
+            }
+
+    };
+
+    // Reads the whole file with a single read, then parses it with the given reader
+    inline bool ParseJSONFile(const std::string &path, JSONReader &reader) {
+        std::string json_data;
+        if(!ReadFileContents(path, json_data)) {
+            return false;
+        }
+        return JSON::sax_parse(json_data.data(), json_data.data() + json_data.length(), &reader);
+    }
+
+}
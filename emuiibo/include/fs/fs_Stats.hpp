@@ -0,0 +1,94 @@
+
+#pragma once
+#include <switch.h>
+#include <atomic>
+
+namespace fs {
+
+    // SD card I/O accounting: every fs helper records its operations for the calling thread's subsystem, and for the IPC command being handled (if any)
+
+    enum class Subsystem : u32 {
+        Other,
+        Areas,
+        VirtualAmiibo,
+        Mii,
+        Locator,
+        Settings,
+        Log,
+        Emulation,
+
+        Count
+    };
+
+    enum class IoOperation : u32 {
+        Stat,
+        Open,
+        Read,
+        Write,
+        DirectoryOpen,
+        DirectoryEntry,
+        // Creating or deleting files and directories
+        Metadata
+    };
+
+    struct IoStats {
+        u32 stat_count;
+        u32 open_count;
+        u32 read_count;
+        u32 write_count;
+        u32 dir_open_count;
+        u32 dir_entry_count;
+        u32 metadata_count;
+        u32 reserved;
+        u64 read_size;
+        u64 written_size;
+    };
+
+    static_assert(sizeof(IoStats) == 0x30, "Invalid IoStats struct!");
+
+    class IoCounters {
+
+        private:
+            std::atomic<u32> stat_count;
+            std::atomic<u32> open_count;
+            std::atomic<u32> read_count;
+            std::atomic<u32> write_count;
+            std::atomic<u32> dir_open_count;
+            std::atomic<u32> dir_entry_count;
+            std::atomic<u32> metadata_count;
+            std::atomic<u64> read_size;
+            std::atomic<u64> written_size;
+
+        public:
+            void Add(IoOperation op, u64 size);
+            void Load(IoStats &out_stats) const;
+            void Reset();
+
+    };
+
+    void RecordIo(IoOperation op, u64 size = 0);
+
+    // The log file is opened and written to on every log line
+    void RecordLogWrite(size_t size);
+
+    // Returns the previously bound counters, so that they can be restored
+    IoCounters *BindThreadCommandIoCounters(IoCounters *counters);
+
+    // Stats are indexed by subsystem
+    u32 GetIoStats(IoStats *out_stats, u32 max_count);
+    void ResetIoStats();
+
+    class SubsystemScope {
+
+        private:
+            Subsystem prev_subsystem;
+
+        public:
+            SubsystemScope(Subsystem subsystem);
+            ~SubsystemScope();
+
+    };
+
+}
+
+#define EMU_FS_SUBSYSTEM_SCOPE(subsystem) ::fs::SubsystemScope fs_subsystem_scope(::fs::Subsystem::subsystem)
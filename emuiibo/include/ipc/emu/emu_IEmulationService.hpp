@@ -2,6 +2,13 @@
 #pragma once
 #include <ipc/emu/emu_IVirtualAmiibo.hpp>
 #include <sys/sys_Locator.hpp>
+#include <sys/sys_Settings.hpp>
+#include <sys/sys_Boot.hpp>
+#include <sys/sys_Profiles.hpp>
+#include <sys/sys_Playlist.hpp>
+#include <sys/sys_Devices.hpp>
+#include <sys/sys_Archive.hpp>
+#include <ipc/ipc_CommandStats.hpp>
 
 namespace ipc::emu {
 
@@ -20,71 +27,396 @@ namespace ipc::emu {
                 GetVirtualAmiiboCount = 6,
                 OpenVirtualAmiibo = 7,
                 GetVersion = 8,
+                GetSettings = 9,
+                SetSettings = 10,
+                ReloadSettings = 11,
+                GetHeapStats = 12,
+                OpenVirtualAmiiboById = 13,
+                SetActiveVirtualAmiiboById = 14,
+                GetActiveVirtualAmiiboId = 15,
+                GetVirtualAmiiboIds = 16,
+                QueryVirtualAmiibos = 17,
+                ListFolder = 18,
+                GetStatusChangeEvent = 19,
+                GetEmulationStatusSnapshot = 20,
+                GetCommandStats = 21,
+                ResetCommandStats = 22,
+                GetIoStats = 23,
+                ResetIoStats = 24,
+                GetBootReport = 25,
+                IsVirtualAmiiboLibraryReady = 26,
+                GetVirtualAmiiboLibraryReadyEvent = 27,
+                SetPlaylist = 28,
+                ClearPlaylist = 29,
+                GetPlaylistStatus = 30,
+                AdvancePlaylist = 31,
+                SetDeviceVirtualAmiiboById = 32,
+                ResetDeviceVirtualAmiibo = 33,
+                SetDeviceVirtualAmiiboStatus = 34,
+                GetDeviceStatus = 35,
+                ExportVirtualAmiibo = 36,
+                ImportVirtualAmiibo = 37,
             };
 
-            inline ams::Result OpenAmiiboImpl(amiibo::VirtualAmiibo amiibo, ams::sf::Out<std::shared_ptr<IVirtualAmiibo>> out_amiibo) {
-                EMU_LOG_FMT("Virtual amiibo valid: " << std::boolalpha << amiibo.IsValid())
-                R_UNLESS(amiibo.IsValid(), 0xdead);
-                EMU_LOG_FMT("Amiibo name: '" << amiibo.GetName() << "'")
+            static_assert(static_cast<u32>(CommandId::ImportVirtualAmiibo) < ipc::CommandStatsEmulationCommandCount, "Emulation commands wouldn't be recorded");
 
-                auto amiibo_obj = std::make_shared<IVirtualAmiibo>(amiibo);
+            // Pinned for the whole session, so that counts and indices stay consistent across rescans
+            // Sessions opened while the library is still being initialized pin it as soon as it's available
+            std::shared_ptr<sys::Catalog> catalog;
+            // Only created (and registered) once a client asks for it
+            ams::os::SystemEvent status_change_event;
+            bool status_change_event_registered;
+
+            inline bool PinCatalog() {
+                if(this->catalog == nullptr) {
+                    this->catalog = sys::GetVirtualAmiiboCatalog();
+                }
+                return this->catalog != nullptr;
+            }
+
+            inline ams::Result EnsureCatalog(ams::Result no_catalog_rc) {
+                if(!this->PinCatalog()) {
+                    R_UNLESS(sys::IsVirtualAmiiboLibraryReady(), result::emu::ResultLibraryNotReady);
+                    return no_catalog_rc;
+                }
+                return ams::ResultSuccess();
+            }
+
+            inline ams::Result OpenAmiiboImpl(std::shared_ptr<amiibo::VirtualAmiibo> amiibo, ams::sf::Out<std::shared_ptr<IVirtualAmiibo>> out_amiibo) {
+                R_UNLESS(amiibo != nullptr, 0xdead);
+                {
+                    EMU_READ_LOCK_SCOPE_WITH(amiibo->GetLock());
+                    const auto is_valid = amiibo->IsValid();
+                    EMU_LOG_VERBOSE_FMT("Virtual amiibo valid: " << std::boolalpha << is_valid)
+                    R_UNLESS(is_valid, 0xdead);
+                    EMU_LOG_VERBOSE_FMT("Amiibo name: '" << amiibo->GetName() << "'")
+                }
+
+                auto amiibo_obj = std::make_shared<IVirtualAmiibo>(std::move(amiibo));
                 out_amiibo.SetValue(std::move(amiibo_obj));
                 return ams::ResultSuccess();
             }
 
         private:
             void GetEmulationStatus(ams::sf::Out<sys::EmulationStatus> out_status) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetEmulationStatus);
                 auto status = sys::GetEmulationStatus();
-                EMU_LOG_FMT("Emulation status: " << static_cast<u32>(status))
+                EMU_LOG_VERBOSE_FMT("Emulation status: " << static_cast<u32>(status))
                 out_status.SetValue(status);
             }
 
             void SetEmulationStatus(sys::EmulationStatus status) {
-                EMU_LOG_FMT("Emulation status: " << static_cast<u32>(status))
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::SetEmulationStatus);
+                EMU_LOG_VERBOSE_FMT("Emulation status: " << static_cast<u32>(status))
                 sys::SetEmulationStatus(status);
             }
 
             ams::Result GetActiveVirtualAmiibo(ams::sf::Out<std::shared_ptr<IVirtualAmiibo>> out_amiibo) {
-                auto &amiibo = sys::GetActiveVirtualAmiibo();
-                return OpenAmiiboImpl(amiibo, out_amiibo);
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetActiveVirtualAmiibo);
+                return OpenAmiiboImpl(sys::GetActiveVirtualAmiibo(), out_amiibo);
             }
 
             void ResetActiveVirtualAmiibo() {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::ResetActiveVirtualAmiibo);
                 EMU_LOG_FMT("Resetting active virtual amiibo...")
-                amiibo::VirtualAmiibo empty_amiibo;
-                sys::SetActiveVirtualAmiibo(empty_amiibo);
+                sys::SetActiveVirtualAmiibo(nullptr);
             }
 
             void GetActiveVirtualAmiiboStatus(ams::sf::Out<sys::VirtualAmiiboStatus> out_status) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetActiveVirtualAmiiboStatus);
                 auto status = sys::GetActiveVirtualAmiiboStatus();
-                EMU_LOG_FMT("Virtual amiibo status: " << static_cast<u32>(status))
+                EMU_LOG_VERBOSE_FMT("Virtual amiibo status: " << static_cast<u32>(status))
                 out_status.SetValue(status);
             }
 
             void SetActiveVirtualAmiiboStatus(sys::VirtualAmiiboStatus status) {
-                EMU_LOG_FMT("Virtual amiibo status: " << static_cast<u32>(status))
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::SetActiveVirtualAmiiboStatus);
+                EMU_LOG_VERBOSE_FMT("Virtual amiibo status: " << static_cast<u32>(status))
                 sys::SetActiveVirtualAmiiboStatus(status);
             }
 
             void GetVirtualAmiiboCount(ams::sf::Out<u32> out_count) {
-                auto count = sys::GetVirtualAmiiboCount();
-                EMU_LOG_FMT("Count: " << count)
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetVirtualAmiiboCount);
+                const u32 count = this->PinCatalog() ? this->catalog->GetCount() : 0;
+                EMU_LOG_VERBOSE_FMT("Count: " << count)
                 out_count.SetValue(count);
             }
 
             ams::Result OpenVirtualAmiibo(u32 idx, ams::sf::Out<std::shared_ptr<IVirtualAmiibo>> out_amiibo) {
-                auto amiibo_path = sys::GetVirtualAmiibo(idx);
-                amiibo::VirtualAmiibo amiibo(amiibo_path);
-                return OpenAmiiboImpl(amiibo, out_amiibo);
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::OpenVirtualAmiibo);
+                char amiibo_path[FS_MAX_PATH] = {};
+                R_TRY(this->EnsureCatalog(0xdead));
+                R_UNLESS(this->catalog->GetPath(idx, amiibo_path, sizeof(amiibo_path)), 0xdead);
+                return OpenAmiiboImpl(sys::LoadVirtualAmiibo(amiibo_path), out_amiibo);
             }
 
             void GetVersion(ams::sf::Out<Version> out_version) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetVersion);
                 out_version.SetValue(CurrentVersion);
             }
+
+            void GetSettings(ams::sf::Out<sys::Settings> out_settings) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetSettings);
+                out_settings.SetValue(sys::GetSettings());
+            }
+
+            void SetSettings(sys::Settings settings) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::SetSettings);
+                EMU_LOG_FMT("Updating settings...")
+                sys::SetSettings(settings);
+            }
+
+            void ReloadSettings() {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::ReloadSettings);
+                EMU_LOG_FMT("Reloading settings...")
+                sys::LoadSettings();
+                sys::LoadTitleProfiles();
+            }
+
+            void GetHeapStats(ams::sf::Out<mem::HeapStats> out_stats) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetHeapStats);
+                out_stats.SetValue(mem::GetHeapStats());
+            }
+
+            ams::Result OpenVirtualAmiiboById(u64 id, ams::sf::Out<std::shared_ptr<IVirtualAmiibo>> out_amiibo) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::OpenVirtualAmiiboById);
+                char amiibo_path[FS_MAX_PATH] = {};
+                R_TRY(this->EnsureCatalog(result::emu::ResultVirtualAmiiboNotFound));
+                R_UNLESS(this->catalog->GetPathById(id, amiibo_path, sizeof(amiibo_path)), result::emu::ResultVirtualAmiiboNotFound);
+                return OpenAmiiboImpl(sys::LoadVirtualAmiibo(amiibo_path), out_amiibo);
+            }
+
+            ams::Result SetActiveVirtualAmiiboById(u64 id) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::SetActiveVirtualAmiiboById);
+                EMU_LOG_VERBOSE_FMT("Id: 0x" << std::hex << id)
+                char amiibo_path[FS_MAX_PATH] = {};
+                R_TRY(this->EnsureCatalog(result::emu::ResultVirtualAmiiboNotFound));
+                R_UNLESS(this->catalog->GetPathById(id, amiibo_path, sizeof(amiibo_path)), result::emu::ResultVirtualAmiiboNotFound);
+                auto amiibo = sys::LoadVirtualAmiibo(amiibo_path);
+                R_UNLESS(amiibo != nullptr, result::emu::ResultVirtualAmiiboNotFound);
+                sys::SetActiveVirtualAmiibo(std::move(amiibo));
+                return ams::ResultSuccess();
+            }
+
+            ams::Result GetActiveVirtualAmiiboId(ams::sf::Out<u64> out_id) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetActiveVirtualAmiiboId);
+                auto amiibo = sys::GetActiveVirtualAmiibo();
+                R_UNLESS(amiibo != nullptr, result::emu::ResultNoAmiiboLoaded);
+                u64 id = 0;
+                R_UNLESS(sys::GetVirtualAmiiboId(amiibo->GetPath(), id), result::emu::ResultVirtualAmiiboNotFound);
+                out_id.SetValue(id);
+                return ams::ResultSuccess();
+            }
+
+            // Ids in catalog order, so that clients can list the whole library without opening every virtual amiibo
+            void GetVirtualAmiiboIds(u32 offset, const ams::sf::OutBuffer &out_ids, ams::sf::Out<u32> out_count) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetVirtualAmiiboIds);
+                const u32 max_count = out_ids.GetSize() / sizeof(u64);
+                auto ids = reinterpret_cast<u64*>(out_ids.GetPointer());
+                u32 count = 0;
+                if(this->PinCatalog()) {
+                    count = this->catalog->ListEntries(offset, max_count, [&](const sys::CatalogEntry &entry) {
+                        ids[count] = entry.id;
+                        count++;
+                    });
+                }
+                out_count.SetValue(count);
+            }
+
+            // Filtering happens over the catalog's indices, so clients only get the matching ids
+            void QueryVirtualAmiibos(sys::VirtualAmiiboQuery query, const ams::sf::OutBuffer &out_ids, ams::sf::Out<u32> out_count, ams::sf::Out<u32> out_next_cursor) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::QueryVirtualAmiibos);
+                const u32 max_count = out_ids.GetSize() / sizeof(u64);
+                auto ids = reinterpret_cast<u64*>(out_ids.GetPointer());
+                u32 count = 0;
+                u32 next_cursor = sys::VirtualAmiiboQueryEndCursor;
+                if(this->PinCatalog()) {
+                    count = this->catalog->Query(query, ids, max_count, next_cursor);
+                }
+                EMU_LOG_VERBOSE_FMT("Query flags: " << query.flags << ", found count: " << count << ", next cursor: " << next_cursor)
+                out_count.SetValue(count);
+                out_next_cursor.SetValue(next_cursor);
+            }
+
+            // Lists a single level of the amiibo directory, child folders first
+            ams::Result ListFolder(u64 folder_id, u32 offset, const ams::sf::OutBuffer &out_items, ams::sf::Out<u32> out_count, ams::sf::Out<u32> out_total_count) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::ListFolder);
+                R_TRY(this->EnsureCatalog(result::emu::ResultFolderNotFound));
+                const u32 max_count = out_items.GetSize() / sizeof(sys::VirtualAmiiboFolderItem);
+                auto items = reinterpret_cast<sys::VirtualAmiiboFolderItem*>(out_items.GetPointer());
+                u32 count = 0;
+                u32 total_count = 0;
+                R_UNLESS(this->catalog->ListFolder(folder_id, offset, items, max_count, count, total_count), result::emu::ResultFolderNotFound);
+                out_count.SetValue(count);
+                out_total_count.SetValue(total_count);
+                return ams::ResultSuccess();
+            }
+
+            void GetStatusChangeEvent(ams::sf::Out<ams::sf::CopyHandle> out_event) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetStatusChangeEvent);
+                if(!this->status_change_event_registered) {
+                    this->status_change_event.InitializeAsInterProcessEvent();
+                    sys::RegisterStatusChangeEvent(&this->status_change_event);
+                    this->status_change_event_registered = true;
+                }
+                out_event.SetValue(this->status_change_event.GetReadableHandle());
+            }
+
+            void GetEmulationStatusSnapshot(ams::sf::Out<sys::EmulationStatusSnapshot> out_snapshot) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetEmulationStatusSnapshot);
+                out_snapshot.SetValue(sys::GetEmulationStatusSnapshot());
+            }
+
+            // Stats are kept for every interface, offset is only used to keep listing when the buffer wasn't big enough
+            void GetCommandStats(u32 offset, const ams::sf::OutBuffer &out_stats, ams::sf::Out<u32> out_count) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetCommandStats);
+                const u32 max_count = out_stats.GetSize() / sizeof(ipc::CommandStats);
+                out_count.SetValue(ipc::GetCommandStats(offset, reinterpret_cast<ipc::CommandStats*>(out_stats.GetPointer()), max_count));
+            }
+
+            void ResetCommandStats() {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::ResetCommandStats);
+                ipc::ResetCommandStats();
+            }
+
+            // Stats are indexed by subsystem (see fs::Subsystem), per-command I/O is part of the command stats
+            void GetIoStats(const ams::sf::OutBuffer &out_stats, ams::sf::Out<u32> out_count) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetIoStats);
+                const u32 max_count = out_stats.GetSize() / sizeof(fs::IoStats);
+                out_count.SetValue(fs::GetIoStats(reinterpret_cast<fs::IoStats*>(out_stats.GetPointer()), max_count));
+            }
+
+            void ResetIoStats() {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::ResetIoStats);
+                fs::ResetIoStats();
+            }
+
+            void GetBootReport(const ams::sf::OutBuffer &out_report) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetBootReport);
+                const auto report = sys::GetBootReport();
+                memcpy(out_report.GetPointer(), &report, std::min(out_report.GetSize(), sizeof(report)));
+            }
+
+            // Library commands fail with ResultLibraryNotReady (or just list nothing) until the first scan finishes, the active virtual amiibo works meanwhile
+            void IsVirtualAmiiboLibraryReady(ams::sf::Out<bool> out_ready) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::IsVirtualAmiiboLibraryReady);
+                out_ready.SetValue(sys::IsVirtualAmiiboLibraryReady());
+            }
+
+            void GetVirtualAmiiboLibraryReadyEvent(ams::sf::Out<ams::sf::CopyHandle> out_event) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetVirtualAmiiboLibraryReadyEvent);
+                out_event.SetValue(sys::GetVirtualAmiiboLibraryReadyEvent().GetReadableHandle());
+            }
+
+            // Playlists are made of virtual amiibo ids, the first one is activated right away
+            ams::Result SetPlaylist(const ams::sf::InBuffer &ids, u32 advance_flags) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::SetPlaylist);
+                const u32 count = ids.GetSize() / sizeof(u64);
+                EMU_LOG_VERBOSE_FMT("Playlist entry count: " << count << ", advance flags: " << advance_flags)
+                R_UNLESS((count > 0) && (count <= sys::PlaylistMaxEntryCount), result::emu::ResultInvalidPlaylist);
+                R_TRY(this->EnsureCatalog(result::emu::ResultVirtualAmiiboNotFound));
+                R_UNLESS(sys::SetPlaylist(reinterpret_cast<const u64*>(ids.GetPointer()), count, advance_flags), result::emu::ResultVirtualAmiiboNotFound);
+                return ams::ResultSuccess();
+            }
+
+            void ClearPlaylist() {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::ClearPlaylist);
+                sys::ClearPlaylist();
+            }
+
+            void GetPlaylistStatus(ams::sf::Out<sys::PlaylistStatus> out_status) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetPlaylistStatus);
+                out_status.SetValue(sys::GetPlaylistStatus());
+            }
+
+            ams::Result AdvancePlaylist() {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::AdvancePlaylist);
+                R_UNLESS(sys::GetPlaylistStatus().entry_count > 0, result::emu::ResultInvalidPlaylist);
+                auto amiibo = sys::AdvancePlaylist();
+                R_UNLESS(amiibo != nullptr, result::emu::ResultVirtualAmiiboNotFound);
+                sys::SetActiveVirtualAmiibo(std::move(amiibo));
+                return ams::ResultSuccess();
+            }
+
+            // Devices (npads) follow the active virtual amiibo unless they are given their own one
+            ams::Result SetDeviceVirtualAmiiboById(u64 id, u32 npad_id) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::SetDeviceVirtualAmiiboById);
+                EMU_LOG_VERBOSE_FMT("Id: 0x" << std::hex << id << ", npad id: 0x" << npad_id)
+                R_UNLESS(sys::GetDeviceSlot(npad_id) != sys::InvalidDeviceSlot, result::emu::ResultDeviceNotFound);
+                char amiibo_path[FS_MAX_PATH] = {};
+                R_TRY(this->EnsureCatalog(result::emu::ResultVirtualAmiiboNotFound));
+                R_UNLESS(this->catalog->GetPathById(id, amiibo_path, sizeof(amiibo_path)), result::emu::ResultVirtualAmiiboNotFound);
+                auto amiibo = sys::LoadVirtualAmiibo(amiibo_path);
+                R_UNLESS(amiibo != nullptr, result::emu::ResultVirtualAmiiboNotFound);
+                amiibo->Prewarm();
+                sys::SetDeviceVirtualAmiibo(npad_id, std::move(amiibo));
+                return ams::ResultSuccess();
+            }
+
+            ams::Result ResetDeviceVirtualAmiibo(u32 npad_id) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::ResetDeviceVirtualAmiibo);
+                R_UNLESS(sys::SetDeviceVirtualAmiibo(npad_id, nullptr), result::emu::ResultDeviceNotFound);
+                return ams::ResultSuccess();
+            }
+
+            ams::Result SetDeviceVirtualAmiiboStatus(u32 npad_id, sys::VirtualAmiiboStatus status) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::SetDeviceVirtualAmiiboStatus);
+                EMU_LOG_VERBOSE_FMT("Npad id: 0x" << std::hex << npad_id << ", virtual amiibo status: " << std::dec << static_cast<u32>(status))
+                R_UNLESS(sys::SetDeviceVirtualAmiiboStatus(npad_id, status), result::emu::ResultDeviceNotFound);
+                return ams::ResultSuccess();
+            }
+
+            ams::Result GetDeviceStatus(u32 npad_id, ams::sf::Out<sys::DeviceStatus> out_status) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::GetDeviceStatus);
+                sys::DeviceStatus status;
+                R_UNLESS(sys::GetDeviceStatus(npad_id, status), result::emu::ResultDeviceNotFound);
+                out_status.SetValue(status);
+                return ams::ResultSuccess();
+            }
+
+            // The whole virtual amiibo in a single archive (see sys::VirtualAmiiboArchiveHeader), nothing is written if the buffer is smaller than the returned size
+            ams::Result ExportVirtualAmiibo(u64 id, const ams::sf::OutBuffer &out_archive, ams::sf::Out<u64> out_size) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::ExportVirtualAmiibo);
+                EMU_LOG_VERBOSE_FMT("Id: 0x" << std::hex << id)
+                char amiibo_path[FS_MAX_PATH] = {};
+                R_TRY(this->EnsureCatalog(result::emu::ResultVirtualAmiiboNotFound));
+                R_UNLESS(this->catalog->GetPathById(id, amiibo_path, sizeof(amiibo_path)), result::emu::ResultVirtualAmiiboNotFound);
+                size_t size = 0;
+                R_UNLESS(sys::ExportVirtualAmiibo(amiibo_path, out_archive.GetPointer(), out_archive.GetSize(), size), result::emu::ResultVirtualAmiiboNotFound);
+                out_size.SetValue(size);
+                return ams::ResultSuccess();
+            }
+
+            // Imports an archive as a new virtual amiibo at the given path (relative to the amiibo directory), returning its id
+            // The session's catalog is replaced by the updated one, so that the new id can be used right away
+            ams::Result ImportVirtualAmiibo(const ams::sf::InBuffer &archive, const ams::sf::InBuffer &path, ams::sf::Out<u64> out_id) {
+                EMU_IPC_COMMAND_STATS_SCOPE(Emulation, CommandId::ImportVirtualAmiibo);
+                char relative_path[FS_MAX_PATH] = {};
+                memcpy(relative_path, path.GetPointer(), std::min(path.GetSize(), sizeof(relative_path) - 1));
+                EMU_LOG_VERBOSE_FMT("Path: '" << relative_path << "', archive size: " << archive.GetSize())
+                R_UNLESS(sys::IsValidImportPath(relative_path), result::emu::ResultInvalidImportPath);
+                R_UNLESS(sys::IsValidVirtualAmiiboArchive(archive.GetPointer(), archive.GetSize()), result::emu::ResultInvalidArchive);
+                const auto amiibo_path = fs::Concat(consts::AmiiboDir, relative_path);
+                R_UNLESS(!fs::IsDirectory(amiibo_path) && !fs::IsFile(amiibo_path), result::emu::ResultVirtualAmiiboAlreadyExists);
+                R_UNLESS(sys::ImportVirtualAmiibo(archive.GetPointer(), archive.GetSize(), relative_path), result::emu::ResultImportFailed);
+                this->catalog = sys::GetVirtualAmiiboCatalog();
+                out_id.SetValue(sys::ComputeVirtualAmiiboId(relative_path));
+                return ams::ResultSuccess();
+            }
         
         public:
-            IEmulationService() {
-                sys::UpdateVirtualAmiiboCache();
+            IEmulationService() : status_change_event_registered(false) {
+                // The rescan happens in the background (while the library is being initialized it's already in progress), this session keeps the current catalog
+                if(sys::IsVirtualAmiiboLibraryReady() && sys::ShouldUpdateCacheOnEmuSession()) {
+                    sys::QueueVirtualAmiiboCacheUpdate();
+                }
+                this->catalog = sys::GetVirtualAmiiboCatalog();
+            }
+
+            ~IEmulationService() {
+                if(this->status_change_event_registered) {
+                    sys::UnregisterStatusChangeEvent(&this->status_change_event);
+                }
             }
 
         public:
@@ -98,6 +430,35 @@ namespace ipc::emu {
                 MAKE_SERVICE_COMMAND_META(GetVirtualAmiiboCount),
                 MAKE_SERVICE_COMMAND_META(OpenVirtualAmiibo),
                 MAKE_SERVICE_COMMAND_META(GetVersion),
+                MAKE_SERVICE_COMMAND_META(GetSettings),
+                MAKE_SERVICE_COMMAND_META(SetSettings),
+                MAKE_SERVICE_COMMAND_META(ReloadSettings),
+                MAKE_SERVICE_COMMAND_META(GetHeapStats),
+                MAKE_SERVICE_COMMAND_META(OpenVirtualAmiiboById),
+                MAKE_SERVICE_COMMAND_META(SetActiveVirtualAmiiboById),
+                MAKE_SERVICE_COMMAND_META(GetActiveVirtualAmiiboId),
+                MAKE_SERVICE_COMMAND_META(GetVirtualAmiiboIds),
+                MAKE_SERVICE_COMMAND_META(QueryVirtualAmiibos),
+                MAKE_SERVICE_COMMAND_META(ListFolder),
+                MAKE_SERVICE_COMMAND_META(GetStatusChangeEvent),
+                MAKE_SERVICE_COMMAND_META(GetEmulationStatusSnapshot),
+                MAKE_SERVICE_COMMAND_META(GetCommandStats),
+                MAKE_SERVICE_COMMAND_META(ResetCommandStats),
+                MAKE_SERVICE_COMMAND_META(GetIoStats),
+                MAKE_SERVICE_COMMAND_META(ResetIoStats),
+                MAKE_SERVICE_COMMAND_META(GetBootReport),
+                MAKE_SERVICE_COMMAND_META(IsVirtualAmiiboLibraryReady),
+                MAKE_SERVICE_COMMAND_META(GetVirtualAmiiboLibraryReadyEvent),
+                MAKE_SERVICE_COMMAND_META(SetPlaylist),
+                MAKE_SERVICE_COMMAND_META(ClearPlaylist),
+                MAKE_SERVICE_COMMAND_META(GetPlaylistStatus),
+                MAKE_SERVICE_COMMAND_META(AdvancePlaylist),
+                MAKE_SERVICE_COMMAND_META(SetDeviceVirtualAmiiboById),
+                MAKE_SERVICE_COMMAND_META(ResetDeviceVirtualAmiibo),
+                MAKE_SERVICE_COMMAND_META(SetDeviceVirtualAmiiboStatus),
+                MAKE_SERVICE_COMMAND_META(GetDeviceStatus),
+                MAKE_SERVICE_COMMAND_META(ExportVirtualAmiibo),
+                MAKE_SERVICE_COMMAND_META(ImportVirtualAmiibo),
             };
     };
 
@@ -9,7 +9,7 @@ namespace ipc::emu {
     class IVirtualAmiibo final : public ams::sf::IServiceObject {
 
         private:
-            amiibo::VirtualAmiibo virtual_amiibo;
+            std::shared_ptr<amiibo::VirtualAmiibo> virtual_amiibo;
 
         private:
             enum class CommandId {
@@ -23,15 +23,16 @@ namespace ipc::emu {
             }
 
             void GetName(const ams::sf::OutBuffer &out_name) {
-                CopyStringToOutBuffer(this->virtual_amiibo.GetName(), out_name);
+                EMU_READ_LOCK_SCOPE_WITH(this->virtual_amiibo->GetLock());
+                CopyStringToOutBuffer(this->virtual_amiibo->GetName(), out_name);
             }
 
             void GetPath(const ams::sf::OutBuffer &out_path) {
-                CopyStringToOutBuffer(this->virtual_amiibo.GetPath(), out_path);
+                CopyStringToOutBuffer(this->virtual_amiibo->GetPath(), out_path);
             }
 
         public:
-            IVirtualAmiibo(amiibo::VirtualAmiibo amiibo) : virtual_amiibo(amiibo) {}
+            IVirtualAmiibo(std::shared_ptr<amiibo::VirtualAmiibo> amiibo) : virtual_amiibo(std::move(amiibo)) {}
 
         public:
             DEFINE_SERVICE_DISPATCH_TABLE {
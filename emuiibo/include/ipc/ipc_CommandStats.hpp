@@ -0,0 +1,63 @@
+
+#pragma once
+#include <emu_Types.hpp>
+#include <atomic>
+
+namespace ipc {
+
+    // Every command records how long it took into a log2-scaled histogram, along with the SD card I/O it did
+    // Recording is just a few relaxed atomic operations, so it's always enabled
+
+    enum class CommandStatsInterface : u32 {
+        // ICommonInterface and the nfp:user/nfp:sys interfaces implementing it
+        Nfp,
+        Emulation,
+
+        Count
+    };
+
+    // Highest command id of each interface plus one (nfp:sys-only commands go from 100 to 106), commands with higher ids aren't recorded
+    static inline constexpr u32 CommandStatsNfpCommandCount = 107;
+    static inline constexpr u32 CommandStatsEmulationCommandCount = 38;
+
+    // Bucket i holds latencies in [2^i, 2^(i + 1)) microseconds, the last one also holds anything slower
+    static inline constexpr u32 CommandStatsBucketCount = 0x10;
+
+    struct CommandStats {
+        CommandStatsInterface iface;
+        u32 command_id;
+        u32 count;
+        u32 reserved;
+        u64 total_time_us;
+        u64 max_time_us;
+        u32 buckets[CommandStatsBucketCount];
+        fs::IoStats io;
+    };
+
+    static_assert(sizeof(CommandStats) == 0x90, "Invalid CommandStats struct!");
+
+    void RecordCommand(CommandStatsInterface iface, u32 command_id, u64 elapsed_ticks);
+
+    // Only lists commands which were called at least once
+    u32 GetCommandStats(u32 offset, CommandStats *out_stats, u32 max_count);
+    void ResetCommandStats();
+
+    class CommandStatsScope {
+
+        private:
+            CommandStatsInterface iface;
+            u32 command_id;
+            u64 start_tick;
+            fs::IoCounters *prev_io_counters;
+            // Temporary allocations made by the command are released all at once when it ends
+            mem::ScratchScope scratch;
+
+        public:
+            CommandStatsScope(CommandStatsInterface iface, u32 command_id);
+            ~CommandStatsScope();
+
+    };
+
+}
+
+#define EMU_IPC_COMMAND_STATS_SCOPE(iface, cmd_id) ::ipc::CommandStatsScope cmd_stats_scope(::ipc::CommandStatsInterface::iface, static_cast<u32>(cmd_id))
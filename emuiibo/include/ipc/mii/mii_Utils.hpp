@@ -4,7 +4,8 @@
 
 namespace ipc::mii {
 
-    void DumpSystemMiis();
+    // Returns how many miis were dumped
+    u32 DumpSystemMiis();
 
     static inline constexpr const char *NewMiiName = "emuiibo";
     
@@ -3,6 +3,9 @@
 #include <ipc/nfp/nfp_Types.hpp>
 #include <emu_Results.hpp>
 #include <sys/sys_Emulation.hpp>
+#include <sys/sys_Devices.hpp>
+#include <sys/sys_Profiles.hpp>
+#include <ipc/ipc_CommandStats.hpp>
 
 namespace ipc::nfp {
 
@@ -57,27 +60,58 @@ namespace ipc::nfp {
     class ICommonInterface : public ams::sf::IServiceObject {
 
         protected:
+            // Same ids as the implementing interfaces, for command stats
+            enum class CommonCommandId {
+                NFP_COMMON_IFACE_COMMAND_IDS
+            };
+
+            // Every npad is a separate device, indexed by its slot (see sys::GetDeviceSlot)
+            struct Device {
+                NfpDeviceState state;
+                sys::VirtualAmiiboStatus last_notified_status;
+                // Only created once the client attaches them
+                ams::os::SystemEvent event_activate;
+                ams::os::SystemEvent event_deactivate;
+                bool events_initialized;
+                // Whether the device's virtual amiibo was read since detection started, which makes up a tag session for playlists
+                bool tag_info_read;
+            };
+
             NfpState state;
-            NfpDeviceState device_state;
-            ams::os::SystemEvent event_activate;
-            ams::os::SystemEvent event_deactivate;
+            Device devices[sys::DeviceSlotCount];
             ams::os::SystemEvent event_availability_change;
             Service *forward_service;
 
             Lock emu_scan_lock;
-            sys::VirtualAmiiboStatus last_notified_status;
             ams::os::Thread scan_thread;
             bool should_exit_thread;
 
+            void FinishTagSession(Device &device);
+            void SetAllDeviceStates(NfpDeviceState state);
+
+            inline Device *GetDevice(DeviceHandle handle) {
+                const auto slot = sys::GetDeviceSlot(handle.npad_id);
+                return (slot != sys::InvalidDeviceSlot) ? &this->devices[slot] : nullptr;
+            }
+
+            inline void InitializeDeviceEvents(Device &device) {
+                EMU_LOCK_SCOPE_WITH(this->emu_scan_lock);
+                if(!device.events_initialized) {
+                    device.event_activate.InitializeAsInterProcessEvent();
+                    device.event_deactivate.InitializeAsInterProcessEvent();
+                    device.events_initialized = true;
+                }
+            }
+
         public:
             ICommonInterface(Service *fwd);
             ~ICommonInterface();
 
-            void HandleVirtualAmiiboStatus(sys::VirtualAmiiboStatus status);
+            void HandleVirtualAmiiboStatus(u32 slot, sys::VirtualAmiiboStatus status);
 
-            inline NfpDeviceState GetDeviceStateValue() {
+            inline NfpDeviceState GetDeviceStateValue(u32 slot) {
                 EMU_LOCK_SCOPE_WITH(this->emu_scan_lock);
-                return this->device_state;
+                return this->devices[slot].state;
             }
 
             inline void NotifyShouldExitThread() {
@@ -106,9 +140,9 @@ namespace ipc::nfp {
             // TODO: check for proper states in commands
 
             template<typename ...Ss>
-            inline constexpr bool IsDeviceStateAny(Ss &&...states) {
+            inline constexpr bool IsDeviceStateAny(u32 slot, Ss &&...states) {
                 bool ret = false;
-                auto state = this->GetDeviceStateValue();
+                auto state = this->GetDeviceStateValue(slot);
                 (IsInDeviceStateImpl(ret, state, states), ...);
                 return ret;
             }
@@ -162,6 +196,8 @@ namespace ipc::nfp {
         public:
             ICommonManager(std::shared_ptr<::Service> &&s, const ams::sm::MitmProcessInfo &c) : IMitmServiceObject(std::forward<std::shared_ptr<::Service>>(s), c) {
                 EMU_LOG_FMT("Accessed manager with application ID 0x" << std::hex << std::setw(16) << std::setfill('0') << std::uppercase << c.program_id.value)
+                // Managers are created way before the title's first scan, so the profile's virtual amiibo is usually ready (and prewarmed) by then
+                sys::QueueTitleProfile(c.program_id.value);
             }
 
             static bool ShouldMitm(const ams::sm::MitmProcessInfo &client_info) {
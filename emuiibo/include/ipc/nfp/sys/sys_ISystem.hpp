@@ -20,13 +20,25 @@ namespace ipc::nfp::sys {
                 ExistsApplicationArea = 106,
             };
 
+            static_assert(static_cast<u32>(CommandId::ExistsApplicationArea) < ipc::CommandStatsNfpCommandCount, "nfp:sys commands wouldn't be recorded");
+
         NFP_USE_CTOR_OF(ICommonInterface)
 
+        private:
+            // Like game commands, these work on the device's virtual amiibo
+            inline std::shared_ptr<amiibo::VirtualAmiibo> GetDeviceVirtualAmiibo(DeviceHandle handle) {
+                auto amiibo = ::sys::GetDeviceVirtualAmiibo(handle.npad_id);
+                if((amiibo != nullptr) && amiibo->IsValid()) {
+                    return amiibo;
+                }
+                return nullptr;
+            }
+
         protected:
             ams::Result Format(DeviceHandle handle);
             ams::Result GetAdminInfo(ams::sf::Out<AdminInfo> out_info, DeviceHandle handle);
-            ams::Result GetRegisterInfo2(ams::sf::Out<RegisterInfo> out_info, DeviceHandle handle);
-            ams::Result SetRegisterInfo(DeviceHandle handle, const RegisterInfo &info);
+            ams::Result GetRegisterInfo2(ams::sf::Out<RegisterInfoPrivate> out_info, DeviceHandle handle);
+            ams::Result SetRegisterInfo(DeviceHandle handle, const RegisterInfoPrivate &info);
             ams::Result DeleteRegisterInfo(DeviceHandle handle);
             ams::Result DeleteApplicationArea(DeviceHandle handle);
             ams::Result ExistsApplicationArea(ams::sf::Out<u8> out_exists, DeviceHandle handle);
@@ -0,0 +1,48 @@
+#pragma once
+#include <amiibo/amiibo_Formats.hpp>
+
+namespace sys {
+
+    // Whole virtual amiibos are transferred as a single archive: a header, followed by every file (a file header and then its data)
+    // Only the files the current format needs are archived (amiibo.json, amiibo.flag, the mii charinfo file and every area), amiibo.cache is regenerated on import
+
+    struct VirtualAmiiboArchiveHeader {
+        static constexpr u32 Magic = 0x43524145; // "EARC"
+        static constexpr u32 CurrentFormatVersion = 1;
+
+        u32 magic;
+        u32 format_version;
+        u32 file_count;
+        u32 reserved;
+        // The whole archive, header included
+        u64 size;
+        u8 reserved_2[0x8];
+    };
+
+    static_assert(sizeof(VirtualAmiiboArchiveHeader) == 0x20, "Invalid VirtualAmiiboArchiveHeader struct!");
+
+    struct VirtualAmiiboArchiveFileHeader {
+        // Relative to the virtual amiibo directory, areas are "areas/0x<area id>.bin"
+        char name[0x38];
+        u64 size;
+    };
+
+    static_assert(sizeof(VirtualAmiiboArchiveFileHeader) == 0x40, "Invalid VirtualAmiiboArchiveFileHeader struct!");
+
+    static inline constexpr u32 VirtualAmiiboArchiveMaxFileCount = 0x40;
+
+    // Archives the virtual amiibo under its lock, using the loaded instance if there is one
+    // The archive is only written if it fits in the buffer, its size is returned anyway so that the caller can retry with a bigger one
+    bool ExportVirtualAmiibo(const char *amiibo_path, u8 *buf, size_t buf_size, size_t &out_size);
+
+    // Paths are relative to the amiibo directory, without empty, "." or ".." components
+    bool IsValidImportPath(const char *relative_path);
+    // Checks the archive's layout and file names, which must include amiibo.json and amiibo.flag
+    bool IsValidVirtualAmiiboArchive(const u8 *archive, size_t archive_size);
+
+    // Files are written straight from the archive into a staging directory, which is moved into place once the virtual amiibo is complete
+    // This way neither scans nor the catalog ever see a partially imported virtual amiibo, the catalog is then updated without rescanning
+    // Expects a valid archive and path, fails if there's already something at the path
+    bool ImportVirtualAmiibo(const u8 *archive, size_t archive_size, const char *relative_path);
+
+}
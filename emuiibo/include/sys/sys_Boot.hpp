@@ -0,0 +1,73 @@
+#pragma once
+#include <emu_Types.hpp>
+
+namespace sys {
+
+    // Startup is split in sequential phases: beginning a phase ends the previous one, and finishing the boot ends the last one
+    // Phase markers are ignored once the boot is finished, so code shared with later rescans can mark phases unconditionally
+
+    enum class BootPhase : u32 {
+        SmInitialize,
+        FsInitialize,
+        SdCardMount,
+        TimeInitialize,
+        HidInitialize,
+        MiiInitialize,
+        // Directories and settings
+        Settings,
+        // Entry count: miis dumped
+        MiiDump,
+        // Entry count: directories listed
+        AmiiboScan,
+        // Entry count: legacy virtual amiibos converted
+        LegacyConversion,
+        // Entry count: virtual amiibos in the catalog
+        CatalogBuild,
+        ServiceRegistration,
+        EmulationStateRestore,
+
+        Count
+    };
+
+    static inline constexpr u32 BootReportMaxPhaseCount = 0x10;
+
+    static_assert(static_cast<u32>(BootPhase::Count) <= BootReportMaxPhaseCount, "Too many boot phases!");
+
+    struct BootPhaseRecord {
+        // Relative to the start of the first phase
+        u64 start_time_us;
+        u64 duration_us;
+        u32 entry_count;
+        // Phases which were skipped (disabled by settings) aren't marked as done
+        bool done;
+        u8 reserved[3];
+    };
+
+    static_assert(sizeof(BootPhaseRecord) == 0x18, "Invalid BootPhaseRecord struct!");
+
+    struct BootReport {
+        // Since the console booted
+        u64 process_start_time_us;
+        // Relative to the start of the first phase, the library is initialized after this (while requests are already being processed)
+        u64 services_registered_time_us;
+        // Zero until the boot finishes
+        u64 total_time_us;
+        u32 phase_count;
+        u32 reserved;
+        BootPhaseRecord phases[BootReportMaxPhaseCount];
+    };
+
+    static_assert(sizeof(BootReport) == 0x1A0, "Invalid BootReport struct!");
+
+    void BeginBootPhase(BootPhase phase);
+    // Sets the current phase's entry count
+    void SetBootPhaseEntryCount(u32 count);
+    // Also ends the current phase
+    void NotifyBootServicesRegistered();
+    // The report is also saved to the SD card, so that it can be checked even if emuiibo doesn't make it to the overlay
+    void FinishBoot();
+
+    bool IsBootFinished();
+    BootReport GetBootReport();
+
+}
@@ -0,0 +1,308 @@
+#pragma once
+#include <emu_Types.hpp>
+#include <memory>
+#include <algorithm>
+
+namespace sys {
+
+    // The virtual amiibo library is stored on the SD card as a sorted array of fixed-size entries, and read through a small page cache
+    // This way memory usage stays the same no matter how many virtual amiibos there are
+    // Each entry only holds the virtual amiibo's directory name, its parent directories are interned in a directory table, which is kept in memory
+    // Directory names (and the rare entry names too long for their entry) are stored in a name pool, which is kept in memory too
+
+    struct CatalogHeader {
+        static constexpr u32 Magic = 0x54414345; // "ECAT"
+        static constexpr u32 CurrentFormatVersion = 6;
+
+        u32 magic;
+        u32 format_version;
+        u32 entry_count;
+        // Only valid virtual amiibos are in the name/amiibo id indices
+        u32 indexed_count;
+        u32 dir_count;
+        // Name pool size
+        u32 dir_names_size;
+        u8 reserved[0x8];
+    };
+
+    static_assert(sizeof(CatalogHeader) == 0x20, "Invalid CatalogHeader struct!");
+
+    // File layout: header, entries (sorted by directory and then by name), id index, name index, amiibo id index, directories, name pool
+
+    struct CatalogEntry {
+        u64 id;
+        u32 dir_idx;
+        // Offset of the name in the name pool if it doesn't fit below (which then holds as much of it as fits)
+        u32 name_offset;
+        char name[0x70];
+    };
+
+    static_assert(sizeof(CatalogEntry) == 0x80, "Invalid CatalogEntry struct!");
+
+    // Entry indices sorted by id, for id lookups
+
+    struct CatalogIdRecord {
+        u64 id;
+        u32 entry_idx;
+        u32 reserved;
+    };
+
+    static_assert(sizeof(CatalogIdRecord) == 0x10, "Invalid CatalogIdRecord struct!");
+
+    // Virtual amiibo ids sorted by amiibo name (case-insensitive)
+
+    struct CatalogNameRecord {
+        char name[RegisterInfoImpl::AmiiboNameLength + 1];
+        AmiiboId amiibo_id;
+        u64 id;
+        u8 reserved[0x8];
+    } PACKED;
+
+    static_assert(sizeof(CatalogNameRecord) == 0x40, "Invalid CatalogNameRecord struct!");
+
+    // Virtual amiibo ids sorted by (series, game character id, figure type)
+
+    struct CatalogAmiiboIdRecord {
+        u8 series;
+        u8 figure_type;
+        u16 game_character_id;
+        u32 reserved;
+        u64 id;
+    };
+
+    static_assert(sizeof(CatalogAmiiboIdRecord) == 0x10, "Invalid CatalogAmiiboIdRecord struct!");
+
+    // Filter for catalog queries, every set field must match
+    // Results are sorted by name when filtering by name prefix (or by nothing from the amiibo id), otherwise by amiibo id fields
+
+    enum VirtualAmiiboQueryFlag : u32 {
+        VirtualAmiiboQueryFlag_Series = BIT(0),
+        VirtualAmiiboQueryFlag_GameCharacterId = BIT(1),
+        VirtualAmiiboQueryFlag_FigureType = BIT(2),
+    };
+
+    struct VirtualAmiiboQuery {
+        u32 flags;
+        // Position to resume from, zero for the first page
+        u32 cursor;
+        u8 series;
+        u8 figure_type;
+        u16 game_character_id;
+        // Empty for any name
+        char name_prefix[RegisterInfoImpl::AmiiboNameLength + 1];
+        u8 reserved[0xB];
+    };
+
+    static_assert(sizeof(VirtualAmiiboQuery) == 0x40, "Invalid VirtualAmiiboQuery struct!");
+
+    static inline constexpr u32 VirtualAmiiboQueryEndCursor = UINT32_MAX;
+
+    // Directories are sorted breadth-first (siblings by name), so every directory comes after its parent and siblings are contiguous
+    // The amiibo directory itself is the first one, with an empty name
+
+    struct CatalogDirectory {
+        // Same as virtual amiibo ids, the hash of the path relative to the amiibo directory
+        u64 id;
+        u32 parent_idx;
+        u32 name_offset;
+        u32 first_child_idx;
+        u32 child_count;
+        // Entries inside a directory are contiguous
+        u32 first_entry_idx;
+        u32 entry_count;
+    };
+
+    static_assert(sizeof(CatalogDirectory) == 0x20, "Invalid CatalogDirectory struct!");
+
+    // Folder listings have child folders first, then virtual amiibos
+
+    enum VirtualAmiiboFolderItemType : u8 {
+        VirtualAmiiboFolderItemType_Folder = 0,
+        VirtualAmiiboFolderItemType_VirtualAmiibo = 1,
+    };
+
+    struct VirtualAmiiboFolderItem {
+        // Folder id or virtual amiibo id, depending on the type
+        u64 id;
+        VirtualAmiiboFolderItemType type;
+        u8 reserved[3];
+        char name[0x74];
+    };
+
+    static_assert(sizeof(VirtualAmiiboFolderItem) == 0x80, "Invalid VirtualAmiiboFolderItem struct!");
+
+    // The amiibo directory itself
+    static inline constexpr u64 CatalogRootFolderId = 0;
+
+    static inline constexpr u32 CatalogRootDirectoryIndex = 0;
+    static inline constexpr u32 CatalogInvalidDirectoryIndex = UINT32_MAX;
+    static inline constexpr u32 CatalogInlineEntryName = UINT32_MAX;
+
+    static inline constexpr size_t CatalogPageSize = 0x1000;
+    static inline constexpr u32 CatalogPendingEntryCount = 0x80;
+    // Every sorter gets the same buffer size, several of them are alive at once while finalizing
+    static inline constexpr size_t CatalogSortBufferSize = 0x2000;
+    // Records scanned per query call at most, so that a very selective query can't block the server for long
+    static inline constexpr u32 CatalogMaxQueryScanCount = 0x400;
+
+    static inline constexpr u64 FnvOffsetBasis = 0xCBF29CE484222325;
+    static inline constexpr u64 FnvPrime = 0x100000001B3;
+
+    inline u64 HashFnv1a(const void *data, size_t size, u64 hash = FnvOffsetBasis) {
+        const auto bytes = reinterpret_cast<const u8*>(data);
+        for(size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= FnvPrime;
+        }
+        return hash;
+    }
+
+    // Virtual amiibo ids are the hash of their path relative to the amiibo directory, so they don't change between scans (or boots)
+    inline u64 ComputeVirtualAmiiboId(const char *relative_path) {
+        return HashFnv1a(relative_path, strlen(relative_path));
+    }
+
+    class Catalog;
+
+    // Entries are buffered and spilled unsorted to the SD card when the buffer fills up
+    // Once all directories are known (and sorted), entries and ids are sorted and written to the final catalog file
+
+    class CatalogBuilder {
+        private:
+            std::unique_ptr<CatalogEntry[]> pending_entries;
+            u32 pending_entry_count;
+            FILE *unsorted_entries_file;
+            std::vector<CatalogDirectory> dirs;
+            std::vector<char> dir_names;
+            // Sorted by (parent index, name) hash, only needed while building
+            std::vector<std::pair<u64, u32>> dir_lookup;
+            std::string last_dir_path;
+            u32 last_dir_idx;
+            bool ok;
+
+            u32 InternDirectory(u32 parent_idx, const char *name, size_t name_len);
+            u32 InternDirectoryPath(const char *dir_path, size_t dir_path_len);
+            void SortDirectories(std::vector<u32> &out_remap);
+            void TrackEntry(const CatalogEntry &entry, u32 entry_idx);
+            bool SpillEntries();
+
+        public:
+            CatalogBuilder();
+            ~CatalogBuilder();
+
+            // Expects paths relative to the amiibo directory
+            bool Add(const char *path);
+            // Entries already in the base catalog (if any) reuse its index records instead of loading their virtual amiibos again
+            // Every entry in the base catalog is expected to be added too, otherwise its index records would be left behind
+            bool Finalize(const std::string &path, Catalog *base = nullptr);
+    };
+
+    // Catalogs are immutable once built, and each one owns its file: it's deleted along with the catalog
+    // The page cache is shared by all of them (old generations pinned by sessions don't add their own pages), hence the shared lock
+
+    class Catalog {
+        private:
+            std::string path;
+            // Tags this catalog's pages in the shared cache
+            u64 serial;
+            FILE *file;
+            u32 entry_count;
+            u32 indexed_count;
+            u64 entries_offset;
+            u64 ids_offset;
+            u64 names_offset;
+            u64 amiibo_ids_offset;
+            std::unique_ptr<CatalogDirectory[]> dirs;
+            u32 dir_count;
+            std::unique_ptr<char[]> dir_names;
+            u32 dir_names_size;
+            u32 cache_page_count;
+
+            static Lock &GetCacheLock();
+            const u8 *GetPage(u64 offset, size_t size);
+            bool IsValidEntry(const CatalogEntry &entry);
+
+            // Records never cross pages, since the page size is a multiple of every record's size
+            template<typename T>
+            inline const T *GetRecord(u64 section_offset, u32 record_count, u32 idx) {
+                static_assert((CatalogPageSize % sizeof(T)) == 0, "Invalid catalog record size!");
+                constexpr u32 RecordsPerPage = CatalogPageSize / sizeof(T);
+                const auto page_idx = idx / RecordsPerPage;
+                const auto page_record_count = std::min(RecordsPerPage, record_count - page_idx * RecordsPerPage);
+                auto page = this->GetPage(section_offset + page_idx * CatalogPageSize, page_record_count * sizeof(T));
+                if(page == nullptr) {
+                    return nullptr;
+                }
+                return reinterpret_cast<const T*>(page) + (idx % RecordsPerPage);
+            }
+
+            template<typename T, typename F>
+            bool LowerBound(u64 section_offset, u32 record_count, F is_before, u32 &out_pos);
+
+            template<typename T, typename F>
+            u32 QueryIndex(u64 section_offset, u32 start_pos, F classify, u64 *out_ids, u32 max_count, u32 &out_next_cursor);
+
+        public:
+            Catalog(const std::string &path, u32 cache_page_count);
+            ~Catalog();
+
+            inline bool IsValid() {
+                return this->file != nullptr;
+            }
+
+            inline u32 GetCount() {
+                return this->entry_count;
+            }
+
+            bool GetEntry(u32 idx, CatalogEntry &out_entry);
+            bool FindEntry(u64 id, u32 &out_idx);
+
+            // Rebuilds the entry's full path into the provided buffer, without any allocations
+            bool GetEntryPath(const CatalogEntry &entry, char *out_path, size_t out_path_size);
+            bool GetPath(u32 idx, char *out_path, size_t out_path_size);
+            bool GetPathById(u64 id, char *out_path, size_t out_path_size);
+
+            // Folders are only listed from the in-memory directory table, virtual amiibos need to read just the listed range
+            bool FindFolder(u64 folder_id, u32 &out_dir_idx);
+            bool ListFolder(u64 folder_id, u32 offset, VirtualAmiiboFolderItem *out_items, u32 max_count, u32 &out_count, u32 &out_total_count);
+
+            // Fills the buffer with the matching ids, returning how many were found and where to resume from
+            u32 Query(const VirtualAmiiboQuery &query, u64 *out_ids, u32 max_count, u32 &out_next_cursor);
+
+            // Calls the function for every entry in the range, returning how many were listed
+            template<typename F>
+            inline u32 ListEntries(u32 offset, u32 count, F fn) {
+                EMU_LOCK_SCOPE_WITH(GetCacheLock());
+                u32 listed_count = 0;
+                while((listed_count < count) && ((offset + listed_count) < this->entry_count)) {
+                    auto entry = this->GetRecord<CatalogEntry>(this->entries_offset, this->entry_count, offset + listed_count);
+                    if(entry == nullptr) {
+                        break;
+                    }
+                    fn(*entry);
+                    listed_count++;
+                }
+                return listed_count;
+            }
+
+            // Calls the functions for every name index record and then for every amiibo id index record, stopping as soon as one fails
+            template<typename FN, typename FA>
+            inline bool ListIndexRecords(FN name_fn, FA amiibo_id_fn) {
+                EMU_LOCK_SCOPE_WITH(GetCacheLock());
+                for(u32 i = 0; i < this->indexed_count; i++) {
+                    auto name_record = this->GetRecord<CatalogNameRecord>(this->names_offset, this->indexed_count, i);
+                    if((name_record == nullptr) || !name_fn(*name_record)) {
+                        return false;
+                    }
+                }
+                for(u32 i = 0; i < this->indexed_count; i++) {
+                    auto amiibo_id_record = this->GetRecord<CatalogAmiiboIdRecord>(this->amiibo_ids_offset, this->indexed_count, i);
+                    if((amiibo_id_record == nullptr) || !amiibo_id_fn(*amiibo_id_record)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+    };
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <sys/sys_Emulation.hpp>
+
+namespace sys {
+
+    // Every npad (players 1-8 and handheld) is a device with its own slot
+    // Slots follow the active virtual amiibo (and its status) unless they are given their own virtual amiibo
+    // Slots are read and updated atomically, so devices never contend with each other (or with the active virtual amiibo's lock)
+
+    static inline constexpr u32 DeviceSlotCount = 9;
+    static inline constexpr u32 InvalidDeviceSlot = DeviceSlotCount;
+    static inline constexpr u32 HandheldNpadId = 0x20;
+
+    struct DeviceStatus {
+        // Only valid when the device has a valid virtual amiibo
+        u64 virtual_amiibo_id;
+        VirtualAmiiboStatus virtual_amiibo_status;
+        u32 npad_id;
+        // Whether the device has its own virtual amiibo, instead of following the active one
+        bool has_own_virtual_amiibo;
+        bool connected;
+        u8 reserved[6];
+    };
+
+    static_assert(sizeof(DeviceStatus) == 0x18, "Invalid DeviceStatus struct!");
+
+    inline constexpr u32 GetDeviceSlot(u32 npad_id) {
+        if(npad_id < (DeviceSlotCount - 1)) {
+            return npad_id;
+        }
+        if(npad_id == HandheldNpadId) {
+            return DeviceSlotCount - 1;
+        }
+        return InvalidDeviceSlot;
+    }
+
+    inline constexpr u32 GetDeviceSlotNpadId(u32 slot) {
+        return (slot == (DeviceSlotCount - 1)) ? HandheldNpadId : slot;
+    }
+
+    // Connected npads are queried once and cached, the cache is refreshed after NpadCacheRefreshIntervalMs
+    static inline constexpr u64 NpadCacheRefreshIntervalMs = 500;
+    // Handheld is always listed when nothing is connected
+    u32 GetConnectedNpadIds(u32 *out_npad_ids, u32 max_count);
+    void InvalidateConnectedNpadCache();
+
+    std::shared_ptr<amiibo::VirtualAmiibo> GetDeviceVirtualAmiibo(u32 npad_id);
+    VirtualAmiiboStatus GetDeviceVirtualAmiiboStatus(u32 npad_id);
+    // A null virtual amiibo makes the device follow the active one again
+    bool SetDeviceVirtualAmiibo(u32 npad_id, std::shared_ptr<amiibo::VirtualAmiibo> amiibo);
+    // Devices following the active virtual amiibo change its status instead
+    bool SetDeviceVirtualAmiiboStatus(u32 npad_id, VirtualAmiiboStatus status);
+    bool GetDeviceStatus(u32 npad_id, DeviceStatus &out_status);
+
+}
@@ -15,14 +15,59 @@ namespace sys {
         Disconnected
     };
 
+    // Everything a client shows about emulation, fetched at once
+
+    struct EmulationStatusSnapshot {
+        // Increased on every change, so clients can tell whether anything changed since their last snapshot
+        u64 sequence_number;
+        // Only valid when there is an active virtual amiibo
+        u64 active_virtual_amiibo_id;
+        EmulationStatus emulation_status;
+        VirtualAmiiboStatus active_virtual_amiibo_status;
+    };
+
+    static_assert(sizeof(EmulationStatusSnapshot) == 0x18, "Invalid EmulationStatusSnapshot struct!");
+
     EmulationStatus GetEmulationStatus();
     void SetEmulationStatus(EmulationStatus status);
 
-    amiibo::VirtualAmiibo &GetActiveVirtualAmiibo();
+    // Virtual amiibos are shared instead of copied, so that their data is never duplicated
+    // A null pointer means that there is no active virtual amiibo
+
+    // Every loaded virtual amiibo is tracked by path, so that a path is never loaded twice: separate instances would have separate locks and caches, and overwrite each other's saves
+    // Returns the loaded instance for the path if there's one, otherwise loads (and tracks) it, returning null if it's not valid
+    std::shared_ptr<amiibo::VirtualAmiibo> LoadVirtualAmiibo(const std::string &amiibo_path);
+    // Only returns the loaded instance, if any
+    std::shared_ptr<amiibo::VirtualAmiibo> FindLoadedVirtualAmiibo(const std::string &amiibo_path);
+
+    std::shared_ptr<amiibo::VirtualAmiibo> GetActiveVirtualAmiibo();
     bool IsActiveVirtualAmiiboValid();
-    void SetActiveVirtualAmiibo(amiibo::VirtualAmiibo amiibo);
+    void SetActiveVirtualAmiibo(std::shared_ptr<amiibo::VirtualAmiibo> amiibo);
 
     VirtualAmiiboStatus GetActiveVirtualAmiiboStatus();
     void SetActiveVirtualAmiiboStatus(VirtualAmiiboStatus status);
+
+    EmulationStatusSnapshot GetEmulationStatusSnapshot();
+
+    // Registered events are signaled every time the emulation status, the active virtual amiibo or its status changes
+    // Each session registers its own event, so that clients clearing it don't affect each other
+
+    void RegisterStatusChangeEvent(ams::os::SystemEvent *event);
+    void UnregisterStatusChangeEvent(ams::os::SystemEvent *event);
+    // Devices with their own virtual amiibo (see sys_Devices) report their changes through the same events
+    void NotifyDeviceStatusChange();
+
+    // The emulation state is saved on every change, restoring it only needs the active virtual amiibo's path (no library scan)
+    // Returns whether a virtual amiibo was restored
+    bool RestoreEmulationState();
+    using BootWorkFunction = void(*)();
+
+    // Saving happens on a separate thread, after a delay: changes made meanwhile are saved all at once
+    // The boot work (if any) runs first on the same thread, so that no other thread (and stack) is kept around just for it
+    void StartEmulationStatePersistence(BootWorkFunction boot_work = nullptr);
+    // Virtual amiibo data changes are saved by the same thread, after the same delay (its lock must not be held when calling this)
+    void QueueVirtualAmiiboSave(std::shared_ptr<amiibo::VirtualAmiibo> amiibo);
+    // Rescans the library on the same thread, requests made meanwhile result in a single rescan
+    void QueueVirtualAmiiboCacheUpdate();
     
 }
\ No newline at end of file
@@ -0,0 +1,164 @@
+#pragma once
+#include <fs/fs_FileSystem.hpp>
+#include <algorithm>
+#include <memory>
+
+namespace sys {
+
+    // Sorts any amount of fixed-size records with a fixed-size buffer
+    // Once the buffer fills up it's sorted and spilled to a run file in the given directory, and runs are merged (a few at a time) when finishing
+    // Inputs that fit in the buffer never touch the SD card
+
+    template<typename T, typename C>
+    class ExternalSorter {
+        private:
+            static constexpr u32 MergeFanIn = 8;
+
+            std::unique_ptr<T[]> records;
+            u32 capacity;
+            u32 record_count;
+            std::string runs_dir;
+            // Pending runs are always [first_run_idx, next_run_idx)
+            u32 first_run_idx;
+            u32 next_run_idx;
+            C compare;
+            bool ok;
+
+            inline void FormatRunPath(u32 idx, char (&out_path)[FS_MAX_PATH]) {
+                snprintf(out_path, sizeof(out_path), "%s/run_%u.bin", this->runs_dir.c_str(), idx);
+            }
+
+            bool WriteRun() {
+                if(this->next_run_idx == 0) {
+                    fs::RecreateDirectory(this->runs_dir);
+                }
+                std::sort(this->records.get(), this->records.get() + this->record_count, this->compare);
+
+                char run_path[FS_MAX_PATH] = {};
+                this->FormatRunPath(this->next_run_idx, run_path);
+                auto f = fs::OpenFile(run_path, "wb");
+                if(f) {
+                    const auto written = fs::WriteFile(this->records.get(), sizeof(T), this->record_count, f) == this->record_count;
+                    fclose(f);
+                    this->record_count = 0;
+                    this->next_run_idx++;
+                    return written;
+                }
+                return false;
+            }
+
+            template<typename F>
+            bool MergeRuns(u32 first_idx, u32 count, F fn) {
+                // Every record in the buffer was already written, so it's reused to hold each run's current record
+                FILE *run_files[MergeFanIn] = {};
+                bool has_record[MergeFanIn] = {};
+                auto heads = this->records.get();
+                char run_path[FS_MAX_PATH] = {};
+
+                auto merged = true;
+                for(u32 i = 0; i < count; i++) {
+                    this->FormatRunPath(first_idx + i, run_path);
+                    run_files[i] = fs::OpenFile(run_path, "rb");
+                    if(run_files[i] == nullptr) {
+                        merged = false;
+                        break;
+                    }
+                    has_record[i] = fs::ReadFile(&heads[i], sizeof(T), 1, run_files[i]) == 1;
+                }
+
+                while(merged) {
+                    i32 min_i = -1;
+                    for(u32 i = 0; i < count; i++) {
+                        if(has_record[i]) {
+                            if((min_i < 0) || this->compare(heads[i], heads[min_i])) {
+                                min_i = i;
+                            }
+                        }
+                    }
+                    if(min_i < 0) {
+                        break;
+                    }
+                    if(!fn(heads[min_i])) {
+                        merged = false;
+                        break;
+                    }
+                    has_record[min_i] = fs::ReadFile(&heads[min_i], sizeof(T), 1, run_files[min_i]) == 1;
+                }
+
+                for(u32 i = 0; i < count; i++) {
+                    if(run_files[i] != nullptr) {
+                        fclose(run_files[i]);
+                    }
+                    this->FormatRunPath(first_idx + i, run_path);
+                    fs::DeleteFile(run_path);
+                }
+                return merged;
+            }
+
+        public:
+            ExternalSorter(const std::string &runs_dir, u32 capacity, C compare = C()) : records(new T[std::max(capacity, MergeFanIn)]), capacity(std::max(capacity, MergeFanIn)), record_count(0), runs_dir(runs_dir), first_run_idx(0), next_run_idx(0), compare(compare), ok(true) {}
+
+            ~ExternalSorter() {
+                if(this->next_run_idx > 0) {
+                    fs::DeleteDirectory(this->runs_dir);
+                }
+            }
+
+            bool Add(const T &record) {
+                if(!this->ok) {
+                    return false;
+                }
+                if(this->record_count == this->capacity) {
+                    this->ok = this->WriteRun();
+                    if(!this->ok) {
+                        return false;
+                    }
+                }
+                this->records[this->record_count] = record;
+                this->record_count++;
+                return true;
+            }
+
+            // Calls the function with every record in order, stopping if it returns false
+            template<typename F>
+            bool Finish(F fn) {
+                if(!this->ok) {
+                    return false;
+                }
+                if(this->next_run_idx == 0) {
+                    std::sort(this->records.get(), this->records.get() + this->record_count, this->compare);
+                    for(u32 i = 0; i < this->record_count; i++) {
+                        if(!fn(this->records[i])) {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+
+                if(this->record_count > 0) {
+                    if(!this->WriteRun()) {
+                        return false;
+                    }
+                }
+                char run_path[FS_MAX_PATH] = {};
+                while((this->next_run_idx - this->first_run_idx) > MergeFanIn) {
+                    this->FormatRunPath(this->next_run_idx, run_path);
+                    auto f = fs::OpenFile(run_path, "wb");
+                    if(f == nullptr) {
+                        return false;
+                    }
+                    const auto merged = this->MergeRuns(this->first_run_idx, MergeFanIn, [&](const T &record) {
+                        return fs::WriteFile(&record, sizeof(T), 1, f) == 1;
+                    });
+                    fclose(f);
+                    if(!merged) {
+                        return false;
+                    }
+                    this->first_run_idx += MergeFanIn;
+                    this->next_run_idx++;
+                }
+                return this->MergeRuns(this->first_run_idx, this->next_run_idx - this->first_run_idx, fn);
+            }
+    };
+
+}
@@ -1,11 +1,22 @@
-
 #pragma once
-#include <emu_Types.hpp>
+#include <sys/sys_Catalog.hpp>
 
 namespace sys {
 
-    void UpdateVirtualAmiiboCache();
-    u32 GetVirtualAmiiboCount();
-    std::string GetVirtualAmiibo(u32 idx);
+    // Outdated virtual amiibo formats found while scanning are converted if specified
+    void UpdateVirtualAmiiboCache(bool convert_legacy = false);
+    // Publishes a catalog with one more virtual amiibo (relative to the amiibo directory), reusing the current catalog's entries and indices instead of rescanning
+    // Fails if there's no catalog yet, the first cache update will find the virtual amiibo anyway
+    bool AddVirtualAmiiboToCache(const char *relative_path);
+    // Pins the current catalog, which stays consistent (and alive) while held, even if a rescan publishes a new one meanwhile
+    // Might be null if no scan succeeded yet
+    std::shared_ptr<Catalog> GetVirtualAmiiboCatalog();
+    // Only virtual amiibos inside the amiibo directory have ids
+    bool GetVirtualAmiiboId(const std::string &path, u64 &out_id);
+
+    // The library is ready once the first cache update finishes (even if it failed), until then there's no catalog to pin
+    bool IsVirtualAmiiboLibraryReady();
+    // The event stays signaled once the library is ready
+    ams::os::SystemEvent &GetVirtualAmiiboLibraryReadyEvent();
 
-}
\ No newline at end of file
+}
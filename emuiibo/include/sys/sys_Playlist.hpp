@@ -0,0 +1,48 @@
+#pragma once
+#include <amiibo/amiibo_Formats.hpp>
+
+namespace sys {
+
+    // Playlists rotate the active virtual amiibo through a list of virtual amiibo ids, wrapping around at the end
+    // The next entry is always loaded (and prewarmed) in the background, so advancing just swaps the active virtual amiibo
+
+    enum PlaylistAdvanceFlag : u32 {
+        // When the active virtual amiibo is connected again after being disconnected
+        PlaylistAdvanceFlag_Reconnect = BIT(0),
+        // When a title stops scanning after reading the active virtual amiibo
+        PlaylistAdvanceFlag_TagSession = BIT(1),
+    };
+
+    struct PlaylistStatus {
+        u32 entry_count;
+        // Index of the active entry
+        u32 position;
+        u32 advance_flags;
+        // Whether the entry after the active one is already loaded
+        bool next_entry_ready;
+        u8 reserved[3];
+    };
+
+    static_assert(sizeof(PlaylistStatus) == 0x10, "Invalid PlaylistStatus struct!");
+
+    static inline constexpr u32 PlaylistMaxEntryCount = 0x400;
+
+    // Activates the first entry right away, if it can't be loaded the current playlist (if any) is kept as is
+    bool SetPlaylist(const u64 *ids, u32 count, u32 advance_flags);
+    void ClearPlaylist();
+    PlaylistStatus GetPlaylistStatus();
+
+    // Returns the next entry's virtual amiibo (null if there's no playlist or it couldn't be loaded), moving the playlist forward
+    // The caller is the one activating it, so that the swap happens along with its status change
+    std::shared_ptr<amiibo::VirtualAmiibo> AdvancePlaylist();
+    bool ShouldAdvancePlaylistOn(PlaylistAdvanceFlag flag);
+
+    // Advances the playlist (if it's set to advance on tag sessions) and activates the next entry
+    void NotifyPlaylistTagSessionFinished();
+
+    // Other slow loads (like applying title profiles) run on the prefetch thread too, before its next prefetch
+    // Only one can be pending, queueing another one replaces it; returns false if the thread couldn't be started
+    using BackgroundLoadFunction = void(*)();
+    bool QueueBackgroundLoad(BackgroundLoadFunction fn);
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <emu_Types.hpp>
+
+namespace sys {
+
+    // Titles can have a virtual amiibo which gets activated (and prewarmed) as soon as they open nfp, before their first scan
+    // Profiles are read from title_profiles.json, which maps program ids (hex strings) to virtual amiibos: either their path relative to the amiibo directory, or their id
+    // Paths are preferred, since they don't need the library (which might not be ready yet) to be resolved
+    // A title can also get a playlist instead, as an array of virtual amiibo ids (or paths), which advances every time the title is done reading
+
+    struct TitleProfile {
+        u64 program_id;
+        u64 virtual_amiibo_id;
+        // Offset in the path pool, or TitleProfileInvalidPathOffset if only the id was specified
+        u32 path_offset;
+        // Non-zero for playlists, whose ids are in the playlist id pool (the fields above are unused then)
+        u32 playlist_entry_count;
+        u32 playlist_offset;
+        u32 reserved;
+    };
+
+    static_assert(sizeof(TitleProfile) == 0x20, "Invalid TitleProfile struct!");
+
+    static inline constexpr u32 TitleProfileInvalidPathOffset = UINT32_MAX;
+
+    // Missing or invalid files just leave no profiles
+    void LoadTitleProfiles();
+    u32 GetTitleProfileCount();
+
+    // Returns whether the title had a profile and its virtual amiibo (or its playlist's first one) is the active one now
+    bool ApplyTitleProfile(u64 program_id);
+
+    // Applies the title's profile (if it has one) on the prefetch thread, so that opening nfp never waits for the SD card
+    void QueueTitleProfile(u64 program_id);
+    // Waits for a queued profile to be applied, up to the timeout: past it the active virtual amiibo is just used as it is
+    void WaitForQueuedTitleProfile(s64 timeout_ns);
+
+}
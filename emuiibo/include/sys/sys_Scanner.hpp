@@ -0,0 +1,12 @@
+#pragma once
+#include <amiibo/amiibo_Formats.hpp>
+#include <functional>
+
+namespace sys {
+
+    // Scans a directory tree for virtual amiibos, listing directories in parallel (with the given thread count, including the calling thread) to hide SD latency
+    // Found virtual amiibos are reported to the callback (one at a time, in no particular order), and the legacy ones found are appended to the vector if specified
+    // Returns how many directories were listed
+    u32 ScanVirtualAmiibos(const std::string &base_path, u32 thread_count, std::function<void(const std::string&)> on_amiibo, std::vector<std::pair<std::string, amiibo::VirtualAmiiboFormat>> *out_legacy_amiibos);
+
+}
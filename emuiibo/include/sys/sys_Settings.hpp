@@ -0,0 +1,71 @@
+#pragma once
+#include <emu_Types.hpp>
+
+namespace sys {
+
+    // Runtime configuration, loaded from settings.json at boot and changeable via nfp:emu
+
+    struct Settings {
+        u32 amiibo_scan_interval_ms;
+        u32 emu_max_sessions;
+        LogLevel log_level;
+        bool dump_miis_on_boot;
+        bool convert_legacy_amiibos_on_boot;
+        bool update_cache_on_emu_session;
+        bool use_amiibo_metadata_cache;
+        u8 amiibo_scan_thread_count;
+        u8 catalog_cache_page_count;
+        bool persist_emulation_state;
+        u32 emulation_state_flush_delay_ms;
+        u8 reserved[0x2C];
+    };
+
+    static_assert(sizeof(Settings) == 0x40, "Invalid Settings struct!");
+
+    static inline constexpr u32 MinAmiiboScanIntervalMs = 10;
+    static inline constexpr u32 MaxAmiiboScanIntervalMs = 5000;
+
+    static inline constexpr u8 MinAmiiboScanThreadCount = 1;
+    static inline constexpr u8 MaxAmiiboScanThreadCount = 4;
+
+    static inline constexpr u8 MinCatalogCachePageCount = 1;
+    static inline constexpr u8 MaxCatalogCachePageCount = 16;
+
+    static inline constexpr u32 MaxEmulationStateFlushDelayMs = 10000;
+
+    // As written in settings.json, indexed by LogLevel
+    static inline constexpr const char *LogLevelNames[] = { "off", "error", "info", "verbose" };
+    static_assert(std::size(LogLevelNames) == static_cast<u32>(LogLevel::Count), "Missing log level names");
+
+    static inline constexpr Settings DefaultSettings = {
+        100, // amiibo_scan_interval_ms
+        40, // emu_max_sessions
+        LogLevel::Info, // log_level
+        true, // dump_miis_on_boot
+        true, // convert_legacy_amiibos_on_boot
+        true, // update_cache_on_emu_session
+        true, // use_amiibo_metadata_cache
+        3, // amiibo_scan_thread_count
+        4, // catalog_cache_page_count
+        true, // persist_emulation_state
+        1000, // emulation_state_flush_delay_ms
+        {},
+    };
+
+    // Reads settings.json (missing/invalid values fall back to the defaults)
+    void LoadSettings();
+
+    Settings GetSettings();
+    // Applies the new settings and saves them to settings.json
+    void SetSettings(Settings settings);
+
+    // Cheap accessors meant for hot paths
+
+    u32 GetAmiiboScanIntervalMs();
+    LogLevel GetLogLevel();
+    bool ShouldUpdateCacheOnEmuSession();
+    bool ShouldUseAmiiboMetadataCache();
+    bool ShouldPersistEmulationState();
+    u32 GetEmulationStateFlushDelayMs();
+
+}
@@ -1,8 +1,9 @@
-
 #pragma once
+#include <amiibo/amiibo_Formats.hpp>
 
 namespace sys {
 
-    void ScanAmiiboDirectory();
+    // Converts an outdated virtual amiibo to the current format, returns whether it's a valid (current format) virtual amiibo now
+    bool ConvertLegacyVirtualAmiibo(const std::string &path, amiibo::VirtualAmiiboFormat format);
 
-}
\ No newline at end of file
+}
@@ -1,4 +1,9 @@
-#include <sys/sys_System.hpp>
+#include <sys/sys_Locator.hpp>
+#include <sys/sys_Settings.hpp>
+#include <sys/sys_Boot.hpp>
+#include <sys/sys_Emulation.hpp>
+#include <sys/sys_Profiles.hpp>
+#include <fs/fs_FileSystem.hpp>
 #include <ipc/mii/mii_Utils.hpp>
 
 #include <ipc/nfp/sys/sys_ISystemManager.hpp>
@@ -11,8 +16,11 @@ extern "C" {
 
     extern u32 __start__;
     u32 __nx_applet_type = AppletType_None;
-    u32 __nx_fs_num_sessions = 1;
-    u32 __nx_fsdev_direntry_cache_size = 1;
+    // One session per scan worker, plus one so that the IPC thread's requests don't queue behind a scan
+    // Sessions are opened at startup before settings are read, hence sized for the maximum worker count rather than the configured one
+    u32 __nx_fs_num_sessions = sys::MaxAmiiboScanThreadCount + 1;
+    // Directory entries are fetched in batches instead of one per request, each open directory's batch (8 * 0x310 bytes) comes from the heap
+    u32 __nx_fsdev_direntry_cache_size = 8;
 
     size_t nx_inner_heap_size = INNER_HEAP_SIZE;
     char   nx_inner_heap[INNER_HEAP_SIZE];
@@ -28,12 +36,18 @@ extern "C" {
     }
 
     void __appInit(void) {
+        sys::BeginBootPhase(sys::BootPhase::SmInitialize);
         EMU_R_ASSERT(smInitialize());
+        sys::BeginBootPhase(sys::BootPhase::FsInitialize);
         EMU_R_ASSERT(fsInitialize());
+        sys::BeginBootPhase(sys::BootPhase::SdCardMount);
         EMU_R_ASSERT(fsdevMountSdmc());
+        sys::BeginBootPhase(sys::BootPhase::TimeInitialize);
         EMU_R_ASSERT(timeInitialize());
         __libnx_init_time();
+        sys::BeginBootPhase(sys::BootPhase::HidInitialize);
         EMU_R_ASSERT(hidInitialize());
+        sys::BeginBootPhase(sys::BootPhase::MiiInitialize);
         EMU_R_ASSERT(ipc::mii::Initialize());
         ams::hos::SetVersionForLibnx();
     }
@@ -74,23 +88,58 @@ namespace {
 
     ams::sf::hipc::ServerManager<MaxServers, ServerOptions, MaxSessions> emuiibo_manager;
 
+    // Runs on the persist thread, at a lower priority than the main thread so that it never delays IPC requests
+    void InitializeLibrary() {
+        const auto settings = sys::GetSettings();
+
+        // This marks its own phases (scan, conversion and catalog build), and the library is ready once it's done
+        sys::UpdateVirtualAmiiboCache(settings.convert_legacy_amiibos_on_boot);
+
+        // The library doesn't depend on these, so they're left for last
+        if(settings.dump_miis_on_boot) {
+            sys::BeginBootPhase(sys::BootPhase::MiiDump);
+            sys::SetBootPhaseEntryCount(ipc::mii::DumpSystemMiis());
+        }
+
+        sys::FinishBoot();
+    }
+
 }
 
 int main() {
+    // The main thread is the one processing IPC requests
+    mem::BindThreadScratchArena(&mem::GetServerScratchArena());
+
+    sys::BeginBootPhase(sys::BootPhase::Settings);
+    fs::EnsureEmuiiboDirectories();
+    sys::LoadSettings();
+    sys::LoadTitleProfiles();
+    const auto settings = sys::GetSettings();
+
     EMU_LOG_FMT("Starting emuiibo...")
 
-    ipc::mii::DumpSystemMiis();
-    sys::ScanAmiiboDirectory();
-    sys::UpdateVirtualAmiiboCache();
- 
+    // Only loads the previously active virtual amiibo, so it's quick enough to be done before the services are up
+    sys::BeginBootPhase(sys::BootPhase::EmulationStateRestore);
+    sys::SetBootPhaseEntryCount(sys::RestoreEmulationState() ? 1 : 0);
+
+    // Services are registered before anything else, so that titles launched early still get emulation (the active virtual amiibo doesn't need the library)
+    sys::BeginBootPhase(sys::BootPhase::ServiceRegistration);
+
     // Register nfp:user
     EMU_R_ASSERT(emuiibo_manager.RegisterMitmServer<ipc::nfp::user::IUserManager>(ipc::nfp::user::ServiceName));
 
-    // Register nfp:sys - why is this still broken?
-    // EMU_R_ASSERT(emuiibo_manager.RegisterMitmServer<ipc::nfp::sys::ISystemManager>(ipc::nfp::sys::ServiceName));
+    // Register nfp:sys
+    EMU_R_ASSERT(emuiibo_manager.RegisterMitmServer<ipc::nfp::sys::ISystemManager>(ipc::nfp::sys::ServiceName));
     
     // Register custom nfp:emu service
-    EMU_R_ASSERT(emuiibo_manager.RegisterServer<ipc::emu::IEmulationService>(ipc::emu::ServiceName, MaxSessions));
+    // The session count can be lowered via settings, but never above what the server manager was built for
+    const auto emu_max_sessions = std::min(static_cast<size_t>(settings.emu_max_sessions), MaxSessions);
+    EMU_R_ASSERT(emuiibo_manager.RegisterServer<ipc::emu::IEmulationService>(ipc::emu::ServiceName, emu_max_sessions));
+
+    sys::NotifyBootServicesRegistered();
+
+    // If the thread can't be created, the library is initialized here instead, as it used to be
+    sys::StartEmulationStatePersistence(&InitializeLibrary);
  
     emuiibo_manager.LoopProcess();
  
@@ -3,41 +3,129 @@
 namespace amiibo {
 
     void AreaManager::CreateImpl(AreaId id, const void *data, size_t size, bool recreate) {
-        auto area_path = this->EncodeAreaFilePath(id);
+        EMU_FS_SUBSYSTEM_SCOPE(Areas);
+        char area_path[FS_MAX_PATH] = {};
+        this->EncodeAreaFilePath(id, area_path);
         if(recreate) {
-            fs::DeleteFile(area_path.c_str());
+            fs::DeleteFile(area_path);
+            if(this->area_sizes_loaded) {
+                this->area_sizes.erase(std::remove_if(this->area_sizes.begin(), this->area_sizes.end(), [&](const std::pair<AreaId, size_t> &area_size) {
+                    return area_size.first == id;
+                }), this->area_sizes.end());
+            }
         }
         this->Write(id, data, size);
     }
 
+    const std::pair<AreaId, size_t> *AreaManager::FindAreaSize(AreaId id) {
+        for(const auto &area_size: this->area_sizes) {
+            if(area_size.first == id) {
+                return &area_size;
+            }
+        }
+        return nullptr;
+    }
+
+    void AreaManager::UpdateAreaSize(AreaId id, size_t size) {
+        for(auto &area_size: this->area_sizes) {
+            if(area_size.first == id) {
+                area_size.second = size;
+                return;
+            }
+        }
+        this->area_sizes.push_back(std::make_pair(id, size));
+    }
+
     bool AreaManager::Exists(AreaId id) {
-        auto area_path = this->EncodeAreaFilePath(id);
+        if(this->area_sizes_loaded) {
+            return this->FindAreaSize(id) != nullptr;
+        }
+        EMU_FS_SUBSYSTEM_SCOPE(Areas);
+        char area_path[FS_MAX_PATH] = {};
+        this->EncodeAreaFilePath(id, area_path);
         return fs::IsFile(area_path);
     }
 
     void AreaManager::Read(AreaId id, void *data, size_t size) {
-        auto area_path = this->EncodeAreaFilePath(id);
+        EMU_FS_SUBSYSTEM_SCOPE(Areas);
+        char area_path[FS_MAX_PATH] = {};
+        this->EncodeAreaFilePath(id, area_path);
         auto area_size = this->GetSize(id);
         auto read_sz = std::min(area_size, size);
-        auto f = fopen(area_path.c_str(), "rb");
+        auto f = fs::OpenFile(area_path, "rb");
         if(f) {
-            fread(data, 1, read_sz, f);
+            fs::ReadFile(data, 1, read_sz, f);
             fclose(f);
         }
     }
 
     void AreaManager::Write(AreaId id, const void *data, size_t size) {
-        auto area_path = this->EncodeAreaFilePath(id);
-        auto f = fopen(area_path.c_str(), "wb");
+        EMU_FS_SUBSYSTEM_SCOPE(Areas);
+        char area_path[FS_MAX_PATH] = {};
+        this->EncodeAreaFilePath(id, area_path);
+        auto f = fs::OpenFile(area_path, "wb");
         if(f) {
-            fwrite(data, 1, size, f);
+            const auto written_size = fs::WriteFile(data, 1, size, f);
             fclose(f);
+            if(this->area_sizes_loaded) {
+                this->UpdateAreaSize(id, written_size);
+            }
         }
     }
 
     size_t AreaManager::GetSize(AreaId id) {
-        auto area_path = this->EncodeAreaFilePath(id);
+        if(this->area_sizes_loaded) {
+            const auto area_size = this->FindAreaSize(id);
+            return (area_size != nullptr) ? area_size->second : 0;
+        }
+        EMU_FS_SUBSYSTEM_SCOPE(Areas);
+        char area_path[FS_MAX_PATH] = {};
+        this->EncodeAreaFilePath(id, area_path);
         return fs::GetFileSize(area_path);
     }
 
-}
\ No newline at end of file
+    bool AreaManager::FindAny(AreaId &out_id) {
+        if(this->area_sizes_loaded) {
+            if(this->area_sizes.empty()) {
+                return false;
+            }
+            out_id = this->area_sizes.front().first;
+            return true;
+        }
+        EMU_FS_SUBSYSTEM_SCOPE(Areas);
+        auto found = false;
+        this->ListAreaFiles([&](AreaId id, const std::string&) {
+            if(!found) {
+                out_id = id;
+                found = true;
+            }
+        });
+        return found;
+    }
+
+    void AreaManager::DeleteAll() {
+        EMU_FS_SUBSYSTEM_SCOPE(Areas);
+        // Deleted after listing, since the directory can't be changed while it's being listed
+        std::vector<std::string> area_paths;
+        this->ListAreaFiles([&](AreaId, const std::string &area_path) {
+            area_paths.push_back(area_path);
+        });
+        for(const auto &area_path: area_paths) {
+            fs::DeleteFile(area_path);
+        }
+        this->area_sizes.clear();
+    }
+
+    void AreaManager::Prewarm() {
+        if(this->area_sizes_loaded) {
+            return;
+        }
+        EMU_FS_SUBSYSTEM_SCOPE(Areas);
+        this->area_sizes.clear();
+        this->ListAreaFiles([&](AreaId id, const std::string &area_path) {
+            this->area_sizes.push_back(std::make_pair(id, fs::GetFileSize(area_path)));
+        });
+        this->area_sizes_loaded = true;
+    }
+
+}
@@ -1,100 +1,467 @@
 #include <amiibo/amiibo_Formats.hpp>
+#include <fs/fs_JSONReader.hpp>
+#include <sys/sys_Settings.hpp>
 #include <ctime>
 #include <algorithm>
 
 namespace amiibo {
 
+    namespace {
+
+        // amiibo.json, decoded straight into the typed fields
+
+        class VirtualAmiiboReader : public fs::JSONReader {
+
+            private:
+                VirtualAmiiboData &data;
+
+                inline bool ReadDateField(Date &date, const std::string &field, u64 value) {
+                    if(field == "y") {
+                        date.year = static_cast<u16>(value);
+                    }
+                    else if(field == "m") {
+                        date.month = static_cast<u8>(value);
+                    }
+                    else if(field == "d") {
+                        date.day = static_cast<u8>(value);
+                    }
+                    return true;
+                }
+
+            protected:
+                bool OnKey(const std::string &path) override {
+                    if(path == "uuid") {
+                        this->data.uuid_info.random_uuid = false;
+                    }
+                    return true;
+                }
+
+                bool OnString(const std::string &path, u32 index, const std::string &value) override {
+                    if(path == "name") {
+                        this->data.name = value;
+                    }
+                    else if(path == "mii_charinfo_file") {
+                        this->data.mii_charinfo_file = value;
+                    }
+                    return true;
+                }
+
+                bool OnNumber(const std::string &path, u32 index, u64 value) override {
+                    if(path == "uuid") {
+                        if(index < sizeof(this->data.uuid_info.uuid)) {
+                            this->data.uuid_info.uuid[index] = static_cast<u8>(value & 0xff);
+                        }
+                    }
+                    else if(path == "write_counter") {
+                        this->data.write_counter = static_cast<u16>(value);
+                    }
+                    else if(path == "version") {
+                        this->data.version = static_cast<u32>(value);
+                    }
+                    else if(path == "id.game_character_id") {
+                        this->data.id.character_id.game_character_id = static_cast<u16>(value);
+                    }
+                    else if(path == "id.character_variant") {
+                        this->data.id.character_id.character_variant = static_cast<u8>(value);
+                    }
+                    else if(path == "id.series") {
+                        this->data.id.series = static_cast<u8>(value);
+                    }
+                    else if(path == "id.model_number") {
+                        this->data.id.model_number = static_cast<u16>(value);
+                    }
+                    else if(path == "id.figure_type") {
+                        this->data.id.figure_type = static_cast<u8>(value);
+                    }
+                    else if(path.compare(0, 17, "first_write_date.") == 0) {
+                        return this->ReadDateField(this->data.first_write_date, path.substr(17), value);
+                    }
+                    else if(path.compare(0, 16, "last_write_date.") == 0) {
+                        return this->ReadDateField(this->data.last_write_date, path.substr(16), value);
+                    }
+                    return true;
+                }
+
+                // Only the fields read above can't be negative, unknown ones (like user additions) are ignored
+                bool OnNegativeNumber(const std::string &path, u32 index, s64 value) override {
+                    const auto is_known = (path == "uuid") || (path == "write_counter") || (path == "version") || (path.compare(0, 3, "id.") == 0) || (path.compare(0, 17, "first_write_date.") == 0) || (path.compare(0, 16, "last_write_date.") == 0);
+                    return !is_known;
+                }
+
+            public:
+                VirtualAmiiboReader(VirtualAmiiboData &data) : data(data) {
+                    this->data.uuid_info.random_uuid = true;
+                }
+
+        };
+
+        inline bool ParseHexByte(const char *str, u8 &out_byte) {
+            char byte_str[3] = { str[0], str[1], '\0' };
+            char *end = nullptr;
+            out_byte = static_cast<u8>(strtoul(byte_str, &end, 16) & 0xff);
+            return end == (byte_str + 2);
+        }
+
+        // V3 byte arrays are hex strings, like "04A1B2..."
+        inline bool ParseHexByteArray(const std::string &str, u8 *out_arr, size_t arr_size) {
+            const auto count = std::min(str.length() / 2, arr_size);
+            for(size_t i = 0; i < count; i++) {
+                if(!ParseHexByte(str.c_str() + (i * 2), out_arr[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // V3 dates are strings, like "2019-12-31"
+        inline bool ParseDate(const std::string &str, Date &out_date) {
+            if(str.length() < 10) {
+                return false;
+            }
+            out_date.year = static_cast<u16>(strtoul(str.substr(0, 4).c_str(), nullptr, 10));
+            out_date.month = static_cast<u8>(strtoul(str.substr(5, 2).c_str(), nullptr, 10));
+            out_date.day = static_cast<u8>(strtoul(str.substr(8, 2).c_str(), nullptr, 10));
+            return true;
+        }
+
+        // tag.json, register.json, common.json and model.json (their keys don't overlap, so the same reader works for all of them)
+
+        class VirtualAmiiboV3Reader : public fs::JSONReader {
+
+            private:
+                VirtualAmiiboData &data;
+
+            protected:
+                bool OnString(const std::string &path, u32 index, const std::string &value) override {
+                    if(path == "uuid") {
+                        return ParseHexByteArray(value, this->data.uuid_info.uuid, sizeof(this->data.uuid_info.uuid));
+                    }
+                    else if(path == "name") {
+                        this->data.name = value;
+                    }
+                    else if(path == "miiCharInfo") {
+                        this->data.mii_charinfo_file = value;
+                    }
+                    else if(path == "firstWriteDate") {
+                        return ParseDate(value, this->data.first_write_date);
+                    }
+                    else if(path == "lastWriteDate") {
+                        return ParseDate(value, this->data.last_write_date);
+                    }
+                    else if(path == "amiiboId") {
+                        u8 array[sizeof(OldAmiiboId)] = {};
+                        if(!ParseHexByteArray(value, array, sizeof(array))) {
+                            return false;
+                        }
+                        auto old_id = *reinterpret_cast<OldAmiiboId*>(array);
+                        // Reverse model number field (BE)
+                        old_id.model_number = __builtin_bswap16(old_id.model_number);
+                        this->data.id = AmiiboId::FromOldAmiiboId(old_id);
+                    }
+                    return true;
+                }
+
+                bool OnNumber(const std::string &path, u32 index, u64 value) override {
+                    if(path == "writeCounter") {
+                        this->data.write_counter = static_cast<u16>(value);
+                    }
+                    else if(path == "version") {
+                        this->data.version = static_cast<u32>(value);
+                    }
+                    return true;
+                }
+
+                bool OnNegativeNumber(const std::string &path, u32 index, s64 value) override {
+                    return (path != "writeCounter") && (path != "version");
+                }
+
+                bool OnBoolean(const std::string &path, u32 index, bool value) override {
+                    if(path == "randomUuid") {
+                        this->data.uuid_info.random_uuid = value;
+                    }
+                    return true;
+                }
+
+            public:
+                VirtualAmiiboV3Reader(VirtualAmiiboData &data) : data(data) {}
+
+        };
+
+        // Files which identify each directory-based format
+
+        enum FormatFile : u32 {
+            FormatFile_AmiiboJson = BIT(0),
+            FormatFile_AmiiboFlag = BIT(1),
+            FormatFile_AmiiboBin = BIT(2),
+            FormatFile_MiiDat = BIT(3),
+            FormatFile_TagJson = BIT(4),
+            FormatFile_CommonJson = BIT(5),
+            FormatFile_ModelJson = BIT(6),
+            FormatFile_RegisterJson = BIT(7),
+        };
+
+        constexpr u32 CurrentFormatFiles = FormatFile_AmiiboJson | FormatFile_AmiiboFlag;
+        constexpr u32 V3FormatFiles = FormatFile_TagJson | FormatFile_CommonJson | FormatFile_ModelJson | FormatFile_RegisterJson;
+        constexpr u32 V2FormatFiles = FormatFile_AmiiboJson | FormatFile_AmiiboBin | FormatFile_MiiDat;
+
+        inline u32 GetFormatFile(const char *name) {
+            static constexpr struct {
+                const char *name;
+                FormatFile file;
+            } FormatFileNames[] = {
+                { "amiibo.json", FormatFile_AmiiboJson },
+                { "amiibo.flag", FormatFile_AmiiboFlag },
+                { "amiibo.bin", FormatFile_AmiiboBin },
+                { "mii.dat", FormatFile_MiiDat },
+                { "tag.json", FormatFile_TagJson },
+                { "common.json", FormatFile_CommonJson },
+                { "model.json", FormatFile_ModelJson },
+                { "register.json", FormatFile_RegisterJson },
+            };
+            for(const auto &format_file: FormatFileNames) {
+                if(strcmp(name, format_file.name) == 0) {
+                    return format_file.file;
+                }
+            }
+            return 0;
+        }
+
+        inline VirtualAmiiboFormat GetDirectoryFormat(u32 found_files) {
+            // Check the current format first, so that a valid virtual amiibo is never treated as an old one
+            if((found_files & CurrentFormatFiles) == CurrentFormatFiles) {
+                return VirtualAmiiboFormat::Current;
+            }
+            if((found_files & V3FormatFiles) == V3FormatFiles) {
+                return VirtualAmiiboFormat::V3;
+            }
+            if((found_files & V2FormatFiles) == V2FormatFiles) {
+                return VirtualAmiiboFormat::V2;
+            }
+            return VirtualAmiiboFormat::Invalid;
+        }
+
+        inline JSON MakeDateJSON(Date date) {
+            auto date_obj = JSON::object();
+            date_obj["y"] = date.year;
+            date_obj["m"] = date.month;
+            date_obj["d"] = date.day;
+            return date_obj;
+        }
+
+        bool LoadVirtualAmiiboCache(const std::string &cache_path, u64 json_size, u64 json_mtime, VirtualAmiiboData &out_data) {
+            EMU_FS_SUBSYSTEM_SCOPE(VirtualAmiibo);
+            VirtualAmiiboCache cache = {};
+            auto f = fs::OpenFile(cache_path.c_str(), "rb");
+            if(!f) {
+                return false;
+            }
+            const auto read_size = fs::ReadFile(&cache, 1, sizeof(cache), f);
+            fclose(f);
+            if(read_size != sizeof(cache)) {
+                return false;
+            }
+            if((cache.magic != VirtualAmiiboCache::Magic) || (cache.format_version != VirtualAmiiboCache::CurrentFormatVersion)) {
+                return false;
+            }
+            if((cache.json_size != json_size) || (cache.json_mtime != json_mtime)) {
+                return false;
+            }
+            // Ensure strings are terminated, the file could be corrupted
+            cache.name[sizeof(cache.name) - 1] = '\0';
+            cache.mii_charinfo_file[sizeof(cache.mii_charinfo_file) - 1] = '\0';
+            out_data.name = cache.name;
+            out_data.mii_charinfo_file = cache.mii_charinfo_file;
+            out_data.uuid_info = cache.uuid_info;
+            out_data.id = cache.id;
+            out_data.first_write_date = cache.first_write_date;
+            out_data.last_write_date = cache.last_write_date;
+            out_data.write_counter = cache.write_counter;
+            out_data.version = cache.version;
+            return true;
+        }
+
+    }
+
+    bool ScanDirectory(const std::string &path, DirectoryScanInfo &out_info) {
+        out_info.format = VirtualAmiiboFormat::Invalid;
+        out_info.child_dirs.clear();
+        out_info.bin_files.clear();
+        u32 found_files = 0;
+        const auto ok = fs::ListDirectory(path, [&](const char *name, bool is_dir) {
+            if(is_dir) {
+                out_info.child_dirs.push_back(name);
+            }
+            else {
+                found_files |= GetFormatFile(name);
+                if(fs::MatchesExtension(name, "bin")) {
+                    out_info.bin_files.push_back(name);
+                }
+            }
+        });
+        if(!ok) {
+            return false;
+        }
+        out_info.format = GetDirectoryFormat(found_files);
+        if(out_info.format != VirtualAmiiboFormat::Invalid) {
+            // Virtual amiibo contents are not scanned any further
+            out_info.child_dirs.clear();
+            out_info.bin_files.clear();
+        }
+        return true;
+    }
+
     void VirtualAmiibo::Save() {
+        EMU_FS_SUBSYSTEM_SCOPE(VirtualAmiibo);
         fs::CreateDirectory(this->path);
         auto amiibo_flag = fs::Concat(this->path, "amiibo.flag");
         fs::CreateEmptyFile(amiibo_flag);
-        auto json_file = fs::Concat(this->path, "amiibo.json");
+        auto json_file = this->GetJSONPath();
+
+        // The DOM is only needed to write the file
+        mem::ScratchScope scratch;
+        auto json = JSON::object();
+        json["name"] = this->data.name;
+        if(!this->data.uuid_info.random_uuid) {
+            auto uuid_array = JSON::array();
+            for(u32 i = 0; i < sizeof(this->data.uuid_info.uuid); i++) {
+                uuid_array.push_back(static_cast<u32>(this->data.uuid_info.uuid[i]));
+            }
+            json["uuid"] = uuid_array;
+        }
+        // Packed fields can't be bound to references, so copy them first
+        auto id_obj = JSON::object();
+        id_obj["game_character_id"] = static_cast<u16>(this->data.id.character_id.game_character_id);
+        id_obj["character_variant"] = this->data.id.character_id.character_variant;
+        id_obj["series"] = this->data.id.series;
+        id_obj["model_number"] = static_cast<u16>(this->data.id.model_number);
+        id_obj["figure_type"] = this->data.id.figure_type;
+        json["id"] = id_obj;
+        json["mii_charinfo_file"] = this->data.mii_charinfo_file;
+        json["first_write_date"] = MakeDateJSON(this->data.first_write_date);
+        json["last_write_date"] = MakeDateJSON(this->data.last_write_date);
+        json["write_counter"] = this->data.write_counter;
+        json["version"] = this->data.version;
+
         fs::DeleteFile(json_file);
-        fs::SaveJSONFile(json_file, this->amiibo_data);
+        fs::SaveJSONFile(json_file, json);
+        // The JSON is newer now, so regenerate the cache too
+        this->SaveCache();
     }
 
-    VirtualAmiibo::VirtualAmiibo(const std::string &amiibo_path) : IVirtualAmiiboBase(amiibo_path), area_manager(amiibo_path) {
-        this->amiibo_data = fs::LoadJSONFile(fs::Concat(amiibo_path, "amiibo.json"));
+    void VirtualAmiibo::SaveCache() {
+        EMU_FS_SUBSYSTEM_SCOPE(VirtualAmiibo);
+        if(!sys::ShouldUseAmiiboMetadataCache()) {
+            return;
+        }
+        auto cache_path = this->GetCachePath();
+        VirtualAmiiboCache cache = {};
+        u64 json_size = 0;
+        u64 json_mtime = 0;
+        // Without a valid modification time (or with values which don't fit) we can't tell when the cache gets outdated, so don't keep any
+        const auto can_cache = fs::GetFileSizeAndTime(this->GetJSONPath(), json_size, json_mtime) && (json_mtime != 0) && (this->data.name.length() < sizeof(cache.name)) && (this->data.mii_charinfo_file.length() < sizeof(cache.mii_charinfo_file));
+        if(!can_cache) {
+            fs::DeleteFile(cache_path);
+            return;
+        }
+        cache.magic = VirtualAmiiboCache::Magic;
+        cache.format_version = VirtualAmiiboCache::CurrentFormatVersion;
+        cache.json_size = json_size;
+        cache.json_mtime = json_mtime;
+        strcpy(cache.name, this->data.name.c_str());
+        strcpy(cache.mii_charinfo_file, this->data.mii_charinfo_file.c_str());
+        cache.uuid_info = this->data.uuid_info;
+        cache.id = this->data.id;
+        cache.first_write_date = this->data.first_write_date;
+        cache.last_write_date = this->data.last_write_date;
+        cache.write_counter = this->data.write_counter;
+        cache.version = this->data.version;
+        fs::Save(cache_path, cache);
+    }
+
+    bool ReadVirtualAmiiboData(const std::string &amiibo_path, VirtualAmiiboData &out_data, bool &out_from_cache) {
+        EMU_FS_SUBSYSTEM_SCOPE(VirtualAmiibo);
+        const auto json_path = fs::Concat(amiibo_path, "amiibo.json");
+        u64 json_size = 0;
+        u64 json_mtime = 0;
+        out_from_cache = sys::ShouldUseAmiiboMetadataCache() && fs::GetFileSizeAndTime(json_path, json_size, json_mtime) && (json_mtime != 0) && LoadVirtualAmiiboCache(fs::Concat(amiibo_path, "amiibo.cache"), json_size, json_mtime, out_data);
+        if(out_from_cache) {
+            return true;
+        }
+        VirtualAmiiboReader reader(out_data);
+        if(!fs::ParseJSONFile(json_path, reader)) {
+            EMU_LOG_ERR_FMT("Unable to parse virtual amiibo at '" << amiibo_path << "'")
+            return false;
+        }
+        return true;
+    }
+
+    VirtualAmiibo::VirtualAmiibo(const std::string &amiibo_path) : IVirtualAmiiboBase(amiibo_path), data(), area_manager(amiibo_path), mii_charinfo(), mii_charinfo_loaded(false) {
+        bool from_cache = false;
+        if(!ReadVirtualAmiiboData(amiibo_path, this->data, from_cache)) {
+            this->valid = false;
+            return;
+        }
+        if(!from_cache) {
+            // The cache was missing or outdated
+            this->SaveCache();
+        }
     }
 
     std::string VirtualAmiibo::GetName() {
-        return this->ReadPlain<std::string>(this->amiibo_data, "name");
+        return this->data.name;
     }
 
     void VirtualAmiibo::SetName(const std::string &name) {
-        this->WritePlain(this->amiibo_data, "name", name);
+        this->data.name = name;
     }
 
     AmiiboUuidInfo VirtualAmiibo::GetUuidInfo() {
-        AmiiboUuidInfo info = {};
-        const bool has_uuid = this->amiibo_data.find("uuid") != this->amiibo_data.end();
-        info.random_uuid = !has_uuid;
-        if(has_uuid) {
-            this->ReadByteArray(info.uuid, "uuid");
-        }
-        return info;
+        return this->data.uuid_info;
     }
 
     void VirtualAmiibo::SetUuidInfo(AmiiboUuidInfo info) {
-        this->amiibo_data.erase("uuid");
-        if(!info.random_uuid) {
-            this->WriteByteArray(info.uuid, 10, "uuid");
-        }
+        this->data.uuid_info = info;
     }
 
     AmiiboId VirtualAmiibo::GetAmiiboId() {
-        AmiiboId id = {};
-        if(this->HasKey(this->amiibo_data, "id")) {
-            auto id_obj = this->amiibo_data["id"];
-            id.character_id.game_character_id = this->ReadPlain<u16>(id_obj, "game_character_id");
-            id.character_id.character_variant = this->ReadPlain<u8>(id_obj, "character_variant");
-            id.series = this->ReadPlain<u8>(id_obj, "series");
-            id.model_number = this->ReadPlain<u16>(id_obj, "model_number");
-            id.figure_type = this->ReadPlain<u8>(id_obj, "figure_type");
-        }
-        return id;
+        return this->data.id;
     }
 
     void VirtualAmiibo::SetAmiiboId(AmiiboId id) {
-        auto id_obj = JSON::object();
-        this->WritePlain(id_obj, "game_character_id", id.character_id.game_character_id);
-        this->WritePlain(id_obj, "character_variant", id.character_id.character_variant);
-        this->WritePlain(id_obj, "series", id.series);
-        this->WritePlain(id_obj, "model_number", id.model_number);
-        this->WritePlain(id_obj, "figure_type", id.figure_type);
-        this->amiibo_data["id"] = id_obj;
+        this->data.id = id;
     }
 
     std::string VirtualAmiibo::GetMiiCharInfoFileName() {
-        return this->ReadPlain<std::string>(this->amiibo_data, "mii_charinfo_file");
+        return this->data.mii_charinfo_file;
     }
 
     void VirtualAmiibo::SetMiiCharInfoFileName(const std::string &char_info_path) {
-        this->WritePlain(this->amiibo_data, "mii_charinfo_file", char_info_path);
+        this->mii_charinfo_loaded = false;
+        this->data.mii_charinfo_file = char_info_path;
     }
 
     Date VirtualAmiibo::GetFirstWriteDate() {
-        return this->ReadDate("first_write_date");
+        return this->data.first_write_date;
     }
 
     void VirtualAmiibo::SetFirstWriteDate(Date date) {
-        this->WriteDate("first_write_date", date);
+        this->data.first_write_date = date;
     }
 
     Date VirtualAmiibo::GetLastWriteDate() {
-        return this->ReadDate("last_write_date");
+        return this->data.last_write_date;
     }
 
     void VirtualAmiibo::SetLastWriteDate(Date date) {
-        this->WriteDate("last_write_date", date);
+        this->data.last_write_date = date;
     }
 
     u16 VirtualAmiibo::GetWriteCounter() {
-        return this->ReadPlain<u16>(this->amiibo_data, "write_counter");
+        return this->data.write_counter;
     }
 
     void VirtualAmiibo::SetWriteCounter(u16 counter) {
-        this->WritePlain(this->amiibo_data, "write_counter", counter);
+        this->data.write_counter = counter;
     }
 
     void VirtualAmiibo::NotifyWritten() {
@@ -117,17 +484,34 @@ namespace amiibo {
     }
 
     u32 VirtualAmiibo::GetVersion() {
-        return this->ReadPlain<u32>(this->amiibo_data, "version");
+        return this->data.version;
     }
 
     void VirtualAmiibo::SetVersion(u32 version) {
-        this->WritePlain(this->amiibo_data, "version", version);
+        this->data.version = version;
     }
 
     void VirtualAmiibo::FullyRemove() {
+        EMU_FS_SUBSYSTEM_SCOPE(VirtualAmiibo);
         fs::DeleteDirectory(this->path);
     }
 
+    CharInfo VirtualAmiibo::GetMiiCharInfo() {
+        EMU_LOCK_SCOPE_WITH(this->mii_charinfo_lock);
+        if(!this->mii_charinfo_loaded) {
+            this->mii_charinfo = this->ReadMiiCharInfo();
+            this->mii_charinfo_loaded = true;
+        }
+        return this->mii_charinfo;
+    }
+
+    void VirtualAmiibo::Prewarm() {
+        // The rest of the data is already loaded along with amiibo.json, and area contents are always read when requested
+        EMU_WRITE_LOCK_SCOPE_WITH(this->rw_lock);
+        this->GetMiiCharInfo();
+        this->area_manager.Prewarm();
+    }
+
     TagInfo VirtualAmiibo::ProduceTagInfo() {
         TagInfo info = {};
         info.info.uuid_length = 10;
@@ -148,7 +532,7 @@ namespace amiibo {
 
     RegisterInfo VirtualAmiibo::ProduceRegisterInfo() {
         RegisterInfo info = {};
-        auto charinfo = this->ReadMiiCharInfo();
+        auto charinfo = this->GetMiiCharInfo();
         memcpy(&info.info.mii, &charinfo, sizeof(charinfo));
 
         auto first_w_date = this->GetFirstWriteDate();
@@ -163,7 +547,7 @@ namespace amiibo {
     ModelInfo VirtualAmiibo::ProduceModelInfo() {
         ModelInfo info = {};
         info.info.id = this->GetAmiiboId();
-        EMU_LOG_FMT("Processed amiibo ID { Game & character ID: " << info.info.id.character_id.game_character_id << ", Character variant: " << (int)info.info.id.character_id.character_variant << ", Figure type: " << (int)info.info.id.figure_type << ", Model number: " << info.info.id.model_number << ", Series: " << (int)info.info.id.series << " }")
+        EMU_LOG_VERBOSE_FMT("Processed amiibo ID { Game & character ID: " << info.info.id.character_id.game_character_id << ", Character variant: " << (int)info.info.id.character_id.character_variant << ", Figure type: " << (int)info.info.id.figure_type << ", Model number: " << info.info.id.model_number << ", Series: " << (int)info.info.id.series << " }")
         return info;
     }
 
@@ -184,59 +568,83 @@ namespace amiibo {
         return info;
     }
 
-    VirtualAmiiboV3::VirtualAmiiboV3(const std::string &amiibo_dir) : IVirtualAmiiboBase(amiibo_dir) {
-        this->tag_data = fs::LoadJSONFile(this->GetJSONFileName("tag"));
-        this->register_data = fs::LoadJSONFile(this->GetJSONFileName("register"));
-        this->common_data = fs::LoadJSONFile(this->GetJSONFileName("common"));
-        this->model_data = fs::LoadJSONFile(this->GetJSONFileName("model"));
+    RegisterInfoPrivate VirtualAmiibo::ProduceRegisterInfoPrivate() {
+        RegisterInfoPrivate info = {};
+        info.info.first_write_date = this->GetFirstWriteDate();
+        auto name = this->GetName();
+        strncpy(info.info.name, name.c_str(), RegisterInfoImpl::AmiiboNameLength);
+        return info;
+    }
+
+    AdminInfo VirtualAmiibo::ProduceAdminInfo() {
+        AdminInfo info = {};
+        // Virtual amiibos always have a name and a Mii
+        info.info.flags = AdminInfoFlag_Registered;
+        // Type 2 tag (packed)
+        info.info.tag_type = 2;
+        info.info.application_area_version = ApplicationAreaVersion::NotSet;
+        AreaId area_id = 0;
+        if(this->area_manager.FindAny(area_id)) {
+            info.info.flags |= AdminInfoFlag_HasApplicationArea;
+            info.info.application_area_id = area_id;
+            info.info.application_area_version = ApplicationAreaVersion::Switch;
+        }
+        return info;
+    }
+
+    void VirtualAmiibo::UpdateRegisterInfo(const RegisterInfoPrivate &info) {
+        char name[RegisterInfoImpl::AmiiboNameLength + 1] = {};
+        strncpy(name, info.info.name, RegisterInfoImpl::AmiiboNameLength);
+        this->SetName(name);
+        this->SetFirstWriteDate(info.info.first_write_date);
+    }
+
+    VirtualAmiiboV3::VirtualAmiiboV3(const std::string &amiibo_dir) : IVirtualAmiiboBase(amiibo_dir), data() {
+        EMU_FS_SUBSYSTEM_SCOPE(VirtualAmiibo);
+        VirtualAmiiboV3Reader reader(this->data);
+        for(const auto &name: { "tag", "register", "common", "model" }) {
+            if(!fs::ParseJSONFile(fs::Concat(amiibo_dir, std::string(name) + ".json"), reader)) {
+                EMU_LOG_ERR_FMT("Unable to parse V3 virtual amiibo's " << name << ".json at '" << amiibo_dir << "'")
+                this->valid = false;
+                break;
+            }
+        }
     }
 
     std::string VirtualAmiiboV3::GetName() {
-        return this->ReadPlain<std::string>(this->register_data, "name");
+        return this->data.name;
     }
 
     AmiiboUuidInfo VirtualAmiiboV3::GetUuidInfo() {
-        AmiiboUuidInfo info = {};
-        info.random_uuid = this->tag_data.value("randomUuid", false);
-        if(!info.random_uuid) {
-            this->ReadStringByteArray(this->tag_data, info.uuid, "uuid");
-        }
-        return info;
+        return this->data.uuid_info;
     }
 
     AmiiboId VirtualAmiiboV3::GetAmiiboId() {
-        u8 array[8] = {0};
-        this->ReadStringByteArray(this->model_data, array, "amiiboId");
-
-        auto old_id = *(OldAmiiboId*)array;
-        // Reverse model number field (BE)
-        old_id.model_number = __builtin_bswap16(old_id.model_number);
-        
-        auto id = AmiiboId::FromOldAmiiboId(old_id);
-        return id;
+        return this->data.id;
     }
 
     std::string VirtualAmiiboV3::GetMiiCharInfoFileName() {
-        return this->ReadPlain<std::string>(this->register_data, "miiCharInfo");
+        return this->data.mii_charinfo_file;
     }
 
     Date VirtualAmiiboV3::GetFirstWriteDate() {
-        return this->ReadStringDate(this->register_data, "firstWriteDate");
+        return this->data.first_write_date;
     }
 
     Date VirtualAmiiboV3::GetLastWriteDate() {
-        return this->ReadStringDate(this->common_data, "lastWriteDate");
+        return this->data.last_write_date;
     }
 
     u16 VirtualAmiiboV3::GetWriteCounter() {
-        return this->ReadPlain<u16>(this->common_data, "writeCounter");
+        return this->data.write_counter;
     }
 
     u32 VirtualAmiiboV3::GetVersion() {
-        return this->ReadPlain<u32>(this->common_data, "version");
+        return this->data.version;
     }
 
     void VirtualAmiiboV3::FullyRemove() {
+        EMU_FS_SUBSYSTEM_SCOPE(VirtualAmiibo);
         fs::DeleteDirectory(this->path);
     }
 
@@ -0,0 +1,189 @@
+#include <emu_Memory.hpp>
+#include <malloc.h>
+#include <new>
+#include <atomic>
+#include <algorithm>
+
+extern "C" {
+
+    extern char *fake_heap_start;
+    extern char *fake_heap_end;
+
+}
+
+namespace mem {
+
+    namespace {
+
+        constexpr size_t ServerScratchArenaSize = 0x2000;
+
+        alignas(16) u8 g_server_scratch_arena_buf[ServerScratchArenaSize];
+        ScratchArena g_server_scratch_arena(g_server_scratch_arena_buf, ServerScratchArenaSize);
+
+        // Enough for a virtual amiibo save's DOM, bigger conversions just fall back to the heap
+        constexpr size_t PersistScratchArenaSize = 0x1000;
+
+        alignas(16) u8 g_persist_scratch_arena_buf[PersistScratchArenaSize];
+        ScratchArena g_persist_scratch_arena(g_persist_scratch_arena_buf, PersistScratchArenaSize);
+
+        // Enough for the active virtual amiibo, every device's one, a prefetched playlist entry and a few more held by clients
+        constexpr u32 ObjectPoolBlockCount = 0x10;
+
+        alignas(16) u8 g_object_pool_buf[ObjectPoolBlockSize * ObjectPoolBlockCount];
+        ObjectPool g_object_pool(g_object_pool_buf, ObjectPoolBlockSize, ObjectPoolBlockCount);
+
+        thread_local ScratchArena *g_thread_arena = nullptr;
+        thread_local ScratchArena *g_current_arena = nullptr;
+        std::atomic<u64> g_in_use_peak_size = 0;
+
+    }
+
+    ScratchArena::ScratchArena(void *buf, size_t size) : buf(reinterpret_cast<u8*>(buf)), size(size), offset(0), peak(0), fallback_count(0) {}
+
+    void *ScratchArena::Allocate(size_t size, size_t align) {
+        const auto start = (this->offset + align - 1) & ~(align - 1);
+        if((start + size) > this->size) {
+            return nullptr;
+        }
+        this->offset = start + size;
+        this->peak = std::max(this->peak, this->offset);
+        return this->buf + start;
+    }
+
+    ScratchArena &GetServerScratchArena() {
+        return g_server_scratch_arena;
+    }
+
+    ScratchArena &GetPersistScratchArena() {
+        return g_persist_scratch_arena;
+    }
+
+    void BindThreadScratchArena(ScratchArena *arena) {
+        g_thread_arena = arena;
+    }
+
+    ScratchScope::ScratchScope() : arena(g_thread_arena), prev_arena(g_current_arena), start_offset(0) {
+        if(this->arena != nullptr) {
+            this->start_offset = this->arena->GetOffset();
+            g_current_arena = this->arena;
+        }
+    }
+
+    ScratchScope::~ScratchScope() {
+        if(this->arena != nullptr) {
+            SampleHeapUsage();
+            this->arena->Rewind(this->start_offset);
+            g_current_arena = this->prev_arena;
+        }
+    }
+
+    void *AllocateScratch(size_t size, size_t align) {
+        if(g_current_arena != nullptr) {
+            auto ptr = g_current_arena->Allocate(size, align);
+            if(ptr != nullptr) {
+                return ptr;
+            }
+            g_current_arena->NotifyFallback();
+        }
+        // Callers never ask for more than the default alignment (see ScratchAllocator)
+        return ::operator new(size);
+    }
+
+    void FreeScratch(void *ptr) {
+        // Arena memory is released all at once when its scope ends
+        if(g_server_scratch_arena.Contains(ptr) || g_persist_scratch_arena.Contains(ptr)) {
+            return;
+        }
+        if((g_current_arena != nullptr) && g_current_arena->Contains(ptr)) {
+            return;
+        }
+        ::operator delete(ptr);
+    }
+
+    ObjectPool::ObjectPool(void *buf, size_t block_size, u32 block_count) : buf(reinterpret_cast<u8*>(buf)), block_size(block_size), block_count(block_count), free_list(nullptr), in_use_count(0), peak_count(0), fallback_count(0) {
+        mutexInit(&this->lock);
+        // Free blocks are linked through their first bytes
+        for(u32 i = block_count; i > 0; i--) {
+            auto block = this->buf + (i - 1) * block_size;
+            *reinterpret_cast<void**>(block) = this->free_list;
+            this->free_list = block;
+        }
+    }
+
+    void *ObjectPool::Allocate(size_t size) {
+        mutexLock(&this->lock);
+        void *block = nullptr;
+        if((size <= this->block_size) && (this->free_list != nullptr)) {
+            block = this->free_list;
+            this->free_list = *reinterpret_cast<void**>(block);
+            this->in_use_count++;
+            this->peak_count = std::max(this->peak_count, this->in_use_count);
+        }
+        else {
+            this->fallback_count++;
+        }
+        mutexUnlock(&this->lock);
+        return block;
+    }
+
+    bool ObjectPool::Free(void *ptr) {
+        auto ptr8 = reinterpret_cast<u8*>(ptr);
+        if((ptr8 < this->buf) || (ptr8 >= (this->buf + this->block_size * this->block_count))) {
+            return false;
+        }
+        mutexLock(&this->lock);
+        *reinterpret_cast<void**>(ptr) = this->free_list;
+        this->free_list = ptr;
+        this->in_use_count--;
+        mutexUnlock(&this->lock);
+        return true;
+    }
+
+    ObjectPool &GetObjectPool() {
+        return g_object_pool;
+    }
+
+    void *AllocatePooled(size_t size) {
+        auto ptr = g_object_pool.Allocate(size);
+        if(ptr != nullptr) {
+            return ptr;
+        }
+        return ::operator new(size);
+    }
+
+    void FreePooled(void *ptr) {
+        if(!g_object_pool.Free(ptr)) {
+            ::operator delete(ptr);
+        }
+    }
+
+    void SampleHeapUsage() {
+        const auto info = mallinfo();
+        const u64 in_use = info.uordblks;
+        auto cur_peak = g_in_use_peak_size.load();
+        while((in_use > cur_peak) && !g_in_use_peak_size.compare_exchange_weak(cur_peak, in_use));
+    }
+
+    HeapStats GetHeapStats() {
+        SampleHeapUsage();
+        const auto info = mallinfo();
+        HeapStats stats = {};
+        stats.heap_size = static_cast<u64>(fake_heap_end - fake_heap_start);
+        stats.arena_size = info.arena;
+        // newlib reports the maximum amount of memory ever obtained from the heap here
+        stats.arena_peak_size = info.usmblks;
+        stats.in_use_size = info.uordblks;
+        stats.in_use_peak_size = g_in_use_peak_size.load();
+        stats.free_size = info.fordblks;
+        stats.free_chunk_count = info.ordblks;
+        stats.scratch_size = g_server_scratch_arena.GetSize();
+        stats.scratch_peak_size = g_server_scratch_arena.GetPeak();
+        stats.scratch_fallback_count = g_server_scratch_arena.GetFallbackCount();
+        stats.pool_block_count = g_object_pool.GetBlockCount();
+        stats.pool_in_use_count = g_object_pool.GetInUseCount();
+        stats.pool_peak_count = g_object_pool.GetPeakCount();
+        stats.pool_fallback_count = g_object_pool.GetFallbackCount();
+        return stats;
+    }
+
+}
@@ -0,0 +1,108 @@
+#include <fs/fs_Stats.hpp>
+#include <algorithm>
+
+namespace fs {
+
+    namespace {
+
+        IoCounters g_subsystem_io_counters[static_cast<u32>(Subsystem::Count)];
+        thread_local Subsystem g_thread_subsystem = Subsystem::Other;
+        thread_local IoCounters *g_thread_command_io_counters = nullptr;
+
+    }
+
+    void IoCounters::Add(IoOperation op, u64 size) {
+        switch(op) {
+            case IoOperation::Stat:
+                this->stat_count.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case IoOperation::Open:
+                this->open_count.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case IoOperation::Read:
+                this->read_count.fetch_add(1, std::memory_order_relaxed);
+                this->read_size.fetch_add(size, std::memory_order_relaxed);
+                break;
+            case IoOperation::Write:
+                this->write_count.fetch_add(1, std::memory_order_relaxed);
+                this->written_size.fetch_add(size, std::memory_order_relaxed);
+                break;
+            case IoOperation::DirectoryOpen:
+                this->dir_open_count.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case IoOperation::DirectoryEntry:
+                this->dir_entry_count.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case IoOperation::Metadata:
+                this->metadata_count.fetch_add(1, std::memory_order_relaxed);
+                break;
+        }
+    }
+
+    void IoCounters::Load(IoStats &out_stats) const {
+        out_stats = {};
+        out_stats.stat_count = this->stat_count.load(std::memory_order_relaxed);
+        out_stats.open_count = this->open_count.load(std::memory_order_relaxed);
+        out_stats.read_count = this->read_count.load(std::memory_order_relaxed);
+        out_stats.write_count = this->write_count.load(std::memory_order_relaxed);
+        out_stats.dir_open_count = this->dir_open_count.load(std::memory_order_relaxed);
+        out_stats.dir_entry_count = this->dir_entry_count.load(std::memory_order_relaxed);
+        out_stats.metadata_count = this->metadata_count.load(std::memory_order_relaxed);
+        out_stats.read_size = this->read_size.load(std::memory_order_relaxed);
+        out_stats.written_size = this->written_size.load(std::memory_order_relaxed);
+    }
+
+    void IoCounters::Reset() {
+        this->stat_count.store(0, std::memory_order_relaxed);
+        this->open_count.store(0, std::memory_order_relaxed);
+        this->read_count.store(0, std::memory_order_relaxed);
+        this->write_count.store(0, std::memory_order_relaxed);
+        this->dir_open_count.store(0, std::memory_order_relaxed);
+        this->dir_entry_count.store(0, std::memory_order_relaxed);
+        this->metadata_count.store(0, std::memory_order_relaxed);
+        this->read_size.store(0, std::memory_order_relaxed);
+        this->written_size.store(0, std::memory_order_relaxed);
+    }
+
+    void RecordIo(IoOperation op, u64 size) {
+        g_subsystem_io_counters[static_cast<u32>(g_thread_subsystem)].Add(op, size);
+        if(g_thread_command_io_counters != nullptr) {
+            g_thread_command_io_counters->Add(op, size);
+        }
+    }
+
+    void RecordLogWrite(size_t size) {
+        SubsystemScope log_scope(Subsystem::Log);
+        RecordIo(IoOperation::Open);
+        RecordIo(IoOperation::Write, size);
+    }
+
+    IoCounters *BindThreadCommandIoCounters(IoCounters *counters) {
+        auto prev_counters = g_thread_command_io_counters;
+        g_thread_command_io_counters = counters;
+        return prev_counters;
+    }
+
+    u32 GetIoStats(IoStats *out_stats, u32 max_count) {
+        const auto count = std::min(max_count, static_cast<u32>(Subsystem::Count));
+        for(u32 i = 0; i < count; i++) {
+            g_subsystem_io_counters[i].Load(out_stats[i]);
+        }
+        return count;
+    }
+
+    void ResetIoStats() {
+        for(auto &counters: g_subsystem_io_counters) {
+            counters.Reset();
+        }
+    }
+
+    SubsystemScope::SubsystemScope(Subsystem subsystem) : prev_subsystem(g_thread_subsystem) {
+        g_thread_subsystem = subsystem;
+    }
+
+    SubsystemScope::~SubsystemScope() {
+        g_thread_subsystem = this->prev_subsystem;
+    }
+
+}
@@ -0,0 +1,119 @@
+#include <ipc/ipc_CommandStats.hpp>
+#include <iterator>
+
+namespace ipc {
+
+    namespace {
+
+        struct CommandStatsSlot {
+            std::atomic<u32> count;
+            std::atomic<u64> total_time_us;
+            std::atomic<u64> max_time_us;
+            std::atomic<u32> buckets[CommandStatsBucketCount];
+            fs::IoCounters io;
+        };
+
+        constexpr u32 InterfaceCommandCounts[] = { CommandStatsNfpCommandCount, CommandStatsEmulationCommandCount };
+        static_assert(std::size(InterfaceCommandCounts) == static_cast<u32>(CommandStatsInterface::Count), "Missing interface command counts");
+
+        // Each interface's slots follow the previous one's
+        constexpr u32 GetInterfaceSlotOffset(u32 iface) {
+            u32 offset = 0;
+            for(u32 i = 0; i < iface; i++) {
+                offset += InterfaceCommandCounts[i];
+            }
+            return offset;
+        }
+
+        CommandStatsSlot g_command_stats[GetInterfaceSlotOffset(static_cast<u32>(CommandStatsInterface::Count))];
+
+        inline CommandStatsSlot *GetSlot(CommandStatsInterface iface, u32 command_id) {
+            if((iface >= CommandStatsInterface::Count) || (command_id >= InterfaceCommandCounts[static_cast<u32>(iface)])) {
+                return nullptr;
+            }
+            return &g_command_stats[GetInterfaceSlotOffset(static_cast<u32>(iface)) + command_id];
+        }
+
+        inline u32 GetBucketIndex(u64 time_us) {
+            if(time_us == 0) {
+                return 0;
+            }
+            const u32 log2_time = 63 - __builtin_clzll(time_us);
+            return std::min(log2_time, CommandStatsBucketCount - 1);
+        }
+
+    }
+
+    void RecordCommand(CommandStatsInterface iface, u32 command_id, u64 elapsed_ticks) {
+        auto slot_ptr = GetSlot(iface, command_id);
+        if(slot_ptr == nullptr) {
+            return;
+        }
+        auto &slot = *slot_ptr;
+        const u64 time_us = armTicksToNs(elapsed_ticks) / 1'000;
+        slot.count.fetch_add(1, std::memory_order_relaxed);
+        slot.total_time_us.fetch_add(time_us, std::memory_order_relaxed);
+        slot.buckets[GetBucketIndex(time_us)].fetch_add(1, std::memory_order_relaxed);
+        auto max_time_us = slot.max_time_us.load(std::memory_order_relaxed);
+        while((time_us > max_time_us) && !slot.max_time_us.compare_exchange_weak(max_time_us, time_us, std::memory_order_relaxed)) {}
+    }
+
+    u32 GetCommandStats(u32 offset, CommandStats *out_stats, u32 max_count) {
+        u32 listed_count = 0;
+        u32 called_count = 0;
+        for(u32 i = 0; i < static_cast<u32>(CommandStatsInterface::Count); i++) {
+            for(u32 j = 0; j < InterfaceCommandCounts[i]; j++) {
+                if(listed_count == max_count) {
+                    return listed_count;
+                }
+                const auto &slot = g_command_stats[GetInterfaceSlotOffset(i) + j];
+                const auto count = slot.count.load(std::memory_order_relaxed);
+                if(count == 0) {
+                    continue;
+                }
+                called_count++;
+                if(called_count <= offset) {
+                    continue;
+                }
+
+                auto &stats = out_stats[listed_count];
+                stats = {};
+                stats.iface = static_cast<CommandStatsInterface>(i);
+                stats.command_id = j;
+                stats.count = count;
+                stats.total_time_us = slot.total_time_us.load(std::memory_order_relaxed);
+                stats.max_time_us = slot.max_time_us.load(std::memory_order_relaxed);
+                for(u32 k = 0; k < CommandStatsBucketCount; k++) {
+                    stats.buckets[k] = slot.buckets[k].load(std::memory_order_relaxed);
+                }
+                slot.io.Load(stats.io);
+                listed_count++;
+            }
+        }
+        return listed_count;
+    }
+
+    void ResetCommandStats() {
+        for(auto &slot: g_command_stats) {
+            slot.count.store(0, std::memory_order_relaxed);
+            slot.total_time_us.store(0, std::memory_order_relaxed);
+            slot.max_time_us.store(0, std::memory_order_relaxed);
+            for(auto &bucket: slot.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            slot.io.Reset();
+        }
+    }
+
+    CommandStatsScope::CommandStatsScope(CommandStatsInterface iface, u32 command_id) : iface(iface), command_id(command_id), start_tick(armGetSystemTick()), prev_io_counters(nullptr) {
+        // Commands can't nest on the same thread, but the previous binding is restored anyway
+        auto slot = GetSlot(iface, command_id);
+        this->prev_io_counters = fs::BindThreadCommandIoCounters((slot != nullptr) ? &slot->io : nullptr);
+    }
+
+    CommandStatsScope::~CommandStatsScope() {
+        fs::BindThreadCommandIoCounters(this->prev_io_counters);
+        RecordCommand(this->iface, this->command_id, armGetSystemTick() - this->start_tick);
+    }
+
+}
@@ -3,9 +3,11 @@
 
 namespace ipc::mii {
 
-    void DumpSystemMiis() {
+    u32 DumpSystemMiis() {
+        EMU_FS_SUBSYSTEM_SCOPE(Mii);
         fs::EnsureEmuiiboDirectories();
         u32 mii_count = 0;
+        u32 dumped_count = 0;
         auto rc = GetCount(&mii_count);
         if(R_SUCCEEDED(rc)) {
             for(u32 i = 0; i < mii_count; i++) {
@@ -22,14 +24,16 @@ namespace ipc::mii {
                     auto charinfo_dir_path = fs::Concat(consts::DumpedMiisDir, charinfo_dir);
                     fs::CreateDirectory(charinfo_dir_path);
                     auto charinfo_file_path = fs::Concat(charinfo_dir_path, "mii-charinfo.bin");
-                    auto f = fopen(charinfo_file_path.c_str(), "wb");
+                    auto f = fs::OpenFile(charinfo_file_path.c_str(), "wb");
                     if(f) {
-                        fwrite(&charinfo, 1, sizeof(charinfo), f);
+                        fs::WriteFile(&charinfo, 1, sizeof(charinfo), f);
                         fclose(f);
+                        dumped_count++;
                     }
                 }
             }
         }
+        return dumped_count;
     }
 
 }
\ No newline at end of file
@@ -1,22 +1,36 @@
 #include <ipc/nfp/nfp_ICommonObjects.hpp>
+#include <sys/sys_Settings.hpp>
+#include <sys/sys_Playlist.hpp>
 
 namespace ipc::nfp {
 
+    // Enough to load and prewarm a virtual amiibo, unless the SD card is really busy
+    static constexpr s64 TitleProfileWaitTimeoutNs = 200'000'000;
+
     static void VirtualAmiiboScanThread(void *iface_data) {
         ICommonInterface *iface_ptr = reinterpret_cast<ICommonInterface*>(iface_data);
         while(true) {
             if(iface_ptr->ShouldExitThread()) {
                 break;
             }
-            auto status = sys::GetActiveVirtualAmiiboStatus();
-            iface_ptr->HandleVirtualAmiiboStatus(status);
-            svcSleepThread(100'000'000ul);
+            // Only devices which are being used need their status
+            for(u32 i = 0; i < sys::DeviceSlotCount; i++) {
+                if(iface_ptr->IsDeviceStateAny(i, NfpDeviceState_SearchingForTag, NfpDeviceState_TagFound, NfpDeviceState_TagMounted)) {
+                    auto status = sys::GetDeviceVirtualAmiiboStatus(sys::GetDeviceSlotNpadId(i));
+                    iface_ptr->HandleVirtualAmiiboStatus(i, status);
+                }
+            }
+            svcSleepThread(sys::GetAmiiboScanIntervalMs() * 1'000'000ul);
         }
     }
 
-    ICommonInterface::ICommonInterface(Service *fwd) : state(NfpState_NonInitialized), device_state(NfpDeviceState_Unavailable), forward_service(fwd), should_exit_thread(false) {
-        this->event_activate.InitializeAsInterProcessEvent();
-        this->event_deactivate.InitializeAsInterProcessEvent();
+    ICommonInterface::ICommonInterface(Service *fwd) : state(NfpState_NonInitialized), forward_service(fwd), should_exit_thread(false) {
+        for(auto &device: this->devices) {
+            device.state = NfpDeviceState_Unavailable;
+            device.last_notified_status = sys::VirtualAmiiboStatus::Invalid;
+            device.events_initialized = false;
+            device.tag_info_read = false;
+        }
         this->event_availability_change.InitializeAsInterProcessEvent();
         EMU_R_ASSERT(this->scan_thread.Initialize(&VirtualAmiiboScanThread, reinterpret_cast<void*>(this), 0x2000, 0x2b));
         EMU_R_ASSERT(this->scan_thread.Start());
@@ -28,26 +42,43 @@ namespace ipc::nfp {
         this->NotifyThreadExitAndWait();
     }
 
-    void ICommonInterface::HandleVirtualAmiiboStatus(sys::VirtualAmiiboStatus status) {
+    void ICommonInterface::FinishTagSession(Device &device) {
+        if(device.tag_info_read) {
+            device.tag_info_read = false;
+            sys::NotifyPlaylistTagSessionFinished();
+        }
+    }
+
+    void ICommonInterface::SetAllDeviceStates(NfpDeviceState state) {
+        EMU_LOCK_SCOPE_WITH(this->emu_scan_lock);
+        for(auto &device: this->devices) {
+            device.state = state;
+        }
+    }
+
+    void ICommonInterface::HandleVirtualAmiiboStatus(u32 slot, sys::VirtualAmiiboStatus status) {
         EMU_LOCK_SCOPE_WITH(this->emu_scan_lock);
-        this->last_notified_status = status;
-        EMU_LOG_FMT("Got status: " << static_cast<u32>(status))
+        auto &device = this->devices[slot];
+        device.last_notified_status = status;
+        EMU_LOG_VERBOSE_FMT("Got status: " << static_cast<u32>(status) << " for device slot " << slot)
         // In this context, Invalid status = the status was consumed, waiting for another change
-        switch(this->last_notified_status) {
+        switch(device.last_notified_status) {
             case sys::VirtualAmiiboStatus::Connected: {
-                switch(this->device_state) {
+                switch(device.state) {
                     case NfpDeviceState_SearchingForTag: {
                         // The client was waiting for an amiibo, tell it that it's connected now
-                        EMU_LOG_FMT("The client was waiting for an amiibo, tell it that it's connected now")
-                        this->device_state = NfpDeviceState_TagFound;
-                        this->event_activate.Signal();
-                        this->last_notified_status = sys::VirtualAmiiboStatus::Invalid;
+                        EMU_LOG_VERBOSE_FMT("The client was waiting for an amiibo, tell it that it's connected now")
+                        device.state = NfpDeviceState_TagFound;
+                        if(device.events_initialized) {
+                            device.event_activate.Signal();
+                        }
+                        device.last_notified_status = sys::VirtualAmiiboStatus::Invalid;
                         break;
                     }
                     case NfpDeviceState_TagFound: {
                         // We already know it's connected
-                        EMU_LOG_FMT("We already know it's connected")
-                        this->last_notified_status = sys::VirtualAmiiboStatus::Invalid;
+                        EMU_LOG_VERBOSE_FMT("We already know it's connected")
+                        device.last_notified_status = sys::VirtualAmiiboStatus::Invalid;
                         break;
                     }
                     default:
@@ -56,20 +87,22 @@ namespace ipc::nfp {
                 break;
             }
             case sys::VirtualAmiiboStatus::Disconnected: {
-                switch(this->device_state) {
+                switch(device.state) {
                     case NfpDeviceState_TagFound:
                     case NfpDeviceState_TagMounted: {
                         // The client thinks that the amiibo is connected, tell it that it was disconnected
-                        EMU_LOG_FMT("The client thinks that the amiibo is connected, tell it that it was disconnected")
-                        this->device_state = NfpDeviceState_SearchingForTag;
-                        this->event_deactivate.Signal();
-                        this->last_notified_status = sys::VirtualAmiiboStatus::Invalid;
+                        EMU_LOG_VERBOSE_FMT("The client thinks that the amiibo is connected, tell it that it was disconnected")
+                        device.state = NfpDeviceState_SearchingForTag;
+                        if(device.events_initialized) {
+                            device.event_deactivate.Signal();
+                        }
+                        device.last_notified_status = sys::VirtualAmiiboStatus::Invalid;
                         break;
                     }
                     case NfpDeviceState_SearchingForTag: {
                         // We already know it's not connected
-                        EMU_LOG_FMT("We already know it's not connected")
-                        this->last_notified_status = sys::VirtualAmiiboStatus::Invalid;
+                        EMU_LOG_VERBOSE_FMT("We already know it's not connected")
+                        device.last_notified_status = sys::VirtualAmiiboStatus::Invalid;
                         break;
                     }
                     default:
@@ -83,150 +116,217 @@ namespace ipc::nfp {
     }
 
     ams::Result ICommonInterface::Initialize(const ams::sf::ClientAppletResourceUserId &client_aruid, const ams::sf::ClientProcessId &client_pid, const ams::sf::InBuffer &mcu_data) {
-        EMU_LOG_FMT("Process ID: 0x" << std::hex << client_pid.GetValue().value << ", ARUID: 0x" << std:: hex << client_aruid.GetValue().value)
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::Initialize);
+        EMU_LOG_VERBOSE_FMT("Process ID: 0x" << std::hex << client_pid.GetValue().value << ", ARUID: 0x" << std:: hex << client_aruid.GetValue().value)
 
         this->state = NfpState_Initialized;
-        this->device_state = NfpDeviceState_Initialized;
+        this->SetAllDeviceStates(NfpDeviceState_Initialized);
+        // Controllers might have changed since the last title used nfp
+        sys::InvalidateConnectedNpadCache();
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::Finalize() {
-        EMU_LOG_FMT("Finalizing...")
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::Finalize);
+        EMU_LOG_VERBOSE_FMT("Finalizing...")
         this->state = NfpState_NonInitialized;
-        this->device_state = NfpDeviceState_Finalized;
+        this->SetAllDeviceStates(NfpDeviceState_Finalized);
+        for(auto &device: this->devices) {
+            this->FinishTagSession(device);
+        }
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::ListDevices(const ams::sf::OutPointerArray<DeviceHandle> &out_devices, ams::sf::Out<s32> out_count) {
-        EMU_LOG_FMT("Device array length: " << out_devices.GetSize())
-        u64 id = 0x20;
-        hidScanInput();
-        if(hidIsControllerConnected(CONTROLLER_PLAYER_1)) {
-            id = (u64)CONTROLLER_PLAYER_1;
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::ListDevices);
+        EMU_LOG_VERBOSE_FMT("Device array length: " << out_devices.GetSize())
+        u32 npad_ids[sys::DeviceSlotCount] = {};
+        const auto count = sys::GetConnectedNpadIds(npad_ids, std::min(static_cast<u32>(out_devices.GetSize()), sys::DeviceSlotCount));
+        for(u32 i = 0; i < count; i++) {
+            DeviceHandle handle = {};
+            handle.npad_id = npad_ids[i];
+            out_devices[i] = handle;
         }
-        DeviceHandle handle = {};
-        handle.npad_id = (u32)id;
-        out_devices[0] = handle;
-        out_count.SetValue(1);
+        out_count.SetValue(static_cast<s32>(count));
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::StartDetection(DeviceHandle handle) {
-        EMU_LOG_FMT("Started detection")
-        this->device_state = NfpDeviceState_SearchingForTag;
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::StartDetection);
+        EMU_LOG_VERBOSE_FMT("Started detection on device 0x" << std::hex << handle.npad_id)
+        auto device = this->GetDevice(handle);
+        R_UNLESS(device != nullptr, result::nfp::ResultDeviceNotFound);
+        device->state = NfpDeviceState_SearchingForTag;
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::StopDetection(DeviceHandle handle) {
-        EMU_LOG_FMT("Stopped detection")
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::StopDetection);
+        EMU_LOG_VERBOSE_FMT("Stopped detection on device 0x" << std::hex << handle.npad_id)
+        auto device = this->GetDevice(handle);
+        R_UNLESS(device != nullptr, result::nfp::ResultDeviceNotFound);
         /*
-        switch(this->device_state) {
+        switch(device->state) {
             case NfpDeviceState_TagFound:
             case NfpDeviceState_TagMounted:
-                this->eventDeactivate.Signal();
+                device->event_deactivate.Signal();
             case NfpDeviceState_SearchingForTag:
             case NfpDeviceState_TagRemoved:
-                this->device_state = NfpDeviceState_Initialized;
+                device->state = NfpDeviceState_Initialized;
                 break;
             default:
                 break;
         }
         */
-        this->device_state = NfpDeviceState_Initialized;
+        device->state = NfpDeviceState_Initialized;
+        this->FinishTagSession(*device);
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::Mount(DeviceHandle handle, u32 type, u32 target) {
-        EMU_LOG_FMT("Mounted")
-        // this->event_activate.Signal();
-        this->device_state = NfpDeviceState_TagMounted;
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::Mount);
+        EMU_LOG_VERBOSE_FMT("Mounted")
+        auto device = this->GetDevice(handle);
+        R_UNLESS(device != nullptr, result::nfp::ResultDeviceNotFound);
+        // device->event_activate.Signal();
+        device->state = NfpDeviceState_TagMounted;
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::Unmount(DeviceHandle handle) {
-        EMU_LOG_FMT("Unmounted")
-        // this->event_deactivate.Signal();
-        // this->device_state = NfpDeviceState_SearchingForTag;
-        this->device_state = NfpDeviceState_TagFound;
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::Unmount);
+        EMU_LOG_VERBOSE_FMT("Unmounted")
+        auto device = this->GetDevice(handle);
+        R_UNLESS(device != nullptr, result::nfp::ResultDeviceNotFound);
+        // device->event_deactivate.Signal();
+        // device->state = NfpDeviceState_SearchingForTag;
+        device->state = NfpDeviceState_TagFound;
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::Flush(DeviceHandle handle) {
-        EMU_LOG_FMT("Flushed")
-        this->device_state = NfpDeviceState_TagFound;
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::Flush);
+        EMU_LOG_VERBOSE_FMT("Flushed")
+        auto device = this->GetDevice(handle);
+        R_UNLESS(device != nullptr, result::nfp::ResultDeviceNotFound);
+        device->state = NfpDeviceState_TagFound;
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::Restore(DeviceHandle handle) {
-        EMU_LOG_FMT("Restored")
-        this->device_state = NfpDeviceState_TagFound;
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::Restore);
+        EMU_LOG_VERBOSE_FMT("Restored")
+        auto device = this->GetDevice(handle);
+        R_UNLESS(device != nullptr, result::nfp::ResultDeviceNotFound);
+        device->state = NfpDeviceState_TagFound;
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::GetTagInfo(ams::sf::Out<TagInfo> out_info, DeviceHandle handle) {
-        auto &amiibo = sys::GetActiveVirtualAmiibo();
-        EMU_LOG_FMT("Tag info - is amiibo valid? " << std::boolalpha << amiibo.IsValid() << ", amiibo name: " << amiibo.GetName())
-        R_UNLESS(amiibo.IsValid(), result::nfp::ResultAreaNeedsToBeCreated);
-        auto info = amiibo.ProduceTagInfo();
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::GetTagInfo);
+        auto device = this->GetDevice(handle);
+        R_UNLESS(device != nullptr, result::nfp::ResultDeviceNotFound);
+        // The first tag read is the one which must see the title's profile virtual amiibo
+        sys::WaitForQueuedTitleProfile(TitleProfileWaitTimeoutNs);
+        auto amiibo = sys::GetDeviceVirtualAmiibo(handle.npad_id);
+        R_UNLESS(amiibo != nullptr, result::nfp::ResultAreaNeedsToBeCreated);
+        // Locked before anything is read from it, logging included
+        EMU_READ_LOCK_SCOPE_WITH(amiibo->GetLock());
+        const auto is_valid = amiibo->IsValid();
+        EMU_LOG_VERBOSE_FMT("Tag info - is amiibo valid? " << std::boolalpha << is_valid)
+        R_UNLESS(is_valid, result::nfp::ResultAreaNeedsToBeCreated);
+        EMU_LOG_VERBOSE_FMT("Tag info - amiibo name: " << amiibo->GetName())
+        auto info = amiibo->ProduceTagInfo();
         out_info.SetValue(info);
+        // Playlists rotate the active virtual amiibo, devices with their own one don't take part
+        device->tag_info_read = amiibo == sys::GetActiveVirtualAmiibo();
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::GetRegisterInfo(ams::sf::Out<RegisterInfo> out_info, DeviceHandle handle) {
-        auto &amiibo = sys::GetActiveVirtualAmiibo();
-        EMU_LOG_FMT("Register info - is amiibo valid? " << std::boolalpha << amiibo.IsValid() << ", amiibo name: " << amiibo.GetName())
-        R_UNLESS(amiibo.IsValid(), result::nfp::ResultAreaNeedsToBeCreated);
-        auto info = amiibo.ProduceRegisterInfo();
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::GetRegisterInfo);
+        auto amiibo = sys::GetDeviceVirtualAmiibo(handle.npad_id);
+        R_UNLESS(amiibo != nullptr, result::nfp::ResultAreaNeedsToBeCreated);
+        EMU_READ_LOCK_SCOPE_WITH(amiibo->GetLock());
+        const auto is_valid = amiibo->IsValid();
+        EMU_LOG_VERBOSE_FMT("Register info - is amiibo valid? " << std::boolalpha << is_valid)
+        R_UNLESS(is_valid, result::nfp::ResultAreaNeedsToBeCreated);
+        EMU_LOG_VERBOSE_FMT("Register info - amiibo name: " << amiibo->GetName())
+        auto info = amiibo->ProduceRegisterInfo();
         out_info.SetValue(info);
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::GetModelInfo(ams::sf::Out<ModelInfo> out_info, DeviceHandle handle) {
-        auto &amiibo = sys::GetActiveVirtualAmiibo();
-        EMU_LOG_FMT("Model info - is amiibo valid? " << std::boolalpha << amiibo.IsValid() << ", amiibo name: " << amiibo.GetName())
-        R_UNLESS(amiibo.IsValid(), result::nfp::ResultAreaNeedsToBeCreated);
-        auto info = amiibo.ProduceModelInfo();
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::GetModelInfo);
+        auto amiibo = sys::GetDeviceVirtualAmiibo(handle.npad_id);
+        R_UNLESS(amiibo != nullptr, result::nfp::ResultAreaNeedsToBeCreated);
+        EMU_READ_LOCK_SCOPE_WITH(amiibo->GetLock());
+        const auto is_valid = amiibo->IsValid();
+        EMU_LOG_VERBOSE_FMT("Model info - is amiibo valid? " << std::boolalpha << is_valid)
+        R_UNLESS(is_valid, result::nfp::ResultAreaNeedsToBeCreated);
+        EMU_LOG_VERBOSE_FMT("Model info - amiibo name: " << amiibo->GetName())
+        auto info = amiibo->ProduceModelInfo();
         out_info.SetValue(info);
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::GetCommonInfo(ams::sf::Out<CommonInfo> out_info, DeviceHandle handle) {
-        auto &amiibo = sys::GetActiveVirtualAmiibo();
-        EMU_LOG_FMT("Common info - is amiibo valid? " << std::boolalpha << amiibo.IsValid() << ", amiibo name: " << amiibo.GetName())
-        R_UNLESS(amiibo.IsValid(), result::nfp::ResultAreaNeedsToBeCreated);
-        auto info = amiibo.ProduceCommonInfo();
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::GetCommonInfo);
+        auto amiibo = sys::GetDeviceVirtualAmiibo(handle.npad_id);
+        R_UNLESS(amiibo != nullptr, result::nfp::ResultAreaNeedsToBeCreated);
+        EMU_READ_LOCK_SCOPE_WITH(amiibo->GetLock());
+        const auto is_valid = amiibo->IsValid();
+        EMU_LOG_VERBOSE_FMT("Common info - is amiibo valid? " << std::boolalpha << is_valid)
+        R_UNLESS(is_valid, result::nfp::ResultAreaNeedsToBeCreated);
+        EMU_LOG_VERBOSE_FMT("Common info - amiibo name: " << amiibo->GetName())
+        auto info = amiibo->ProduceCommonInfo();
         out_info.SetValue(info);
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::AttachActivateEvent(DeviceHandle handle, ams::sf::Out<ams::sf::CopyHandle> event) {
-        event.SetValue(event_activate.GetReadableHandle());
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::AttachActivateEvent);
+        auto device = this->GetDevice(handle);
+        R_UNLESS(device != nullptr, result::nfp::ResultDeviceNotFound);
+        this->InitializeDeviceEvents(*device);
+        event.SetValue(device->event_activate.GetReadableHandle());
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::AttachDeactivateEvent(DeviceHandle handle, ams::sf::Out<ams::sf::CopyHandle> event) {
-        event.SetValue(event_deactivate.GetReadableHandle());
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::AttachDeactivateEvent);
+        auto device = this->GetDevice(handle);
+        R_UNLESS(device != nullptr, result::nfp::ResultDeviceNotFound);
+        this->InitializeDeviceEvents(*device);
+        event.SetValue(device->event_deactivate.GetReadableHandle());
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::GetState(ams::sf::Out<u32> out_state) {
-        EMU_LOG_FMT("State: " << static_cast<u32>(this->state));
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::GetState);
+        EMU_LOG_VERBOSE_FMT("State: " << static_cast<u32>(this->state));
         out_state.SetValue(static_cast<u32>(this->state));
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::GetDeviceState(DeviceHandle handle, ams::sf::Out<u32> out_state) {
-        EMU_LOG_FMT("Device state: " << static_cast<u32>(this->device_state));
-        out_state.SetValue(static_cast<u32>(this->device_state));
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::GetDeviceState);
+        auto device = this->GetDevice(handle);
+        R_UNLESS(device != nullptr, result::nfp::ResultDeviceNotFound);
+        EMU_LOG_VERBOSE_FMT("Device state: " << static_cast<u32>(device->state));
+        out_state.SetValue(static_cast<u32>(device->state));
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::GetNpadId(DeviceHandle handle, ams::sf::Out<u32> out_npad_id) {
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::GetNpadId);
         out_npad_id.SetValue(handle.npad_id);
         return ams::ResultSuccess();
     }
 
     ams::Result ICommonInterface::AttachAvailabilityChangeEvent(ams::sf::Out<ams::sf::CopyHandle> event) {
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommonCommandId::AttachAvailabilityChangeEvent);
         event.SetValue(event_availability_change.GetReadableHandle());
         return ams::ResultSuccess();
     }
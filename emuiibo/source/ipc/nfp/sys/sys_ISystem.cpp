@@ -3,39 +3,80 @@
 namespace ipc::nfp::sys {
 
     ams::Result ISystem::Format(DeviceHandle handle) {
-        EMU_LOG_FMT("System - Format!")
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::Format);
+        auto amiibo = this->GetDeviceVirtualAmiibo(handle);
+        EMU_LOG_VERBOSE_FMT("System - Format, is amiibo valid? " << std::boolalpha << (amiibo != nullptr))
+        R_UNLESS(amiibo != nullptr, result::nfp::ResultDeviceNotFound);
+        // Virtual amiibos can't be unregistered, so formatting only removes the application area
+        EMU_WRITE_LOCK_SCOPE_WITH(amiibo->GetLock());
+        amiibo->GetAreaManager().DeleteAll();
         return ams::ResultSuccess();
     }
 
     ams::Result ISystem::GetAdminInfo(ams::sf::Out<AdminInfo> out_info, DeviceHandle handle) {
-        EMU_LOG_FMT("System - Get AdminInfo!")
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::GetAdminInfo);
+        auto amiibo = this->GetDeviceVirtualAmiibo(handle);
+        EMU_LOG_VERBOSE_FMT("System - Get AdminInfo, is amiibo valid? " << std::boolalpha << (amiibo != nullptr))
+        R_UNLESS(amiibo != nullptr, result::nfp::ResultDeviceNotFound);
+        // Loads the area index, so that it (and not the SD card) answers this and later area checks
+        amiibo->Prewarm();
+        EMU_READ_LOCK_SCOPE_WITH(amiibo->GetLock());
+        out_info.SetValue(amiibo->ProduceAdminInfo());
         return ams::ResultSuccess();
     }
 
-    ams::Result ISystem::GetRegisterInfo2(ams::sf::Out<RegisterInfo> out_info, DeviceHandle handle) {
-        EMU_LOG_FMT("System - GetRegisterInfo2!")
-        return this->GetRegisterInfo(out_info, handle);
+    ams::Result ISystem::GetRegisterInfo2(ams::sf::Out<RegisterInfoPrivate> out_info, DeviceHandle handle) {
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::GetRegisterInfo2);
+        auto amiibo = this->GetDeviceVirtualAmiibo(handle);
+        EMU_LOG_VERBOSE_FMT("System - GetRegisterInfo2, is amiibo valid? " << std::boolalpha << (amiibo != nullptr))
+        R_UNLESS(amiibo != nullptr, result::nfp::ResultAreaNeedsToBeCreated);
+        EMU_READ_LOCK_SCOPE_WITH(amiibo->GetLock());
+        out_info.SetValue(amiibo->ProduceRegisterInfoPrivate());
+        return ams::ResultSuccess();
     }
 
-    ams::Result ISystem::SetRegisterInfo(DeviceHandle handle, const RegisterInfo &info) {
-        EMU_LOG_FMT("System - SetRegisterInfo!")
+    ams::Result ISystem::SetRegisterInfo(DeviceHandle handle, const RegisterInfoPrivate &info) {
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::SetRegisterInfo);
+        auto amiibo = this->GetDeviceVirtualAmiibo(handle);
+        EMU_LOG_VERBOSE_FMT("System - SetRegisterInfo, is amiibo valid? " << std::boolalpha << (amiibo != nullptr))
+        R_UNLESS(amiibo != nullptr, result::nfp::ResultDeviceNotFound);
+        {
+            EMU_WRITE_LOCK_SCOPE_WITH(amiibo->GetLock());
+            amiibo->UpdateRegisterInfo(info);
+        }
+        ::sys::QueueVirtualAmiiboSave(std::move(amiibo));
         return ams::ResultSuccess();
     }
 
     ams::Result ISystem::DeleteRegisterInfo(DeviceHandle handle) {
-        EMU_LOG_FMT("System - DeleteRegisterInfo!")
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::DeleteRegisterInfo);
+        auto amiibo = this->GetDeviceVirtualAmiibo(handle);
+        EMU_LOG_VERBOSE_FMT("System - DeleteRegisterInfo, is amiibo valid? " << std::boolalpha << (amiibo != nullptr))
+        R_UNLESS(amiibo != nullptr, result::nfp::ResultDeviceNotFound);
+        // Virtual amiibos always need a name and a Mii, so they stay registered
         return ams::ResultSuccess();
     }
 
     ams::Result ISystem::DeleteApplicationArea(DeviceHandle handle) {
-        EMU_LOG_FMT("System - Delete area!")
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::DeleteApplicationArea);
+        auto amiibo = this->GetDeviceVirtualAmiibo(handle);
+        EMU_LOG_VERBOSE_FMT("System - Delete area, is amiibo valid? " << std::boolalpha << (amiibo != nullptr))
+        R_UNLESS(amiibo != nullptr, result::nfp::ResultDeviceNotFound);
+        EMU_WRITE_LOCK_SCOPE_WITH(amiibo->GetLock());
+        amiibo->GetAreaManager().DeleteAll();
         return ams::ResultSuccess();
     }
 
     ams::Result ISystem::ExistsApplicationArea(ams::sf::Out<u8> out_exists, DeviceHandle handle) {
-        EMU_LOG_FMT("System - Exists area?")
-        out_exists.SetValue(0);
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::ExistsApplicationArea);
+        auto amiibo = this->GetDeviceVirtualAmiibo(handle);
+        EMU_LOG_VERBOSE_FMT("System - Exists area, is amiibo valid? " << std::boolalpha << (amiibo != nullptr))
+        R_UNLESS(amiibo != nullptr, result::nfp::ResultDeviceNotFound);
+        amiibo->Prewarm();
+        EMU_READ_LOCK_SCOPE_WITH(amiibo->GetLock());
+        amiibo::AreaId area_id = 0;
+        out_exists.SetValue(amiibo->GetAreaManager().FindAny(area_id) ? 1 : 0);
         return ams::ResultSuccess();
     }
 
-}
\ No newline at end of file
+}
@@ -3,14 +3,17 @@
 namespace ipc::nfp::user {
 
     ams::Result IUser::OpenApplicationArea(DeviceHandle handle, amiibo::AreaId id, ams::sf::Out<u32> out_npad_id) {
-        auto &amiibo = sys::GetActiveVirtualAmiibo();
-        EMU_LOG_FMT("Open area - area ID: 0x" << std::hex << id << std::dec << ", is amiibo valid? " << std::boolalpha << amiibo.IsValid())
-        R_UNLESS(amiibo.IsValid(), result::nfp::ResultDeviceNotFound);
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::OpenApplicationArea);
+        auto amiibo = sys::GetDeviceVirtualAmiibo(handle.npad_id);
+        const auto is_valid = (amiibo != nullptr) && amiibo->IsValid();
+        EMU_LOG_VERBOSE_FMT("Open area - area ID: 0x" << std::hex << id << std::dec << ", is amiibo valid? " << std::boolalpha << is_valid)
+        R_UNLESS(is_valid, result::nfp::ResultDeviceNotFound);
+        EMU_READ_LOCK_SCOPE_WITH(amiibo->GetLock());
 
         out_npad_id.SetValue(handle.npad_id);
 
-        auto &area_manager = amiibo.GetAreaManager();
-        EMU_LOG_FMT("Open area - exists area? " << std::boolalpha << area_manager.Exists(id))
+        auto &area_manager = amiibo->GetAreaManager();
+        EMU_LOG_VERBOSE_FMT("Open area - exists area? " << std::boolalpha << area_manager.Exists(id))
         R_UNLESS(area_manager.Exists(id), result::nfp::ResultAreaNeedsToBeCreated);
 
         // This area is opened now
@@ -20,15 +23,18 @@ namespace ipc::nfp::user {
     }
 
     ams::Result IUser::GetApplicationArea(const ams::sf::OutBuffer &data, ams::sf::Out<u32> data_size, DeviceHandle handle) {
-        EMU_LOG_FMT("Get area - current area ID: " << std::hex << this->current_opened_area_id)
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::GetApplicationArea);
+        EMU_LOG_VERBOSE_FMT("Get area - current area ID: " << std::hex << this->current_opened_area_id)
         R_UNLESS(this->area_opened, result::nfp::ResultDeviceNotFound);
         
-        auto &amiibo = sys::GetActiveVirtualAmiibo();
-        EMU_LOG_FMT("Get area - is amiibo valid? " << std::boolalpha << amiibo.IsValid())
-        R_UNLESS(amiibo.IsValid(), result::nfp::ResultDeviceNotFound);
-
-        auto &area_manager = amiibo.GetAreaManager();
-        EMU_LOG_FMT("Get area - exists area? " << std::boolalpha << area_manager.Exists(this->current_opened_area_id))
+        auto amiibo = sys::GetDeviceVirtualAmiibo(handle.npad_id);
+        const auto is_valid = (amiibo != nullptr) && amiibo->IsValid();
+        EMU_LOG_VERBOSE_FMT("Get area - is amiibo valid? " << std::boolalpha << is_valid)
+        R_UNLESS(is_valid, result::nfp::ResultDeviceNotFound);
+        EMU_READ_LOCK_SCOPE_WITH(amiibo->GetLock());
+
+        auto &area_manager = amiibo->GetAreaManager();
+        EMU_LOG_VERBOSE_FMT("Get area - exists area? " << std::boolalpha << area_manager.Exists(this->current_opened_area_id))
         R_UNLESS(area_manager.Exists(this->current_opened_area_id), result::nfp::ResultAreaNeedsToBeCreated);
 
         auto size = area_manager.GetSize(this->current_opened_area_id);
@@ -40,15 +46,18 @@ namespace ipc::nfp::user {
     }
 
     ams::Result IUser::SetApplicationArea(const ams::sf::InBuffer &data, DeviceHandle handle) {
-        EMU_LOG_FMT("Set area - current area ID: " << std::hex << this->current_opened_area_id)
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::SetApplicationArea);
+        EMU_LOG_VERBOSE_FMT("Set area - current area ID: " << std::hex << this->current_opened_area_id)
         R_UNLESS(this->area_opened, result::nfp::ResultDeviceNotFound);
         
-        auto &amiibo = sys::GetActiveVirtualAmiibo();
-        EMU_LOG_FMT("Set area - is amiibo valid? " << std::boolalpha << amiibo.IsValid())
-        R_UNLESS(amiibo.IsValid(), result::nfp::ResultDeviceNotFound);
-
-        auto &area_manager = amiibo.GetAreaManager();
-        EMU_LOG_FMT("Set area - exists area? " << std::boolalpha << area_manager.Exists(this->current_opened_area_id))
+        auto amiibo = sys::GetDeviceVirtualAmiibo(handle.npad_id);
+        const auto is_valid = (amiibo != nullptr) && amiibo->IsValid();
+        EMU_LOG_VERBOSE_FMT("Set area - is amiibo valid? " << std::boolalpha << is_valid)
+        R_UNLESS(is_valid, result::nfp::ResultDeviceNotFound);
+        EMU_WRITE_LOCK_SCOPE_WITH(amiibo->GetLock());
+
+        auto &area_manager = amiibo->GetAreaManager();
+        EMU_LOG_VERBOSE_FMT("Set area - exists area? " << std::boolalpha << area_manager.Exists(this->current_opened_area_id))
         R_UNLESS(area_manager.Exists(this->current_opened_area_id), result::nfp::ResultAreaNeedsToBeCreated);
 
         auto size = area_manager.GetSize(this->current_opened_area_id);
@@ -56,18 +65,21 @@ namespace ipc::nfp::user {
 
         area_manager.Write(this->current_opened_area_id, data.GetPointer(), data.GetSize());
         // Notify that the amiibo was written :P
-        amiibo.NotifyWritten();
+        amiibo->NotifyWritten();
         return ams::ResultSuccess();
     }
 
     ams::Result IUser::CreateApplicationArea(const ams::sf::InBuffer &data, DeviceHandle handle, amiibo::AreaId id) {
-        EMU_LOG_FMT("Create area - current area ID: " << std::hex << id)
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::CreateApplicationArea);
+        EMU_LOG_VERBOSE_FMT("Create area - current area ID: " << std::hex << id)
         
-        auto &amiibo = sys::GetActiveVirtualAmiibo();
-        EMU_LOG_FMT("Create area - is amiibo valid? " << std::boolalpha << amiibo.IsValid())
-        R_UNLESS(amiibo.IsValid(), result::nfp::ResultDeviceNotFound);
+        auto amiibo = sys::GetDeviceVirtualAmiibo(handle.npad_id);
+        const auto is_valid = (amiibo != nullptr) && amiibo->IsValid();
+        EMU_LOG_VERBOSE_FMT("Create area - is amiibo valid? " << std::boolalpha << is_valid)
+        R_UNLESS(is_valid, result::nfp::ResultDeviceNotFound);
+        EMU_WRITE_LOCK_SCOPE_WITH(amiibo->GetLock());
 
-        auto &area_manager = amiibo.GetAreaManager();
+        auto &area_manager = amiibo->GetAreaManager();
         // If it already exists, this should not succeed
         R_UNLESS(!area_manager.Exists(id), result::nfp::ResultAreaAlreadyCreated);
         area_manager.Create(id, data.GetPointer(), data.GetSize());
@@ -75,15 +87,18 @@ namespace ipc::nfp::user {
     }
 
     ams::Result IUser::GetApplicationAreaSize(DeviceHandle handle, ams::sf::Out<u32> size) {
-        EMU_LOG_FMT("Get area - current area ID: " << std::hex << this->current_opened_area_id)
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::GetApplicationAreaSize);
+        EMU_LOG_VERBOSE_FMT("Get area - current area ID: " << std::hex << this->current_opened_area_id)
         R_UNLESS(this->area_opened, result::nfp::ResultDeviceNotFound);
         
-        auto &amiibo = sys::GetActiveVirtualAmiibo();
-        EMU_LOG_FMT("Get area - is amiibo valid? " << std::boolalpha << amiibo.IsValid())
-        R_UNLESS(amiibo.IsValid(), result::nfp::ResultDeviceNotFound);
-
-        auto &area_manager = amiibo.GetAreaManager();
-        EMU_LOG_FMT("Get area - exists area? " << std::boolalpha << area_manager.Exists(this->current_opened_area_id))
+        auto amiibo = sys::GetDeviceVirtualAmiibo(handle.npad_id);
+        const auto is_valid = (amiibo != nullptr) && amiibo->IsValid();
+        EMU_LOG_VERBOSE_FMT("Get area - is amiibo valid? " << std::boolalpha << is_valid)
+        R_UNLESS(is_valid, result::nfp::ResultDeviceNotFound);
+        EMU_READ_LOCK_SCOPE_WITH(amiibo->GetLock());
+
+        auto &area_manager = amiibo->GetAreaManager();
+        EMU_LOG_VERBOSE_FMT("Get area - exists area? " << std::boolalpha << area_manager.Exists(this->current_opened_area_id))
         R_UNLESS(area_manager.Exists(this->current_opened_area_id), result::nfp::ResultAreaNeedsToBeCreated);
 
         auto sz = area_manager.GetSize(this->current_opened_area_id);
@@ -92,13 +107,16 @@ namespace ipc::nfp::user {
     }
 
     ams::Result IUser::RecreateApplicationArea(const ams::sf::InBuffer &data, DeviceHandle handle, amiibo::AreaId id) {
-        EMU_LOG_FMT("Recreate area - current area ID: " << std::hex << id)
+        EMU_IPC_COMMAND_STATS_SCOPE(Nfp, CommandId::RecreateApplicationArea);
+        EMU_LOG_VERBOSE_FMT("Recreate area - current area ID: " << std::hex << id)
         
-        auto &amiibo = sys::GetActiveVirtualAmiibo();
-        EMU_LOG_FMT("Recreate area - is amiibo valid? " << std::boolalpha << amiibo.IsValid())
-        R_UNLESS(amiibo.IsValid(), result::nfp::ResultDeviceNotFound);
+        auto amiibo = sys::GetDeviceVirtualAmiibo(handle.npad_id);
+        const auto is_valid = (amiibo != nullptr) && amiibo->IsValid();
+        EMU_LOG_VERBOSE_FMT("Recreate area - is amiibo valid? " << std::boolalpha << is_valid)
+        R_UNLESS(is_valid, result::nfp::ResultDeviceNotFound);
+        EMU_WRITE_LOCK_SCOPE_WITH(amiibo->GetLock());
 
-        auto &area_manager = amiibo.GetAreaManager();
+        auto &area_manager = amiibo->GetAreaManager();
         area_manager.Recreate(id, data.GetPointer(), data.GetSize());
         return ams::ResultSuccess();
     }
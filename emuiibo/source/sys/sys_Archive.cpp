@@ -0,0 +1,239 @@
+#include <sys/sys_Archive.hpp>
+#include <sys/sys_Emulation.hpp>
+#include <sys/sys_Locator.hpp>
+
+namespace sys {
+
+    namespace {
+
+        constexpr const char AreasPrefix[] = "areas/";
+        constexpr size_t AreasPrefixLength = sizeof(AreasPrefix) - 1;
+
+        struct ArchiveFile {
+            VirtualAmiiboArchiveFileHeader header;
+            std::string path;
+        };
+
+        // Imports share the same staging directory
+        Lock g_import_lock;
+
+        bool AddArchiveFile(std::vector<ArchiveFile> &files, const char *name, const std::string &path) {
+            ArchiveFile file = {};
+            const auto name_len = strlen(name);
+            if(name_len >= sizeof(file.header.name)) {
+                EMU_LOG_ERR_FMT("File name too long for the archive: '" << name << "'")
+                return false;
+            }
+            memcpy(file.header.name, name, name_len);
+            file.header.size = fs::GetFileSize(path);
+            file.path = path;
+            files.push_back(std::move(file));
+            return true;
+        }
+
+        // Expects the virtual amiibo's lock to be held
+        bool ListArchiveFiles(amiibo::VirtualAmiibo &amiibo, std::vector<ArchiveFile> &out_files) {
+            const auto json_path = fs::Concat(amiibo.GetPath(), "amiibo.json");
+            if(!fs::IsFile(json_path)) {
+                return false;
+            }
+            auto ok = AddArchiveFile(out_files, "amiibo.json", json_path) && AddArchiveFile(out_files, "amiibo.flag", fs::Concat(amiibo.GetPath(), "amiibo.flag"));
+            // Missing charinfo is generated on load, so the archive doesn't need it
+            const auto charinfo_path = amiibo.GetMiiCharInfoPath();
+            if(ok && fs::IsFile(charinfo_path)) {
+                ok = AddArchiveFile(out_files, amiibo.GetMiiCharInfoFileName().c_str(), charinfo_path);
+            }
+            if(ok) {
+                amiibo.GetAreaManager().ListAreaFiles([&](amiibo::AreaId id, const std::string &area_path) {
+                    // Named like the area manager expects them, no matter how the file itself is named
+                    char area_name[sizeof(VirtualAmiiboArchiveFileHeader::name)] = {};
+                    snprintf(area_name, sizeof(area_name), "%s0x%08X.bin", AreasPrefix, id);
+                    ok &= AddArchiveFile(out_files, area_name, area_path);
+                });
+            }
+            return ok && (out_files.size() <= VirtualAmiiboArchiveMaxFileCount);
+        }
+
+        bool IsValidArchiveFileName(const VirtualAmiiboArchiveFileHeader &file_header) {
+            const auto name = file_header.name;
+            if(memchr(name, '\0', sizeof(file_header.name)) == nullptr) {
+                return false;
+            }
+            if(strncmp(name, AreasPrefix, AreasPrefixLength) == 0) {
+                const auto area_name = name + AreasPrefixLength;
+                char *area_name_end = nullptr;
+                strtoul(area_name, &area_name_end, 16);
+                return (strncmp(area_name, "0x", 2) == 0) && (area_name_end > (area_name + 2)) && (strcmp(area_name_end, ".bin") == 0);
+            }
+            // Anything else goes right in the virtual amiibo directory, the cache is always regenerated instead
+            return (name[0] != '\0') && (strchr(name, '/') == nullptr) && (strcmp(name, ".") != 0) && (strcmp(name, "..") != 0) && (strcmp(name, "amiibo.cache") != 0);
+        }
+
+        // Stops (and fails) as soon as the archive turns out to be malformed, or the function fails
+        template<typename F>
+        bool ForEachArchiveFile(const u8 *archive, size_t archive_size, F fn) {
+            VirtualAmiiboArchiveHeader header;
+            if(archive_size < sizeof(header)) {
+                return false;
+            }
+            memcpy(&header, archive, sizeof(header));
+            // The buffer might be bigger than the archive itself
+            if((header.magic != VirtualAmiiboArchiveHeader::Magic) || (header.format_version != VirtualAmiiboArchiveHeader::CurrentFormatVersion) || (header.file_count > VirtualAmiiboArchiveMaxFileCount) || (header.size < sizeof(header)) || (header.size > archive_size)) {
+                return false;
+            }
+            u64 offset = sizeof(header);
+            for(u32 i = 0; i < header.file_count; i++) {
+                VirtualAmiiboArchiveFileHeader file_header;
+                if((header.size - offset) < sizeof(file_header)) {
+                    return false;
+                }
+                memcpy(&file_header, archive + offset, sizeof(file_header));
+                offset += sizeof(file_header);
+                if(file_header.size > (header.size - offset)) {
+                    return false;
+                }
+                if(!fn(file_header, archive + offset)) {
+                    return false;
+                }
+                offset += file_header.size;
+            }
+            return offset == header.size;
+        }
+
+        bool CreateParentDirectories(const std::string &path) {
+            for(auto separator = path.find('/', consts::AmiiboDir.length() + 1); separator != std::string::npos; separator = path.find('/', separator + 1)) {
+                fs::CreateDirectory(path.substr(0, separator));
+            }
+            return fs::IsDirectory(path.substr(0, path.find_last_of('/')));
+        }
+
+    }
+
+    bool ExportVirtualAmiibo(const char *amiibo_path, u8 *buf, size_t buf_size, size_t &out_size) {
+        EMU_FS_SUBSYSTEM_SCOPE(VirtualAmiibo);
+        auto amiibo = FindLoadedVirtualAmiibo(amiibo_path);
+        if(amiibo != nullptr) {
+            // Its amiibo.json might be older than its data, if a save is still queued
+            EMU_WRITE_LOCK_SCOPE_WITH(amiibo->GetLock());
+            amiibo->Save();
+        }
+        else {
+            amiibo = LoadVirtualAmiibo(amiibo_path);
+            if(amiibo == nullptr) {
+                return false;
+            }
+        }
+
+        EMU_READ_LOCK_SCOPE_WITH(amiibo->GetLock());
+        std::vector<ArchiveFile> files;
+        if(!ListArchiveFiles(*amiibo, files)) {
+            return false;
+        }
+        VirtualAmiiboArchiveHeader header = {};
+        header.magic = VirtualAmiiboArchiveHeader::Magic;
+        header.format_version = VirtualAmiiboArchiveHeader::CurrentFormatVersion;
+        header.file_count = files.size();
+        header.size = sizeof(header);
+        for(const auto &file: files) {
+            header.size += sizeof(file.header) + file.header.size;
+        }
+        out_size = header.size;
+        if(header.size > buf_size) {
+            return true;
+        }
+
+        // Files are read straight into the buffer
+        memcpy(buf, &header, sizeof(header));
+        u64 offset = sizeof(header);
+        for(const auto &file: files) {
+            memcpy(buf + offset, &file.header, sizeof(file.header));
+            offset += sizeof(file.header);
+            auto f = fs::OpenFile(file.path.c_str(), "rb");
+            if(f == nullptr) {
+                return false;
+            }
+            const auto read = fs::ReadFile(buf + offset, 1, file.header.size, f) == file.header.size;
+            fclose(f);
+            if(!read) {
+                return false;
+            }
+            offset += file.header.size;
+        }
+        EMU_LOG_FMT("Exported '" << amiibo_path << "' with " << files.size() << " files, size: " << out_size)
+        return true;
+    }
+
+    bool IsValidImportPath(const char *relative_path) {
+        const auto path_len = strlen(relative_path);
+        if((path_len == 0) || ((consts::AmiiboDir.length() + 1 + path_len) >= FS_MAX_PATH)) {
+            return false;
+        }
+        size_t component_start = 0;
+        for(size_t i = 0; i <= path_len; i++) {
+            if((i == path_len) || (relative_path[i] == '/')) {
+                const auto component = relative_path + component_start;
+                const auto component_len = i - component_start;
+                if((component_len == 0) || ((component_len == 1) && (component[0] == '.')) || ((component_len == 2) && (strncmp(component, "..", 2) == 0))) {
+                    return false;
+                }
+                component_start = i + 1;
+            }
+        }
+        return true;
+    }
+
+    bool IsValidVirtualAmiiboArchive(const u8 *archive, size_t archive_size) {
+        bool has_json = false;
+        bool has_flag = false;
+        const auto ok = ForEachArchiveFile(archive, archive_size, [&](const VirtualAmiiboArchiveFileHeader &file_header, const u8*) {
+            if(!IsValidArchiveFileName(file_header)) {
+                return false;
+            }
+            has_json |= strcmp(file_header.name, "amiibo.json") == 0;
+            has_flag |= strcmp(file_header.name, "amiibo.flag") == 0;
+            return true;
+        });
+        return ok && has_json && has_flag;
+    }
+
+    bool ImportVirtualAmiibo(const u8 *archive, size_t archive_size, const char *relative_path) {
+        EMU_FS_SUBSYSTEM_SCOPE(VirtualAmiibo);
+        EMU_LOCK_SCOPE_WITH(g_import_lock);
+        const auto amiibo_path = fs::Concat(consts::AmiiboDir, relative_path);
+        if(fs::IsDirectory(amiibo_path) || fs::IsFile(amiibo_path)) {
+            return false;
+        }
+
+        // Staged outside the amiibo directory (but in the same filesystem), so that it's moved instead of copied
+        fs::RecreateDirectory(consts::ImportDir);
+        fs::CreateDirectory(fs::Concat(consts::ImportDir, "areas"));
+        auto ok = ForEachArchiveFile(archive, archive_size, [&](const VirtualAmiiboArchiveFileHeader &file_header, const u8 *data) {
+            auto f = fs::OpenFile(fs::Concat(consts::ImportDir, file_header.name).c_str(), "wb");
+            if(f == nullptr) {
+                return false;
+            }
+            const auto written = fs::WriteFile(data, 1, file_header.size, f) == file_header.size;
+            fclose(f);
+            return written;
+        });
+        if(ok) {
+            // Loading it also generates its amiibo.cache, which stays valid after the move
+            amiibo::VirtualAmiibo amiibo(consts::ImportDir);
+            ok = amiibo.IsValid();
+        }
+        if(ok) {
+            ok = CreateParentDirectories(amiibo_path) && fs::Rename(consts::ImportDir, amiibo_path);
+        }
+        if(!ok) {
+            fs::DeleteDirectory(consts::ImportDir);
+            EMU_LOG_ERR_FMT("Unable to import virtual amiibo to '" << amiibo_path << "'")
+            return false;
+        }
+
+        // Without a catalog yet, the first cache update will find it
+        const auto added = AddVirtualAmiiboToCache(relative_path);
+        EMU_LOG_FMT("Imported virtual amiibo to '" << amiibo_path << "', added to the catalog? " << std::boolalpha << added)
+        return true;
+    }
+
+}
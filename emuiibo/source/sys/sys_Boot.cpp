@@ -0,0 +1,104 @@
+#include <sys/sys_Boot.hpp>
+#include <fs/fs_FileSystem.hpp>
+
+namespace sys {
+
+    namespace {
+
+        Lock g_boot_lock;
+        BootReport g_boot_report = {};
+        u64 g_boot_start_tick = 0;
+        u64 g_phase_start_tick = 0;
+        BootPhase g_current_phase = BootPhase::Count;
+        bool g_boot_finished = false;
+
+        inline u64 TicksToUs(u64 ticks) {
+            return armTicksToNs(ticks) / 1'000;
+        }
+
+        void EndCurrentPhase(u64 tick) {
+            if(g_current_phase == BootPhase::Count) {
+                return;
+            }
+            auto &record = g_boot_report.phases[static_cast<u32>(g_current_phase)];
+            record.start_time_us = TicksToUs(g_phase_start_tick - g_boot_start_tick);
+            record.duration_us = TicksToUs(tick - g_phase_start_tick);
+            record.done = true;
+            g_current_phase = BootPhase::Count;
+        }
+
+    }
+
+    void BeginBootPhase(BootPhase phase) {
+        EMU_LOCK_SCOPE_WITH(g_boot_lock);
+        if(g_boot_finished || (phase >= BootPhase::Count)) {
+            return;
+        }
+        const auto tick = armGetSystemTick();
+        if(g_boot_start_tick == 0) {
+            g_boot_start_tick = tick;
+            g_boot_report.process_start_time_us = TicksToUs(tick);
+            g_boot_report.phase_count = static_cast<u32>(BootPhase::Count);
+        }
+        EndCurrentPhase(tick);
+        g_current_phase = phase;
+        g_phase_start_tick = tick;
+    }
+
+    void SetBootPhaseEntryCount(u32 count) {
+        EMU_LOCK_SCOPE_WITH(g_boot_lock);
+        if(g_boot_finished || (g_current_phase == BootPhase::Count)) {
+            return;
+        }
+        g_boot_report.phases[static_cast<u32>(g_current_phase)].entry_count = count;
+    }
+
+    void NotifyBootServicesRegistered() {
+        EMU_LOCK_SCOPE_WITH(g_boot_lock);
+        if(g_boot_finished) {
+            return;
+        }
+        const auto tick = armGetSystemTick();
+        EndCurrentPhase(tick);
+        g_boot_report.services_registered_time_us = TicksToUs(tick - g_boot_start_tick);
+    }
+
+    void FinishBoot() {
+        BootReport report;
+        {
+            EMU_LOCK_SCOPE_WITH(g_boot_lock);
+            if(g_boot_finished) {
+                return;
+            }
+            const auto tick = armGetSystemTick();
+            EndCurrentPhase(tick);
+            g_boot_report.total_time_us = TicksToUs(tick - g_boot_start_tick);
+            g_boot_finished = true;
+            report = g_boot_report;
+        }
+
+        fs::Save(consts::BootReportPath, report);
+        EMU_LOG_FMT("Boot finished in " << report.total_time_us << "us, services were registered after " << report.services_registered_time_us << "us")
+        for(u32 i = 0; i < report.phase_count; i++) {
+            const auto &record = report.phases[i];
+            if(record.done) {
+                EMU_LOG_FMT("Boot phase " << i << ": started at " << record.start_time_us << "us, took " << record.duration_us << "us, " << record.entry_count << " entries")
+            }
+        }
+
+        // The boot scan is the heaviest heap user (scan worker stacks, sort buffers), so the peak here shows how much headroom is left
+        const auto heap_stats = mem::GetHeapStats();
+        EMU_LOG_FMT("Heap after boot: " << heap_stats.in_use_size << " bytes in use, peak " << heap_stats.in_use_peak_size << " of " << heap_stats.heap_size << " bytes, " << heap_stats.free_size << " bytes free, " << heap_stats.pool_in_use_count << " of " << heap_stats.pool_block_count << " pooled objects in use")
+    }
+
+    bool IsBootFinished() {
+        EMU_LOCK_SCOPE_WITH(g_boot_lock);
+        return g_boot_finished;
+    }
+
+    BootReport GetBootReport() {
+        EMU_LOCK_SCOPE_WITH(g_boot_lock);
+        return g_boot_report;
+    }
+
+}
@@ -0,0 +1,808 @@
+#include <sys/sys_Catalog.hpp>
+#include <sys/sys_ExternalSorter.hpp>
+#include <amiibo/amiibo_Formats.hpp>
+#include <strings.h>
+
+namespace sys {
+
+    namespace {
+
+        constexpr u64 InvalidPageOffset = UINT64_MAX;
+
+        struct CachedPage {
+            u64 catalog_serial;
+            u64 offset;
+            u64 last_use;
+            u8 data[CatalogPageSize];
+        };
+
+        // Everything here is protected by the cache lock
+        Lock g_cache_lock;
+        // Only allocated once entries are actually read, and freed along with the last catalog
+        std::unique_ptr<CachedPage[]> g_cached_pages;
+        u32 g_cached_page_count = 0;
+        u64 g_page_use_counter = 0;
+        u64 g_next_catalog_serial = 0;
+        u32 g_catalog_count = 0;
+
+        inline void FormatUnsortedEntriesPath(char (&out_path)[FS_MAX_PATH]) {
+            snprintf(out_path, sizeof(out_path), "%s/unsorted.bin", consts::CatalogRunsDir.c_str());
+        }
+
+        // Expects the entry to be valid (see Catalog::GetEntryPath)
+        inline const char *GetEntryName(const char *names, const CatalogEntry &entry) {
+            return (entry.name_offset == CatalogInlineEntryName) ? entry.name : (names + entry.name_offset);
+        }
+
+        struct CompareEntries {
+            const char *names;
+
+            inline bool operator()(const CatalogEntry &entry_a, const CatalogEntry &entry_b) const {
+                if(entry_a.dir_idx != entry_b.dir_idx) {
+                    return entry_a.dir_idx < entry_b.dir_idx;
+                }
+                return strcmp(GetEntryName(this->names, entry_a), GetEntryName(this->names, entry_b)) < 0;
+            }
+        };
+
+        struct CompareIdRecords {
+            inline bool operator()(const CatalogIdRecord &record_a, const CatalogIdRecord &record_b) const {
+                return record_a.id < record_b.id;
+            }
+        };
+
+        struct CompareNameRecords {
+            inline bool operator()(const CatalogNameRecord &record_a, const CatalogNameRecord &record_b) const {
+                const auto name_cmp = strcasecmp(record_a.name, record_b.name);
+                if(name_cmp != 0) {
+                    return name_cmp < 0;
+                }
+                return record_a.id < record_b.id;
+            }
+        };
+
+        struct CompareAmiiboIdRecords {
+            inline bool operator()(const CatalogAmiiboIdRecord &record_a, const CatalogAmiiboIdRecord &record_b) const {
+                if(record_a.series != record_b.series) {
+                    return record_a.series < record_b.series;
+                }
+                if(record_a.game_character_id != record_b.game_character_id) {
+                    return record_a.game_character_id < record_b.game_character_id;
+                }
+                if(record_a.figure_type != record_b.figure_type) {
+                    return record_a.figure_type < record_b.figure_type;
+                }
+                return record_a.id < record_b.id;
+            }
+        };
+
+        template<typename T>
+        constexpr u32 GetSortBufferCount() {
+            return CatalogSortBufferSize / sizeof(T);
+        }
+
+        inline bool MatchesQuery(const VirtualAmiiboQuery &query, u8 series, u16 game_character_id, u8 figure_type) {
+            if((query.flags & VirtualAmiiboQueryFlag_Series) && (series != query.series)) {
+                return false;
+            }
+            if((query.flags & VirtualAmiiboQueryFlag_GameCharacterId) && (game_character_id != query.game_character_id)) {
+                return false;
+            }
+            if((query.flags & VirtualAmiiboQueryFlag_FigureType) && (figure_type != query.figure_type)) {
+                return false;
+            }
+            return true;
+        }
+
+        inline u64 HashDirectory(u32 parent_idx, const char *name, size_t name_len) {
+            return HashFnv1a(name, name_len, HashFnv1a(&parent_idx, sizeof(parent_idx)));
+        }
+
+        inline bool AppendPathComponent(const char *name, char *out_path, size_t out_path_size, size_t &path_len) {
+            const auto name_len = strlen(name);
+            const size_t separator_len = (path_len > 0) ? 1 : 0;
+            if((path_len + separator_len + name_len) >= out_path_size) {
+                return false;
+            }
+            if(separator_len > 0) {
+                out_path[path_len] = '/';
+                path_len++;
+            }
+            memcpy(out_path + path_len, name, name_len);
+            path_len += name_len;
+            out_path[path_len] = '\0';
+            return true;
+        }
+
+        // Appends the directory's path, relative to the amiibo directory
+        // Parents are walked twice (first to get the path's length), and it's filled from its end, so there's no depth limit
+        bool AppendDirectoryPath(const CatalogDirectory *dirs, const char *names, u32 dir_idx, char *out_path, size_t out_path_size, size_t &path_len) {
+            if(dir_idx == CatalogRootDirectoryIndex) {
+                return true;
+            }
+            size_t dir_path_len = 0;
+            for(auto idx = dir_idx; idx != CatalogRootDirectoryIndex; idx = dirs[idx].parent_idx) {
+                dir_path_len += strlen(names + dirs[idx].name_offset) + 1;
+            }
+            // Every component comes after a separator, except the first one when the path is empty
+            if(path_len == 0) {
+                dir_path_len--;
+            }
+            const auto end = path_len + dir_path_len;
+            if(end >= out_path_size) {
+                return false;
+            }
+            out_path[end] = '\0';
+            auto pos = end;
+            for(auto idx = dir_idx; idx != CatalogRootDirectoryIndex; idx = dirs[idx].parent_idx) {
+                const auto name = names + dirs[idx].name_offset;
+                const auto name_len = strlen(name);
+                pos -= name_len;
+                memcpy(out_path + pos, name, name_len);
+                if(pos > path_len) {
+                    pos--;
+                    out_path[pos] = '/';
+                }
+            }
+            path_len = end;
+            return true;
+        }
+
+        inline bool FormatEntryPath(const CatalogDirectory *dirs, const char *names, const CatalogEntry &entry, char *out_path, size_t out_path_size) {
+            size_t path_len = 0;
+            return AppendPathComponent(consts::AmiiboDir.c_str(), out_path, out_path_size, path_len) && AppendDirectoryPath(dirs, names, entry.dir_idx, out_path, out_path_size, path_len) && AppendPathComponent(GetEntryName(names, entry), out_path, out_path_size, path_len);
+        }
+
+    }
+
+    CatalogBuilder::CatalogBuilder() : pending_entries(new CatalogEntry[CatalogPendingEntryCount]), pending_entry_count(0), unsorted_entries_file(nullptr), last_dir_idx(CatalogInvalidDirectoryIndex), ok(true) {
+        // The amiibo directory itself
+        this->dirs.push_back({ CatalogRootFolderId, CatalogInvalidDirectoryIndex, 0, 0, 0, 0, 0 });
+        this->dir_names.push_back('\0');
+        fs::CreateDirectory(consts::CatalogRunsDir);
+    }
+
+    CatalogBuilder::~CatalogBuilder() {
+        if(this->unsorted_entries_file != nullptr) {
+            fclose(this->unsorted_entries_file);
+        }
+        fs::DeleteDirectory(consts::CatalogRunsDir);
+    }
+
+    u32 CatalogBuilder::InternDirectory(u32 parent_idx, const char *name, size_t name_len) {
+        const auto hash = HashDirectory(parent_idx, name, name_len);
+        auto it = std::lower_bound(this->dir_lookup.begin(), this->dir_lookup.end(), std::make_pair(hash, 0u));
+        for(; (it != this->dir_lookup.end()) && (it->first == hash); it++) {
+            const auto &dir = this->dirs[it->second];
+            const auto dir_name = &this->dir_names[dir.name_offset];
+            if((dir.parent_idx == parent_idx) && (strncmp(dir_name, name, name_len) == 0) && (dir_name[name_len] == '\0')) {
+                return it->second;
+            }
+        }
+
+        const u32 dir_idx = this->dirs.size();
+        const u32 name_offset = this->dir_names.size();
+        this->dir_names.insert(this->dir_names.end(), name, name + name_len);
+        this->dir_names.push_back('\0');
+        this->dirs.push_back({ 0, parent_idx, name_offset, 0, 0, 0, 0 });
+        this->dir_lookup.insert(it, std::make_pair(hash, dir_idx));
+        return dir_idx;
+    }
+
+    u32 CatalogBuilder::InternDirectoryPath(const char *dir_path, size_t dir_path_len) {
+        // Consecutive virtual amiibos usually come from the same directory
+        if((this->last_dir_idx != CatalogInvalidDirectoryIndex) && (this->last_dir_path.length() == dir_path_len) && (memcmp(this->last_dir_path.c_str(), dir_path, dir_path_len) == 0)) {
+            return this->last_dir_idx;
+        }
+
+        auto dir_idx = CatalogRootDirectoryIndex;
+        size_t component_start = 0;
+        for(size_t i = 0; i <= dir_path_len; i++) {
+            if((i == dir_path_len) || (dir_path[i] == '/')) {
+                if(i > component_start) {
+                    dir_idx = this->InternDirectory(dir_idx, dir_path + component_start, i - component_start);
+                }
+                component_start = i + 1;
+            }
+        }
+        this->last_dir_path.assign(dir_path, dir_path_len);
+        this->last_dir_idx = dir_idx;
+        return dir_idx;
+    }
+
+    void CatalogBuilder::SortDirectories(std::vector<u32> &out_remap) {
+        // Group every directory (but the root) with its siblings, sorted by name
+        std::vector<u32> siblings;
+        siblings.reserve(this->dirs.size() - 1);
+        for(u32 i = 0; i < this->dirs.size(); i++) {
+            if(i != CatalogRootDirectoryIndex) {
+                siblings.push_back(i);
+            }
+        }
+        std::sort(siblings.begin(), siblings.end(), [&](u32 dir_idx_a, u32 dir_idx_b) {
+            const auto &dir_a = this->dirs[dir_idx_a];
+            const auto &dir_b = this->dirs[dir_idx_b];
+            if(dir_a.parent_idx != dir_b.parent_idx) {
+                return dir_a.parent_idx < dir_b.parent_idx;
+            }
+            return strcmp(&this->dir_names[dir_a.name_offset], &this->dir_names[dir_b.name_offset]) < 0;
+        });
+        for(u32 i = 0; i < siblings.size(); i++) {
+            auto &parent = this->dirs[this->dirs[siblings[i]].parent_idx];
+            if(parent.child_count == 0) {
+                parent.first_child_idx = i;
+            }
+            parent.child_count++;
+        }
+
+        // Breadth-first, so that each directory's children end up next to each other
+        std::vector<u32> order;
+        order.reserve(this->dirs.size());
+        order.push_back(CatalogRootDirectoryIndex);
+        std::vector<CatalogDirectory> sorted_dirs(this->dirs.size());
+        for(u32 i = 0; i < order.size(); i++) {
+            auto dir = this->dirs[order[i]];
+            const auto first_sibling_idx = dir.first_child_idx;
+            dir.first_child_idx = order.size();
+            for(u32 j = 0; j < dir.child_count; j++) {
+                order.push_back(siblings[first_sibling_idx + j]);
+            }
+            sorted_dirs[i] = dir;
+        }
+
+        out_remap.resize(this->dirs.size());
+        for(u32 i = 0; i < order.size(); i++) {
+            out_remap[order[i]] = i;
+        }
+        for(u32 i = 0; i < sorted_dirs.size(); i++) {
+            auto &dir = sorted_dirs[i];
+            if(dir.parent_idx != CatalogInvalidDirectoryIndex) {
+                dir.parent_idx = out_remap[dir.parent_idx];
+                // Parents come first, so their ids are already there
+                const auto name = &this->dir_names[dir.name_offset];
+                const auto &parent = sorted_dirs[dir.parent_idx];
+                const auto base_hash = (dir.parent_idx == CatalogRootDirectoryIndex) ? FnvOffsetBasis : HashFnv1a("/", 1, parent.id);
+                dir.id = HashFnv1a(name, strlen(name), base_hash);
+            }
+        }
+        this->dirs = std::move(sorted_dirs);
+
+        // Indices changed, and no more directories will be added anyway
+        this->dir_lookup.clear();
+        this->dir_lookup.shrink_to_fit();
+        this->last_dir_idx = CatalogInvalidDirectoryIndex;
+    }
+
+    void CatalogBuilder::TrackEntry(const CatalogEntry &entry, u32 entry_idx) {
+        auto &dir = this->dirs[entry.dir_idx];
+        if(dir.entry_count == 0) {
+            dir.first_entry_idx = entry_idx;
+        }
+        dir.entry_count++;
+    }
+
+    bool CatalogBuilder::SpillEntries() {
+        if(this->unsorted_entries_file == nullptr) {
+            char entries_path[FS_MAX_PATH] = {};
+            FormatUnsortedEntriesPath(entries_path);
+            this->unsorted_entries_file = fs::OpenFile(entries_path, "w+b");
+            if(this->unsorted_entries_file == nullptr) {
+                return false;
+            }
+        }
+        const auto written = fs::WriteFile(this->pending_entries.get(), sizeof(CatalogEntry), this->pending_entry_count, this->unsorted_entries_file) == this->pending_entry_count;
+        this->pending_entry_count = 0;
+        return written;
+    }
+
+    bool CatalogBuilder::Add(const char *path) {
+        if(!this->ok) {
+            return false;
+        }
+        const auto last_separator = strrchr(path, '/');
+        const auto name = (last_separator != nullptr) ? (last_separator + 1) : path;
+        const auto name_len = strlen(name);
+        const auto dir_idx = this->InternDirectoryPath(path, (last_separator != nullptr) ? (last_separator - path) : 0);
+
+        if(this->pending_entry_count == CatalogPendingEntryCount) {
+            this->ok = this->SpillEntries();
+            if(!this->ok) {
+                EMU_LOG_ERR_FMT("Unable to write catalog entries...")
+                return false;
+            }
+        }
+        auto &entry = this->pending_entries[this->pending_entry_count];
+        entry.id = ComputeVirtualAmiiboId(path);
+        entry.dir_idx = dir_idx;
+        entry.name_offset = CatalogInlineEntryName;
+        memset(entry.name, 0, sizeof(entry.name));
+        memcpy(entry.name, name, std::min(name_len, sizeof(entry.name) - 1));
+        if(name_len >= sizeof(entry.name)) {
+            // Pool offsets don't change when directories are sorted, unlike their indices
+            entry.name_offset = this->dir_names.size();
+            this->dir_names.insert(this->dir_names.end(), name, name + name_len);
+            this->dir_names.push_back('\0');
+        }
+        this->pending_entry_count++;
+        return true;
+    }
+
+    bool CatalogBuilder::Finalize(const std::string &path, Catalog *base) {
+        if(!this->ok) {
+            return false;
+        }
+
+        // Entries are sorted by directory index, so directories need their final indices first
+        std::vector<u32> remap;
+        this->SortDirectories(remap);
+
+        ExternalSorter<CatalogEntry, CompareEntries> entry_sorter(consts::CatalogRunsDir + "/entries", GetSortBufferCount<CatalogEntry>(), CompareEntries{ this->dir_names.data() });
+        auto sort_entry = [&](CatalogEntry &entry) {
+            entry.dir_idx = remap[entry.dir_idx];
+            return entry_sorter.Add(entry);
+        };
+        auto sorted = true;
+        if(this->unsorted_entries_file != nullptr) {
+            sorted = (this->pending_entry_count == 0) || this->SpillEntries();
+            this->pending_entries.reset();
+            fseek(this->unsorted_entries_file, 0, SEEK_SET);
+            CatalogEntry entry;
+            while(sorted && (fs::ReadFile(&entry, sizeof(entry), 1, this->unsorted_entries_file) == 1)) {
+                sorted = sort_entry(entry);
+            }
+            fclose(this->unsorted_entries_file);
+            this->unsorted_entries_file = nullptr;
+        }
+        else {
+            for(u32 i = 0; sorted && (i < this->pending_entry_count); i++) {
+                sorted = sort_entry(this->pending_entries[i]);
+            }
+            this->pending_entries.reset();
+        }
+        if(!sorted) {
+            return false;
+        }
+
+        auto f = fs::OpenFile(path.c_str(), "wb");
+        if(f == nullptr) {
+            return false;
+        }
+        CatalogHeader header = {};
+        header.magic = CatalogHeader::Magic;
+        header.format_version = CatalogHeader::CurrentFormatVersion;
+        auto written = fs::WriteFile(&header, sizeof(header), 1, f) == 1;
+        if(written) {
+            // Indices can only be sorted once entries have their final positions
+            ExternalSorter<CatalogIdRecord, CompareIdRecords> id_sorter(consts::CatalogRunsDir + "/ids", GetSortBufferCount<CatalogIdRecord>());
+            ExternalSorter<CatalogNameRecord, CompareNameRecords> name_sorter(consts::CatalogRunsDir + "/names", GetSortBufferCount<CatalogNameRecord>());
+            ExternalSorter<CatalogAmiiboIdRecord, CompareAmiiboIdRecords> amiibo_id_sorter(consts::CatalogRunsDir + "/amiibo_ids", GetSortBufferCount<CatalogAmiiboIdRecord>());
+
+            // Name and amiibo id come from the virtual amiibo's metadata (usually from its amiibo.cache), which is only read: loading the whole virtual amiibo could write to its directory
+            auto index_entry = [&](const CatalogEntry &entry) {
+                u32 base_idx = 0;
+                if((base != nullptr) && base->FindEntry(entry.id, base_idx)) {
+                    return true;
+                }
+                char amiibo_path[FS_MAX_PATH] = {};
+                if(!FormatEntryPath(this->dirs.data(), this->dir_names.data(), entry, amiibo_path, sizeof(amiibo_path))) {
+                    return true;
+                }
+                amiibo::VirtualAmiiboData amiibo_data = {};
+                bool from_cache = false;
+                if(!amiibo::ReadVirtualAmiiboData(amiibo_path, amiibo_data, from_cache)) {
+                    return true;
+                }
+                const auto amiibo_id = amiibo_data.id;
+                CatalogNameRecord name_record = {};
+                strncpy(name_record.name, amiibo_data.name.c_str(), sizeof(name_record.name) - 1);
+                name_record.amiibo_id = amiibo_id;
+                name_record.id = entry.id;
+                const CatalogAmiiboIdRecord amiibo_id_record = { amiibo_id.series, amiibo_id.figure_type, amiibo_id.character_id.game_character_id, 0, entry.id };
+                header.indexed_count++;
+                return name_sorter.Add(name_record) && amiibo_id_sorter.Add(amiibo_id_record);
+            };
+
+            // Index records only hold ids, so the base catalog's ones are still valid here
+            if(base != nullptr) {
+                written = base->ListIndexRecords([&](const CatalogNameRecord &name_record) {
+                    header.indexed_count++;
+                    return name_sorter.Add(name_record);
+                }, [&](const CatalogAmiiboIdRecord &amiibo_id_record) {
+                    return amiibo_id_sorter.Add(amiibo_id_record);
+                });
+            }
+            if(written) {
+                written = entry_sorter.Finish([&](const CatalogEntry &entry) {
+                    this->TrackEntry(entry, header.entry_count);
+                    const CatalogIdRecord id_record = { entry.id, header.entry_count, 0 };
+                    header.entry_count++;
+                    return (fs::WriteFile(&entry, sizeof(entry), 1, f) == 1) && id_sorter.Add(id_record) && index_entry(entry);
+                });
+            }
+            if(written) {
+                written = id_sorter.Finish([&](const CatalogIdRecord &id_record) {
+                    return fs::WriteFile(&id_record, sizeof(id_record), 1, f) == 1;
+                });
+            }
+            if(written) {
+                written = name_sorter.Finish([&](const CatalogNameRecord &name_record) {
+                    return fs::WriteFile(&name_record, sizeof(name_record), 1, f) == 1;
+                });
+            }
+            if(written) {
+                written = amiibo_id_sorter.Finish([&](const CatalogAmiiboIdRecord &amiibo_id_record) {
+                    return fs::WriteFile(&amiibo_id_record, sizeof(amiibo_id_record), 1, f) == 1;
+                });
+            }
+        }
+        if(written) {
+            written = fs::WriteFile(this->dirs.data(), sizeof(CatalogDirectory), this->dirs.size(), f) == this->dirs.size();
+        }
+        if(written) {
+            written = fs::WriteFile(this->dir_names.data(), 1, this->dir_names.size(), f) == this->dir_names.size();
+        }
+        if(written) {
+            // Now all the sizes are known
+            header.dir_count = this->dirs.size();
+            header.dir_names_size = this->dir_names.size();
+            fseek(f, 0, SEEK_SET);
+            written = fs::WriteFile(&header, sizeof(header), 1, f) == 1;
+        }
+        fclose(f);
+        if(!written) {
+            fs::DeleteFile(path);
+        }
+        return written;
+    }
+
+    Catalog::Catalog(const std::string &path, u32 cache_page_count) : path(path), serial(0), file(nullptr), entry_count(0), indexed_count(0), entries_offset(0), ids_offset(0), names_offset(0), amiibo_ids_offset(0), dir_count(0), dir_names_size(0), cache_page_count(std::max(cache_page_count, 1u)) {
+        EMU_FS_SUBSYSTEM_SCOPE(Locator);
+        {
+            EMU_LOCK_SCOPE_WITH(g_cache_lock);
+            this->serial = g_next_catalog_serial++;
+            g_catalog_count++;
+        }
+        auto f = fs::OpenFile(path.c_str(), "rb");
+        if(f == nullptr) {
+            return;
+        }
+        // Whole pages are read at once, so stdio's own buffering would only be a waste of memory
+        setvbuf(f, nullptr, _IONBF, 0);
+
+        CatalogHeader header = {};
+        auto ok = (fs::ReadFile(&header, sizeof(header), 1, f) == 1) && (header.magic == CatalogHeader::Magic) && (header.format_version == CatalogHeader::CurrentFormatVersion) && (header.indexed_count <= header.entry_count) && (header.dir_count > 0) && (header.dir_names_size > 0);
+        const u64 entries_offset = sizeof(CatalogHeader);
+        const u64 ids_offset = entries_offset + header.entry_count * sizeof(CatalogEntry);
+        const u64 names_offset = ids_offset + header.entry_count * sizeof(CatalogIdRecord);
+        const u64 amiibo_ids_offset = names_offset + header.indexed_count * sizeof(CatalogNameRecord);
+        const u64 dirs_offset = amiibo_ids_offset + header.indexed_count * sizeof(CatalogAmiiboIdRecord);
+        if(ok) {
+            this->dirs.reset(new CatalogDirectory[header.dir_count]);
+            this->dir_names.reset(new char[header.dir_names_size]);
+            ok = fseek(f, dirs_offset, SEEK_SET) == 0;
+        }
+        if(ok) {
+            ok = fs::ReadFile(this->dirs.get(), sizeof(CatalogDirectory), header.dir_count, f) == header.dir_count;
+        }
+        if(ok) {
+            ok = fs::ReadFile(this->dir_names.get(), 1, header.dir_names_size, f) == header.dir_names_size;
+        }
+        if(ok) {
+            // Paths are rebuilt from these without further checks
+            ok = (this->dir_names[header.dir_names_size - 1] == '\0') && (this->dirs[0].parent_idx == CatalogInvalidDirectoryIndex);
+            for(u32 i = 0; ok && (i < header.dir_count); i++) {
+                const auto &dir = this->dirs[i];
+                ok = ((i == CatalogRootDirectoryIndex) || (dir.parent_idx < i)) && (dir.name_offset < header.dir_names_size) && (dir.child_count <= header.dir_count) && (dir.first_child_idx <= (header.dir_count - dir.child_count)) && (dir.entry_count <= header.entry_count) && (dir.first_entry_idx <= (header.entry_count - dir.entry_count));
+            }
+        }
+
+        if(ok) {
+            this->file = f;
+            this->entry_count = header.entry_count;
+            this->indexed_count = header.indexed_count;
+            this->entries_offset = entries_offset;
+            this->ids_offset = ids_offset;
+            this->names_offset = names_offset;
+            this->amiibo_ids_offset = amiibo_ids_offset;
+            this->dir_count = header.dir_count;
+            this->dir_names_size = header.dir_names_size;
+        }
+        else {
+            this->dirs.reset();
+            this->dir_names.reset();
+            fclose(f);
+        }
+    }
+
+    Catalog::~Catalog() {
+        {
+            EMU_LOCK_SCOPE_WITH(g_cache_lock);
+            g_catalog_count--;
+            if(g_catalog_count == 0) {
+                g_cached_pages.reset();
+                g_cached_page_count = 0;
+            }
+            else {
+                // Serials are never reused, but the pages can go to other catalogs right away
+                for(u32 i = 0; i < g_cached_page_count; i++) {
+                    auto &page = g_cached_pages[i];
+                    if(page.catalog_serial == this->serial) {
+                        page.offset = InvalidPageOffset;
+                        page.last_use = 0;
+                    }
+                }
+            }
+        }
+        if(this->file != nullptr) {
+            fclose(this->file);
+        }
+        fs::DeleteFile(this->path);
+    }
+
+    Lock &Catalog::GetCacheLock() {
+        return g_cache_lock;
+    }
+
+    // Expects the cache lock to be held
+    const u8 *Catalog::GetPage(u64 offset, size_t size) {
+        EMU_FS_SUBSYSTEM_SCOPE(Locator);
+        // The newest catalog's page count wins (it only differs if the setting changed), cached pages are just dropped
+        if(!g_cached_pages || (g_cached_page_count != this->cache_page_count)) {
+            g_cached_pages.reset(new CachedPage[this->cache_page_count]);
+            g_cached_page_count = this->cache_page_count;
+            for(u32 i = 0; i < g_cached_page_count; i++) {
+                g_cached_pages[i].offset = InvalidPageOffset;
+                g_cached_pages[i].last_use = 0;
+            }
+        }
+
+        // Use the page if it's cached, otherwise replace the least recently used one
+        CachedPage *lru_page = &g_cached_pages[0];
+        for(u32 i = 0; i < g_cached_page_count; i++) {
+            auto &page = g_cached_pages[i];
+            if((page.offset == offset) && (page.catalog_serial == this->serial)) {
+                page.last_use = ++g_page_use_counter;
+                return page.data;
+            }
+            if(page.last_use < lru_page->last_use) {
+                lru_page = &page;
+            }
+        }
+
+        lru_page->offset = InvalidPageOffset;
+        lru_page->last_use = 0;
+        if(fseek(this->file, offset, SEEK_SET) != 0) {
+            return nullptr;
+        }
+        if(fs::ReadFile(lru_page->data, 1, size, this->file) != size) {
+            return nullptr;
+        }
+        lru_page->catalog_serial = this->serial;
+        lru_page->offset = offset;
+        lru_page->last_use = ++g_page_use_counter;
+        return lru_page->data;
+    }
+
+    bool Catalog::GetEntry(u32 idx, CatalogEntry &out_entry) {
+        EMU_LOCK_SCOPE_WITH(g_cache_lock);
+        if(idx < this->entry_count) {
+            auto entry = this->GetRecord<CatalogEntry>(this->entries_offset, this->entry_count, idx);
+            if(entry != nullptr) {
+                out_entry = *entry;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Catalog::FindEntry(u64 id, u32 &out_idx) {
+        EMU_LOCK_SCOPE_WITH(g_cache_lock);
+        // Binary search over the id index, the cache keeps the first few levels around
+        u32 low = 0;
+        u32 high = this->entry_count;
+        while(low < high) {
+            const auto mid = low + (high - low) / 2;
+            auto id_record = this->GetRecord<CatalogIdRecord>(this->ids_offset, this->entry_count, mid);
+            if(id_record == nullptr) {
+                return false;
+            }
+            if(id_record->id == id) {
+                out_idx = id_record->entry_idx;
+                return out_idx < this->entry_count;
+            }
+            if(id_record->id < id) {
+                low = mid + 1;
+            }
+            else {
+                high = mid;
+            }
+        }
+        return false;
+    }
+
+    bool Catalog::IsValidEntry(const CatalogEntry &entry) {
+        if(entry.dir_idx >= this->dir_count) {
+            return false;
+        }
+        // The pool ends with a terminator, so any offset inside it is a valid string
+        return (entry.name_offset == CatalogInlineEntryName) ? (entry.name[sizeof(entry.name) - 1] == '\0') : (entry.name_offset < this->dir_names_size);
+    }
+
+    bool Catalog::GetEntryPath(const CatalogEntry &entry, char *out_path, size_t out_path_size) {
+        if(!this->IsValidEntry(entry)) {
+            return false;
+        }
+        return FormatEntryPath(this->dirs.get(), this->dir_names.get(), entry, out_path, out_path_size);
+    }
+
+    bool Catalog::GetPath(u32 idx, char *out_path, size_t out_path_size) {
+        EMU_LOCK_SCOPE_WITH(g_cache_lock);
+        if(idx < this->entry_count) {
+            auto entry = this->GetRecord<CatalogEntry>(this->entries_offset, this->entry_count, idx);
+            if(entry != nullptr) {
+                return this->GetEntryPath(*entry, out_path, out_path_size);
+            }
+        }
+        return false;
+    }
+
+    bool Catalog::GetPathById(u64 id, char *out_path, size_t out_path_size) {
+        EMU_LOCK_SCOPE_WITH(g_cache_lock);
+        u32 idx = 0;
+        if(this->FindEntry(id, idx)) {
+            return this->GetPath(idx, out_path, out_path_size);
+        }
+        return false;
+    }
+
+    bool Catalog::FindFolder(u64 folder_id, u32 &out_dir_idx) {
+        // Directories are few compared to virtual amiibos, and already in memory
+        for(u32 i = 0; i < this->dir_count; i++) {
+            if(this->dirs[i].id == folder_id) {
+                out_dir_idx = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Catalog::ListFolder(u64 folder_id, u32 offset, VirtualAmiiboFolderItem *out_items, u32 max_count, u32 &out_count, u32 &out_total_count) {
+        EMU_LOCK_SCOPE_WITH(g_cache_lock);
+        u32 dir_idx = 0;
+        if(!this->FindFolder(folder_id, dir_idx)) {
+            return false;
+        }
+        const auto &dir = this->dirs[dir_idx];
+        out_count = 0;
+        out_total_count = dir.child_count + dir.entry_count;
+
+        auto pos = offset;
+        while((out_count < max_count) && (pos < dir.child_count)) {
+            const auto &child_dir = this->dirs[dir.first_child_idx + pos];
+            auto &item = out_items[out_count];
+            item = {};
+            item.id = child_dir.id;
+            item.type = VirtualAmiiboFolderItemType_Folder;
+            strncpy(item.name, &this->dir_names[child_dir.name_offset], sizeof(item.name) - 1);
+            out_count++;
+            pos++;
+        }
+        while((out_count < max_count) && (pos < out_total_count)) {
+            auto entry = this->GetRecord<CatalogEntry>(this->entries_offset, this->entry_count, dir.first_entry_idx + (pos - dir.child_count));
+            if((entry == nullptr) || !this->IsValidEntry(*entry)) {
+                break;
+            }
+            auto &item = out_items[out_count];
+            item = {};
+            item.id = entry->id;
+            item.type = VirtualAmiiboFolderItemType_VirtualAmiibo;
+            // Names which don't fit are truncated here, the id still refers to the right virtual amiibo
+            strncpy(item.name, GetEntryName(this->dir_names.get(), *entry), sizeof(item.name) - 1);
+            out_count++;
+            pos++;
+        }
+        return true;
+    }
+
+    template<typename T, typename F>
+    bool Catalog::LowerBound(u64 section_offset, u32 record_count, F is_before, u32 &out_pos) {
+        u32 low = 0;
+        u32 high = record_count;
+        while(low < high) {
+            const auto mid = low + (high - low) / 2;
+            auto record = this->GetRecord<T>(section_offset, record_count, mid);
+            if(record == nullptr) {
+                return false;
+            }
+            if(is_before(*record)) {
+                low = mid + 1;
+            }
+            else {
+                high = mid;
+            }
+        }
+        out_pos = low;
+        return true;
+    }
+
+    template<typename T, typename F>
+    u32 Catalog::QueryIndex(u64 section_offset, u32 start_pos, F classify, u64 *out_ids, u32 max_count, u32 &out_next_cursor) {
+        out_next_cursor = VirtualAmiiboQueryEndCursor;
+        u32 found_count = 0;
+        u32 scanned_count = 0;
+        auto pos = start_pos;
+        while((pos < this->indexed_count) && (found_count < max_count)) {
+            if(scanned_count == CatalogMaxQueryScanCount) {
+                out_next_cursor = pos;
+                break;
+            }
+            auto record = this->GetRecord<T>(section_offset, this->indexed_count, pos);
+            if(record == nullptr) {
+                break;
+            }
+            // Negative: past the range, zero: not a match, positive: match
+            const auto match = classify(*record);
+            if(match < 0) {
+                break;
+            }
+            if(match > 0) {
+                out_ids[found_count] = record->id;
+                found_count++;
+            }
+            pos++;
+            scanned_count++;
+        }
+        if((found_count == max_count) && (pos < this->indexed_count)) {
+            out_next_cursor = pos;
+        }
+        return found_count;
+    }
+
+    u32 Catalog::Query(const VirtualAmiiboQuery &query, u64 *out_ids, u32 max_count, u32 &out_next_cursor) {
+        EMU_LOCK_SCOPE_WITH(g_cache_lock);
+        out_next_cursor = VirtualAmiiboQueryEndCursor;
+        if(query.cursor == VirtualAmiiboQueryEndCursor) {
+            return 0;
+        }
+        char name_prefix[sizeof(query.name_prefix)] = {};
+        memcpy(name_prefix, query.name_prefix, sizeof(name_prefix) - 1);
+        const auto name_prefix_len = strlen(name_prefix);
+
+        // Pick the index which narrows the range the most, the rest of the filter is checked on every record
+        u32 start_pos = 0;
+        if((name_prefix_len == 0) && (query.flags & VirtualAmiiboQueryFlag_Series)) {
+            const auto filter_character = (query.flags & VirtualAmiiboQueryFlag_GameCharacterId) != 0;
+            auto is_before = [&](const CatalogAmiiboIdRecord &record) {
+                if(record.series != query.series) {
+                    return record.series < query.series;
+                }
+                return filter_character && (record.game_character_id < query.game_character_id);
+            };
+            if(!this->LowerBound<CatalogAmiiboIdRecord>(this->amiibo_ids_offset, this->indexed_count, is_before, start_pos)) {
+                return 0;
+            }
+            return this->QueryIndex<CatalogAmiiboIdRecord>(this->amiibo_ids_offset, std::max(start_pos, query.cursor), [&](const CatalogAmiiboIdRecord &record) {
+                if((record.series != query.series) || (filter_character && (record.game_character_id != query.game_character_id))) {
+                    return -1;
+                }
+                return MatchesQuery(query, record.series, record.game_character_id, record.figure_type) ? 1 : 0;
+            }, out_ids, max_count, out_next_cursor);
+        }
+        else {
+            auto is_before = [&](const CatalogNameRecord &record) {
+                return strncasecmp(record.name, name_prefix, name_prefix_len) < 0;
+            };
+            if(!this->LowerBound<CatalogNameRecord>(this->names_offset, this->indexed_count, is_before, start_pos)) {
+                return 0;
+            }
+            return this->QueryIndex<CatalogNameRecord>(this->names_offset, std::max(start_pos, query.cursor), [&](const CatalogNameRecord &record) {
+                if(strncasecmp(record.name, name_prefix, name_prefix_len) != 0) {
+                    return -1;
+                }
+                const auto amiibo_id = record.amiibo_id;
+                return MatchesQuery(query, amiibo_id.series, amiibo_id.character_id.game_character_id, amiibo_id.figure_type) ? 1 : 0;
+            }, out_ids, max_count, out_next_cursor);
+        }
+    }
+
+}
@@ -0,0 +1,144 @@
+#include <sys/sys_Devices.hpp>
+#include <sys/sys_Locator.hpp>
+
+namespace sys {
+
+    namespace {
+
+        struct DeviceSlot {
+            // Only accessed through std::atomic_load/std::atomic_store
+            std::shared_ptr<amiibo::VirtualAmiibo> amiibo;
+            std::atomic<VirtualAmiiboStatus> status;
+        };
+
+        DeviceSlot g_device_slots[DeviceSlotCount];
+
+        u32 g_connected_npad_ids[DeviceSlotCount] = {};
+        u32 g_connected_npad_count = 0;
+        u64 g_connected_npads_tick = 0;
+        bool g_connected_npads_valid = false;
+        Lock g_connected_npads_lock;
+
+        inline HidControllerID GetSlotControllerId(u32 slot) {
+            return (slot == (DeviceSlotCount - 1)) ? CONTROLLER_HANDHELD : static_cast<HidControllerID>(CONTROLLER_PLAYER_1 + slot);
+        }
+
+        // Expects the connected npads lock to be held
+        void RefreshConnectedNpads() {
+            hidScanInput();
+            g_connected_npad_count = 0;
+            for(u32 i = 0; i < DeviceSlotCount; i++) {
+                if(hidIsControllerConnected(GetSlotControllerId(i))) {
+                    g_connected_npad_ids[g_connected_npad_count] = GetDeviceSlotNpadId(i);
+                    g_connected_npad_count++;
+                }
+            }
+            if(g_connected_npad_count == 0) {
+                g_connected_npad_ids[0] = HandheldNpadId;
+                g_connected_npad_count = 1;
+            }
+            g_connected_npads_tick = armGetSystemTick();
+            g_connected_npads_valid = true;
+        }
+
+        inline DeviceSlot *GetSlot(u32 npad_id) {
+            const auto slot = GetDeviceSlot(npad_id);
+            return (slot != InvalidDeviceSlot) ? &g_device_slots[slot] : nullptr;
+        }
+
+    }
+
+    u32 GetConnectedNpadIds(u32 *out_npad_ids, u32 max_count) {
+        EMU_LOCK_SCOPE_WITH(g_connected_npads_lock);
+        const auto elapsed_ms = armTicksToNs(armGetSystemTick() - g_connected_npads_tick) / 1'000'000;
+        if(!g_connected_npads_valid || (elapsed_ms >= NpadCacheRefreshIntervalMs)) {
+            RefreshConnectedNpads();
+        }
+        const auto count = std::min(max_count, g_connected_npad_count);
+        memcpy(out_npad_ids, g_connected_npad_ids, count * sizeof(u32));
+        return count;
+    }
+
+    void InvalidateConnectedNpadCache() {
+        EMU_LOCK_SCOPE_WITH(g_connected_npads_lock);
+        g_connected_npads_valid = false;
+    }
+
+    std::shared_ptr<amiibo::VirtualAmiibo> GetDeviceVirtualAmiibo(u32 npad_id) {
+        auto slot = GetSlot(npad_id);
+        if(slot == nullptr) {
+            return nullptr;
+        }
+        auto amiibo = std::atomic_load(&slot->amiibo);
+        if(amiibo != nullptr) {
+            return amiibo;
+        }
+        return GetActiveVirtualAmiibo();
+    }
+
+    VirtualAmiiboStatus GetDeviceVirtualAmiiboStatus(u32 npad_id) {
+        auto slot = GetSlot(npad_id);
+        if(slot == nullptr) {
+            return VirtualAmiiboStatus::Invalid;
+        }
+        if(std::atomic_load(&slot->amiibo) != nullptr) {
+            return slot->status.load();
+        }
+        return GetActiveVirtualAmiiboStatus();
+    }
+
+    bool SetDeviceVirtualAmiibo(u32 npad_id, std::shared_ptr<amiibo::VirtualAmiibo> amiibo) {
+        auto slot = GetSlot(npad_id);
+        if(slot == nullptr) {
+            return false;
+        }
+        const auto status = ((amiibo != nullptr) && amiibo->IsValid()) ? VirtualAmiiboStatus::Connected : VirtualAmiiboStatus::Invalid;
+        const auto amiibo_ptr = amiibo.get();
+        // The status is set first, so that the new virtual amiibo is never seen with the previous one's status
+        const auto prev_status = slot->status.exchange(status);
+        const auto prev_amiibo = std::atomic_exchange(&slot->amiibo, std::move(amiibo));
+        EMU_LOG_VERBOSE_FMT("Device 0x" << std::hex << npad_id << " virtual amiibo status: " << std::dec << static_cast<u32>(status))
+        if((prev_amiibo.get() != amiibo_ptr) || (prev_status != status)) {
+            NotifyDeviceStatusChange();
+        }
+        return true;
+    }
+
+    bool SetDeviceVirtualAmiiboStatus(u32 npad_id, VirtualAmiiboStatus status) {
+        auto slot = GetSlot(npad_id);
+        if(slot == nullptr) {
+            return false;
+        }
+        auto amiibo = std::atomic_load(&slot->amiibo);
+        if(amiibo == nullptr) {
+            SetActiveVirtualAmiiboStatus(status);
+            return true;
+        }
+        const auto new_status = amiibo->IsValid() ? status : VirtualAmiiboStatus::Invalid;
+        if(slot->status.exchange(new_status) != new_status) {
+            NotifyDeviceStatusChange();
+        }
+        return true;
+    }
+
+    bool GetDeviceStatus(u32 npad_id, DeviceStatus &out_status) {
+        auto slot = GetSlot(npad_id);
+        if(slot == nullptr) {
+            return false;
+        }
+        out_status = {};
+        out_status.npad_id = npad_id;
+        out_status.has_own_virtual_amiibo = std::atomic_load(&slot->amiibo) != nullptr;
+        out_status.virtual_amiibo_status = GetDeviceVirtualAmiiboStatus(npad_id);
+        auto amiibo = GetDeviceVirtualAmiibo(npad_id);
+        if((amiibo != nullptr) && amiibo->IsValid()) {
+            GetVirtualAmiiboId(amiibo->GetPath(), out_status.virtual_amiibo_id);
+        }
+
+        u32 connected_npad_ids[DeviceSlotCount] = {};
+        const auto connected_count = GetConnectedNpadIds(connected_npad_ids, DeviceSlotCount);
+        out_status.connected = std::find(connected_npad_ids, connected_npad_ids + connected_count, npad_id) != (connected_npad_ids + connected_count);
+        return true;
+    }
+
+}
@@ -1,11 +1,173 @@
 #include <sys/sys_Emulation.hpp>
+#include <sys/sys_Locator.hpp>
+#include <sys/sys_Settings.hpp>
+#include <sys/sys_Playlist.hpp>
+#include <fs/fs_FileSystem.hpp>
 
 namespace sys {
 
     static EmulationStatus g_emulation_status = EmulationStatus::Off;
-    static amiibo::VirtualAmiibo g_virtual_amiibo;
+    static std::shared_ptr<amiibo::VirtualAmiibo> g_virtual_amiibo;
     static VirtualAmiiboStatus g_virtual_amiibo_status = VirtualAmiiboStatus::Invalid;
+    static u64 g_status_sequence_number = 0;
+    static std::vector<ams::os::SystemEvent*> g_status_change_events;
     static Lock g_emulation_lock;
+    // Instances are only kept alive by their users, expired ones are dropped on the next load
+    static std::map<std::string, std::weak_ptr<amiibo::VirtualAmiibo>> g_loaded_virtual_amiibos;
+    static Lock g_loaded_virtual_amiibos_lock;
+
+    // The control block adds a few pointers, anything bigger would silently fall back to the heap
+    static_assert((sizeof(amiibo::VirtualAmiibo) + 0x40) <= mem::ObjectPoolBlockSize, "Virtual amiibos don't fit in object pool blocks!");
+
+    namespace {
+
+        struct PersistedEmulationState {
+            static constexpr u32 Magic = 0x54534D45; // "EMST"
+
+            u32 magic;
+            EmulationStatus emulation_status;
+            // Invalid if there was no active virtual amiibo
+            VirtualAmiiboStatus active_virtual_amiibo_status;
+            u32 reserved;
+            char active_virtual_amiibo_path[FS_MAX_PATH];
+            u8 reserved_2[0x3];
+        };
+
+        static_assert(sizeof(PersistedEmulationState) == 0x314, "Invalid PersistedEmulationState struct!");
+
+        // Boot work (scanning and building the catalog) runs on it too, hence the bigger stack
+        // The stack is static, since the thread never exits and the heap is small
+        constexpr size_t PersistThreadStackSize = 0x4000;
+        constexpr int PersistThreadPriority = 0x3b;
+
+        alignas(0x1000) u8 g_persist_thread_stack[PersistThreadStackSize];
+        ams::os::Thread g_persist_thread;
+        BootWorkFunction g_boot_work = nullptr;
+        // Signaled on every change, and cleared once the persist thread wakes up
+        UEvent g_persist_request_event;
+        bool g_persist_started = false;
+        // Protected by the emulation lock
+        std::vector<std::shared_ptr<amiibo::VirtualAmiibo>> g_pending_virtual_amiibo_saves;
+        bool g_pending_cache_update = false;
+
+        // Expects the emulation lock to be held
+        PersistedEmulationState MakePersistedEmulationState() {
+            PersistedEmulationState state = {};
+            state.magic = PersistedEmulationState::Magic;
+            state.emulation_status = g_emulation_status;
+            state.active_virtual_amiibo_status = VirtualAmiiboStatus::Invalid;
+            if((g_virtual_amiibo != nullptr) && g_virtual_amiibo->IsValid()) {
+                state.active_virtual_amiibo_status = g_virtual_amiibo_status;
+                strncpy(state.active_virtual_amiibo_path, g_virtual_amiibo->GetPath().c_str(), sizeof(state.active_virtual_amiibo_path) - 1);
+            }
+            return state;
+        }
+
+        void PersistThreadMain(void*) {
+            mem::BindThreadScratchArena(&mem::GetPersistScratchArena());
+            // The state at boot is already saved (or was just restored from there)
+            PersistedEmulationState last_state;
+            {
+                EMU_LOCK_SCOPE_WITH(g_emulation_lock);
+                last_state = MakePersistedEmulationState();
+            }
+            // Changes made meanwhile are just queued, and saved right after
+            if(g_boot_work != nullptr) {
+                g_boot_work();
+            }
+            while(true) {
+                waitSingle(waiterForUEvent(&g_persist_request_event), -1);
+                svcSleepThread(GetEmulationStateFlushDelayMs() * 1'000'000ul);
+
+                PersistedEmulationState state;
+                std::vector<std::shared_ptr<amiibo::VirtualAmiibo>> pending_saves;
+                bool cache_update = false;
+                {
+                    EMU_LOCK_SCOPE_WITH(g_emulation_lock);
+                    state = MakePersistedEmulationState();
+                    pending_saves.swap(g_pending_virtual_amiibo_saves);
+                    std::swap(cache_update, g_pending_cache_update);
+                }
+                for(auto &amiibo: pending_saves) {
+                    EMU_WRITE_LOCK_SCOPE_WITH(amiibo->GetLock());
+                    amiibo->Save();
+                }
+                // Changes which were undone meanwhile (like toggling the emulation twice) don't need to be saved
+                if(ShouldPersistEmulationState() && (memcmp(&state, &last_state, sizeof(state)) != 0)) {
+                    EMU_FS_SUBSYSTEM_SCOPE(Emulation);
+                    fs::Save(consts::EmulationStatePath, state);
+                    last_state = state;
+                }
+                // Sessions keep their pinned catalog, new ones pin the rebuilt one once it's published
+                if(cache_update) {
+                    UpdateVirtualAmiiboCache();
+                }
+            }
+        }
+
+        // Expects the emulation lock to be held
+        void NotifyStatusChange() {
+            g_status_sequence_number++;
+            for(auto event: g_status_change_events) {
+                event->Signal();
+            }
+            if(g_persist_started) {
+                ueventSignal(&g_persist_request_event);
+            }
+        }
+
+        bool SetActiveVirtualAmiiboStatusImpl(VirtualAmiiboStatus status) {
+            const auto new_status = IsActiveVirtualAmiiboValid() ? status : VirtualAmiiboStatus::Invalid;
+            const auto changed = new_status != g_virtual_amiibo_status;
+            g_virtual_amiibo_status = new_status;
+            return changed;
+        }
+
+    }
+
+    std::shared_ptr<amiibo::VirtualAmiibo> LoadVirtualAmiibo(const std::string &amiibo_path) {
+        auto amiibo = FindLoadedVirtualAmiibo(amiibo_path);
+        if(amiibo != nullptr) {
+            return amiibo;
+        }
+
+        // Loaded without the lock, since this is the slow part
+        auto new_amiibo = std::allocate_shared<amiibo::VirtualAmiibo>(mem::PoolAllocator<amiibo::VirtualAmiibo>(), amiibo_path);
+        if(!new_amiibo->IsValid()) {
+            return nullptr;
+        }
+
+        EMU_LOCK_SCOPE_WITH(g_loaded_virtual_amiibos_lock);
+        // Someone else might have loaded it meanwhile, their instance wins
+        auto &loaded_amiibo = g_loaded_virtual_amiibos[amiibo_path];
+        amiibo = loaded_amiibo.lock();
+        if(amiibo != nullptr) {
+            return amiibo;
+        }
+        loaded_amiibo = new_amiibo;
+        for(auto it = g_loaded_virtual_amiibos.begin(); it != g_loaded_virtual_amiibos.end();) {
+            if(it->second.expired()) {
+                it = g_loaded_virtual_amiibos.erase(it);
+            }
+            else {
+                it++;
+            }
+        }
+        return new_amiibo;
+    }
+
+    std::shared_ptr<amiibo::VirtualAmiibo> FindLoadedVirtualAmiibo(const std::string &amiibo_path) {
+        EMU_LOCK_SCOPE_WITH(g_loaded_virtual_amiibos_lock);
+        const auto it = g_loaded_virtual_amiibos.find(amiibo_path);
+        if(it == g_loaded_virtual_amiibos.end()) {
+            return nullptr;
+        }
+        auto amiibo = it->second.lock();
+        if((amiibo == nullptr) || !amiibo->IsValid()) {
+            return nullptr;
+        }
+        return amiibo;
+    }
 
     EmulationStatus GetEmulationStatus() {
         EMU_LOCK_SCOPE_WITH(g_emulation_lock);
@@ -14,23 +176,31 @@ namespace sys {
 
     void SetEmulationStatus(EmulationStatus status) {
         EMU_LOCK_SCOPE_WITH(g_emulation_lock);
-        g_emulation_status = status;
+        if(status != g_emulation_status) {
+            g_emulation_status = status;
+            NotifyStatusChange();
+        }
     }
 
-    amiibo::VirtualAmiibo &GetActiveVirtualAmiibo() {
+    std::shared_ptr<amiibo::VirtualAmiibo> GetActiveVirtualAmiibo() {
         EMU_LOCK_SCOPE_WITH(g_emulation_lock);
         return g_virtual_amiibo;
     }
 
     bool IsActiveVirtualAmiiboValid() {
         EMU_LOCK_SCOPE_WITH(g_emulation_lock);
-        return g_virtual_amiibo.IsValid();
+        return (g_virtual_amiibo != nullptr) && g_virtual_amiibo->IsValid();
     }
 
-    void SetActiveVirtualAmiibo(amiibo::VirtualAmiibo amiibo) {
+    void SetActiveVirtualAmiibo(std::shared_ptr<amiibo::VirtualAmiibo> amiibo) {
         EMU_LOCK_SCOPE_WITH(g_emulation_lock);
-        g_virtual_amiibo = amiibo;
-        SetActiveVirtualAmiiboStatus(VirtualAmiiboStatus::Connected);
+        const auto amiibo_changed = amiibo != g_virtual_amiibo;
+        g_virtual_amiibo = std::move(amiibo);
+        EMU_LOG_FMT("Setting new virtual amiibo status: " << static_cast<u32>(VirtualAmiiboStatus::Connected))
+        const auto status_changed = SetActiveVirtualAmiiboStatusImpl(VirtualAmiiboStatus::Connected);
+        if(amiibo_changed || status_changed) {
+            NotifyStatusChange();
+        }
     }
 
     VirtualAmiiboStatus GetActiveVirtualAmiiboStatus() {
@@ -42,13 +212,132 @@ namespace sys {
     }
 
     void SetActiveVirtualAmiiboStatus(VirtualAmiiboStatus status) {
+        // Reconnecting moves the playlist forward, its next entry is taken before locking since it might need to be loaded
+        std::shared_ptr<amiibo::VirtualAmiibo> playlist_amiibo;
+        if((status == VirtualAmiiboStatus::Connected) && (GetActiveVirtualAmiiboStatus() == VirtualAmiiboStatus::Disconnected) && ShouldAdvancePlaylistOn(PlaylistAdvanceFlag_Reconnect)) {
+            playlist_amiibo = AdvancePlaylist();
+        }
+
         EMU_LOCK_SCOPE_WITH(g_emulation_lock);
+        auto amiibo_changed = false;
+        if(playlist_amiibo != nullptr) {
+            EMU_LOG_FMT("Advancing playlist to virtual amiibo '" << playlist_amiibo->GetName() << "'")
+            amiibo_changed = playlist_amiibo != g_virtual_amiibo;
+            g_virtual_amiibo = std::move(playlist_amiibo);
+        }
         EMU_LOG_FMT("Setting new virtual amiibo status: " << static_cast<u32>(status))
-        if(IsActiveVirtualAmiiboValid()) {
-            g_virtual_amiibo_status = status;
+        const auto status_changed = SetActiveVirtualAmiiboStatusImpl(status);
+        if(amiibo_changed || status_changed) {
+            NotifyStatusChange();
         }
-        else {
-            g_virtual_amiibo_status = VirtualAmiiboStatus::Invalid;
+    }
+
+    void NotifyDeviceStatusChange() {
+        EMU_LOCK_SCOPE_WITH(g_emulation_lock);
+        NotifyStatusChange();
+    }
+
+    EmulationStatusSnapshot GetEmulationStatusSnapshot() {
+        EMU_LOCK_SCOPE_WITH(g_emulation_lock);
+        EmulationStatusSnapshot snapshot = {};
+        snapshot.sequence_number = g_status_sequence_number;
+        snapshot.emulation_status = g_emulation_status;
+        snapshot.active_virtual_amiibo_status = GetActiveVirtualAmiiboStatus();
+        if(snapshot.active_virtual_amiibo_status != VirtualAmiiboStatus::Invalid) {
+            GetVirtualAmiiboId(g_virtual_amiibo->GetPath(), snapshot.active_virtual_amiibo_id);
+        }
+        return snapshot;
+    }
+
+    void RegisterStatusChangeEvent(ams::os::SystemEvent *event) {
+        EMU_LOCK_SCOPE_WITH(g_emulation_lock);
+        g_status_change_events.push_back(event);
+    }
+
+    void UnregisterStatusChangeEvent(ams::os::SystemEvent *event) {
+        EMU_LOCK_SCOPE_WITH(g_emulation_lock);
+        g_status_change_events.erase(std::remove(g_status_change_events.begin(), g_status_change_events.end(), event), g_status_change_events.end());
+    }
+
+    bool RestoreEmulationState() {
+        if(!ShouldPersistEmulationState()) {
+            return false;
+        }
+
+        PersistedEmulationState state = {};
+        {
+            EMU_FS_SUBSYSTEM_SCOPE(Emulation);
+            state = fs::Read<PersistedEmulationState>(consts::EmulationStatePath);
+        }
+        if(state.magic != PersistedEmulationState::Magic) {
+            return false;
+        }
+        state.active_virtual_amiibo_path[sizeof(state.active_virtual_amiibo_path) - 1] = '\0';
+
+        // Loaded before taking the lock, since this is the slow part
+        std::shared_ptr<amiibo::VirtualAmiibo> amiibo;
+        if((state.active_virtual_amiibo_status == VirtualAmiiboStatus::Connected) || (state.active_virtual_amiibo_status == VirtualAmiiboStatus::Disconnected)) {
+            // Null if it was removed (or moved) since then
+            amiibo = LoadVirtualAmiibo(state.active_virtual_amiibo_path);
+        }
+
+        EMU_LOCK_SCOPE_WITH(g_emulation_lock);
+        if((state.emulation_status == EmulationStatus::On) || (state.emulation_status == EmulationStatus::Off)) {
+            g_emulation_status = state.emulation_status;
+        }
+        const auto restored = amiibo != nullptr;
+        if(restored) {
+            g_virtual_amiibo = std::move(amiibo);
+            g_virtual_amiibo_status = state.active_virtual_amiibo_status;
+        }
+        NotifyStatusChange();
+        EMU_LOG_FMT("Restored emulation status: " << static_cast<u32>(g_emulation_status) << ", virtual amiibo: " << std::boolalpha << restored)
+        return restored;
+    }
+
+    void QueueVirtualAmiiboSave(std::shared_ptr<amiibo::VirtualAmiibo> amiibo) {
+        {
+            EMU_LOCK_SCOPE_WITH(g_emulation_lock);
+            if(g_persist_started) {
+                if(std::find(g_pending_virtual_amiibo_saves.begin(), g_pending_virtual_amiibo_saves.end(), amiibo) == g_pending_virtual_amiibo_saves.end()) {
+                    g_pending_virtual_amiibo_saves.push_back(std::move(amiibo));
+                }
+                ueventSignal(&g_persist_request_event);
+                return;
+            }
+        }
+
+        // Without the persist thread there's nothing to coalesce with
+        EMU_WRITE_LOCK_SCOPE_WITH(amiibo->GetLock());
+        amiibo->Save();
+    }
+
+    void QueueVirtualAmiiboCacheUpdate() {
+        EMU_LOCK_SCOPE_WITH(g_emulation_lock);
+        // Without the persist thread there's no update, rescanning on the caller's thread would block the server until it's done
+        if(g_persist_started) {
+            g_pending_cache_update = true;
+            ueventSignal(&g_persist_request_event);
+        }
+    }
+
+    void StartEmulationStatePersistence(BootWorkFunction boot_work) {
+        {
+            EMU_LOCK_SCOPE_WITH(g_emulation_lock);
+            if(g_persist_started) {
+                return;
+            }
+            g_boot_work = boot_work;
+            ueventCreate(&g_persist_request_event, true);
+            if(R_SUCCEEDED(g_persist_thread.Initialize(&PersistThreadMain, nullptr, g_persist_thread_stack, PersistThreadStackSize, PersistThreadPriority)) && R_SUCCEEDED(g_persist_thread.Start())) {
+                g_persist_started = true;
+                return;
+            }
+        }
+
+        // Without the thread, the boot work is done here instead (and changes are saved right away)
+        if(boot_work != nullptr) {
+            boot_work();
         }
     }
 
@@ -1,58 +1,164 @@
 #include <sys/sys_Locator.hpp>
-#include <fs/fs_FileSystem.hpp>
-#include <amiibo/amiibo_Formats.hpp>
-#include <dirent.h>
-#include <vector>
+#include <sys/sys_System.hpp>
+#include <sys/sys_Scanner.hpp>
+#include <sys/sys_Catalog.hpp>
+#include <sys/sys_Settings.hpp>
+#include <sys/sys_Boot.hpp>
 
 namespace sys {
 
-    static std::vector<std::string> g_cached_amiibos;
-    static Lock g_cached_amiibos_lock;
-    
-    static std::vector<std::string> ListVirtualAmiibosImpl(const std::string &base_path) {
-        EMU_LOCK_SCOPE_WITH(g_cached_amiibos_lock);
-        std::vector<std::string> amiibos;
-        auto dir = opendir(base_path.c_str());
-        if(dir) {
-            while(true) {
-                auto dt = readdir(dir);
-                if(dt == nullptr) {
-                    break;
-                }
-                auto path = fs::Concat(base_path, dt->d_name);
-                // Is this format valid?
-                if(amiibo::VirtualAmiibo::IsValidVirtualAmiibo<amiibo::VirtualAmiibo>(path)) {
-                    amiibos.push_back(path);
-                }
-                else {
-                    // If it's a directory, scan and list amiibos there too
-                    if(fs::IsDirectory(path)) {
-                        auto inner_amiibos = ListVirtualAmiibosImpl(path);
-                        amiibos.insert(amiibos.end(), inner_amiibos.begin(), inner_amiibos.end());
+    // Always accessed atomically: readers just pin the current catalog, which stays alive (with its file) until the last one releases it
+    static std::shared_ptr<Catalog> g_catalog;
+    // Builds share the same temporary files, so only one can happen at a time
+    static Lock g_catalog_build_lock;
+    static u32 g_catalog_generation = 0;
+    static std::atomic_bool g_library_ready = false;
+    static ams::os::SystemEvent g_library_ready_event;
+    static bool g_library_ready_event_initialized = false;
+    static Lock g_library_ready_lock;
+
+    namespace {
+
+        void NotifyLibraryReady() {
+            EMU_LOCK_SCOPE_WITH(g_library_ready_lock);
+            g_library_ready = true;
+            if(g_library_ready_event_initialized) {
+                g_library_ready_event.Signal();
+            }
+        }
+
+        // Expects the catalog build lock to be held
+        inline void FormatCatalogPath(char (&out_path)[FS_MAX_PATH]) {
+            snprintf(out_path, sizeof(out_path), "%s/catalog_%u.bin", consts::CatalogDir.c_str(), g_catalog_generation);
+        }
+
+        // Expects the catalog build lock to be held, returns the published catalog (null if the built one isn't valid)
+        std::shared_ptr<Catalog> PublishCatalog(const char *catalog_path) {
+            auto catalog = std::make_shared<Catalog>(catalog_path, GetSettings().catalog_cache_page_count);
+            if(!catalog->IsValid()) {
+                return nullptr;
+            }
+            std::atomic_store(&g_catalog, catalog);
+            g_catalog_generation++;
+            return catalog;
+        }
+
+    }
+
+    void UpdateVirtualAmiiboCache(bool convert_legacy) {
+        EMU_FS_SUBSYSTEM_SCOPE(Locator);
+        EMU_LOCK_SCOPE_WITH(g_catalog_build_lock);
+        BeginBootPhase(BootPhase::AmiiboScan);
+        if(g_catalog_generation == 0) {
+            // Clean up catalogs left from previous boots
+            fs::RecreateDirectory(consts::CatalogDir);
+        }
+        char catalog_path[FS_MAX_PATH] = {};
+        FormatCatalogPath(catalog_path);
+
+        // The new catalog is built off to the side, readers keep using the current one meanwhile
+        bool built = false;
+        {
+            CatalogBuilder builder;
+            const auto relative_path_offset = consts::AmiiboDir.length() + 1;
+            std::vector<std::pair<std::string, amiibo::VirtualAmiiboFormat>> legacy_amiibos;
+            const auto scanned_dir_count = ScanVirtualAmiibos(consts::AmiiboDir, GetSettings().amiibo_scan_thread_count, [&](const std::string &path) {
+                builder.Add(path.c_str() + relative_path_offset);
+            }, convert_legacy ? &legacy_amiibos : nullptr);
+            SetBootPhaseEntryCount(scanned_dir_count);
+
+            // Conversions are rare and heavier on the stack, so they're done here instead of on the scan workers
+            BeginBootPhase(BootPhase::LegacyConversion);
+            u32 converted_count = 0;
+            for(const auto &[path, format]: legacy_amiibos) {
+                if(ConvertLegacyVirtualAmiibo(path, format)) {
+                    converted_count++;
+                    if(format != amiibo::VirtualAmiiboFormat::Bin) {
+                        builder.Add(path.c_str() + relative_path_offset);
                     }
                 }
             }
-            closedir(dir);
+            SetBootPhaseEntryCount(converted_count);
+
+            BeginBootPhase(BootPhase::CatalogBuild);
+            built = builder.Finalize(catalog_path);
+        }
+        EMU_LOG_FMT("Catalog built? " << std::boolalpha << built)
+
+        if(built) {
+            auto catalog = PublishCatalog(catalog_path);
+            if(catalog != nullptr) {
+                SetBootPhaseEntryCount(catalog->GetCount());
+            }
+        }
+
+        // Always after the catalog is published, so that a ready library without a catalog means the scan failed
+        if(!g_library_ready) {
+            NotifyLibraryReady();
         }
-        return amiibos;
     }
 
-    void UpdateVirtualAmiiboCache() {
-        EMU_LOCK_SCOPE_WITH(g_cached_amiibos_lock);
-        g_cached_amiibos = ListVirtualAmiibosImpl(consts::AmiiboDir);
+    bool AddVirtualAmiiboToCache(const char *relative_path) {
+        EMU_FS_SUBSYSTEM_SCOPE(Locator);
+        EMU_LOCK_SCOPE_WITH(g_catalog_build_lock);
+        auto base = std::atomic_load(&g_catalog);
+        if(base == nullptr) {
+            return false;
+        }
+        u32 base_idx = 0;
+        if(base->FindEntry(ComputeVirtualAmiiboId(relative_path), base_idx)) {
+            // Something was there before, its index records might not match the new virtual amiibo
+            UpdateVirtualAmiiboCache();
+            return true;
+        }
+        char catalog_path[FS_MAX_PATH] = {};
+        FormatCatalogPath(catalog_path);
+
+        // Entries come from the current catalog instead of the SD card, only the new virtual amiibo is actually loaded
+        bool built = false;
+        {
+            CatalogBuilder builder;
+            const auto relative_path_offset = consts::AmiiboDir.length() + 1;
+            char amiibo_path[FS_MAX_PATH] = {};
+            base->ListEntries(0, base->GetCount(), [&](const CatalogEntry &entry) {
+                if(base->GetEntryPath(entry, amiibo_path, sizeof(amiibo_path))) {
+                    builder.Add(amiibo_path + relative_path_offset);
+                }
+            });
+            builder.Add(relative_path);
+            built = builder.Finalize(catalog_path, base.get());
+        }
+        EMU_LOG_FMT("Catalog built with '" << relative_path << "'? " << std::boolalpha << built)
+        return built && (PublishCatalog(catalog_path) != nullptr);
+    }
+
+    std::shared_ptr<Catalog> GetVirtualAmiiboCatalog() {
+        return std::atomic_load(&g_catalog);
     }
 
-    u32 GetVirtualAmiiboCount() {
-        EMU_LOCK_SCOPE_WITH(g_cached_amiibos_lock);
-        return g_cached_amiibos.size();
+    bool GetVirtualAmiiboId(const std::string &path, u64 &out_id) {
+        const auto &amiibo_dir = consts::AmiiboDir;
+        if((path.length() > (amiibo_dir.length() + 1)) && (path.compare(0, amiibo_dir.length(), amiibo_dir) == 0) && (path[amiibo_dir.length()] == '/')) {
+            out_id = ComputeVirtualAmiiboId(path.c_str() + amiibo_dir.length() + 1);
+            return true;
+        }
+        return false;
+    }
+
+    bool IsVirtualAmiiboLibraryReady() {
+        return g_library_ready;
     }
 
-    std::string GetVirtualAmiibo(u32 idx) {
-        EMU_LOCK_SCOPE_WITH(g_cached_amiibos_lock);
-        if(idx < g_cached_amiibos.size()) {
-            return g_cached_amiibos[idx];
+    ams::os::SystemEvent &GetVirtualAmiiboLibraryReadyEvent() {
+        EMU_LOCK_SCOPE_WITH(g_library_ready_lock);
+        if(!g_library_ready_event_initialized) {
+            g_library_ready_event.InitializeAsInterProcessEvent();
+            g_library_ready_event_initialized = true;
+            if(g_library_ready) {
+                g_library_ready_event.Signal();
+            }
         }
-        return "";
+        return g_library_ready_event;
     }
 
 }
\ No newline at end of file
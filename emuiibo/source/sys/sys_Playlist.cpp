@@ -0,0 +1,209 @@
+#include <sys/sys_Playlist.hpp>
+#include <sys/sys_Locator.hpp>
+#include <sys/sys_Emulation.hpp>
+
+namespace sys {
+
+    namespace {
+
+        constexpr size_t PrefetchThreadStackSize = 0x4000;
+        constexpr int PrefetchThreadPriority = 0x3b;
+
+        // The thread never exits once started, so its stack doesn't come from the (small) heap
+        alignas(0x1000) u8 g_prefetch_thread_stack[PrefetchThreadStackSize];
+
+        std::vector<u64> g_playlist_ids;
+        u32 g_playlist_position = 0;
+        u32 g_playlist_advance_flags = 0;
+        // Increased every time the playlist or its position changes, so that outdated prefetches are dropped
+        u32 g_playlist_generation = 0;
+        std::shared_ptr<amiibo::VirtualAmiibo> g_prefetched_amiibo;
+        u32 g_prefetched_position = 0;
+        Lock g_playlist_lock;
+
+        ams::os::Thread g_prefetch_thread;
+        UEvent g_prefetch_request_event;
+        bool g_prefetch_started = false;
+        BackgroundLoadFunction g_pending_background_load = nullptr;
+
+        // Expects the playlist lock to be held
+        inline u32 GetNextPosition() {
+            return (g_playlist_position + 1) % g_playlist_ids.size();
+        }
+
+        // Never called with the playlist lock held, this is the slow part
+        std::shared_ptr<amiibo::VirtualAmiibo> LoadPlaylistEntry(u64 id) {
+            char amiibo_path[FS_MAX_PATH] = {};
+            auto catalog = GetVirtualAmiiboCatalog();
+            if((catalog == nullptr) || !catalog->GetPathById(id, amiibo_path, sizeof(amiibo_path))) {
+                EMU_LOG_ERR_FMT("Unable to find playlist virtual amiibo with id 0x" << std::hex << id)
+                return nullptr;
+            }
+            auto amiibo = LoadVirtualAmiibo(amiibo_path);
+            if(amiibo == nullptr) {
+                EMU_LOG_ERR_FMT("Invalid playlist virtual amiibo at '" << amiibo_path << "'")
+                return nullptr;
+            }
+            amiibo->Prewarm();
+            return amiibo;
+        }
+
+        void PrefetchThreadMain(void*) {
+            while(true) {
+                waitSingle(waiterForUEvent(&g_prefetch_request_event), -1);
+
+                BackgroundLoadFunction background_load = nullptr;
+                {
+                    EMU_LOCK_SCOPE_WITH(g_playlist_lock);
+                    std::swap(background_load, g_pending_background_load);
+                }
+                // Done first, since it might set a new playlist (making a prefetch for the current one pointless)
+                if(background_load != nullptr) {
+                    background_load();
+                }
+
+                u64 id = 0;
+                u32 position = 0;
+                u32 generation = 0;
+                {
+                    EMU_LOCK_SCOPE_WITH(g_playlist_lock);
+                    if(g_playlist_ids.empty() || (g_prefetched_amiibo != nullptr)) {
+                        continue;
+                    }
+                    position = GetNextPosition();
+                    id = g_playlist_ids[position];
+                    generation = g_playlist_generation;
+                }
+
+                auto amiibo = LoadPlaylistEntry(id);
+
+                // If the playlist changed meanwhile, whoever changed it already requested another prefetch
+                EMU_LOCK_SCOPE_WITH(g_playlist_lock);
+                if(generation == g_playlist_generation) {
+                    g_prefetched_amiibo = std::move(amiibo);
+                    g_prefetched_position = position;
+                }
+            }
+        }
+
+        // Expects the playlist lock to be held
+        bool EnsurePrefetchThreadStarted() {
+            if(!g_prefetch_started) {
+                ueventCreate(&g_prefetch_request_event, true);
+                if(R_FAILED(g_prefetch_thread.Initialize(&PrefetchThreadMain, nullptr, g_prefetch_thread_stack, PrefetchThreadStackSize, PrefetchThreadPriority))) {
+                    return false;
+                }
+                if(R_FAILED(g_prefetch_thread.Start())) {
+                    return false;
+                }
+                g_prefetch_started = true;
+            }
+            return true;
+        }
+
+        void RequestPrefetch() {
+            EMU_LOCK_SCOPE_WITH(g_playlist_lock);
+            if(EnsurePrefetchThreadStarted()) {
+                ueventSignal(&g_prefetch_request_event);
+            }
+        }
+
+    }
+
+    bool SetPlaylist(const u64 *ids, u32 count, u32 advance_flags) {
+        if((count == 0) || (count > PlaylistMaxEntryCount)) {
+            return false;
+        }
+
+        // Nothing changes unless the first entry can be activated
+        auto amiibo = LoadPlaylistEntry(ids[0]);
+        if(amiibo == nullptr) {
+            return false;
+        }
+        {
+            EMU_LOCK_SCOPE_WITH(g_playlist_lock);
+            g_playlist_ids.assign(ids, ids + count);
+            g_playlist_position = 0;
+            g_playlist_advance_flags = advance_flags;
+            g_playlist_generation++;
+            g_prefetched_amiibo.reset();
+        }
+        EMU_LOG_FMT("Set playlist with " << count << " entries, advance flags: " << advance_flags)
+
+        RequestPrefetch();
+        SetActiveVirtualAmiibo(std::move(amiibo));
+        return true;
+    }
+
+    void ClearPlaylist() {
+        EMU_LOCK_SCOPE_WITH(g_playlist_lock);
+        g_playlist_ids.clear();
+        g_playlist_position = 0;
+        g_playlist_advance_flags = 0;
+        g_playlist_generation++;
+        g_prefetched_amiibo.reset();
+    }
+
+    PlaylistStatus GetPlaylistStatus() {
+        EMU_LOCK_SCOPE_WITH(g_playlist_lock);
+        PlaylistStatus status = {};
+        status.entry_count = g_playlist_ids.size();
+        status.position = g_playlist_position;
+        status.advance_flags = g_playlist_advance_flags;
+        status.next_entry_ready = g_prefetched_amiibo != nullptr;
+        return status;
+    }
+
+    std::shared_ptr<amiibo::VirtualAmiibo> AdvancePlaylist() {
+        std::shared_ptr<amiibo::VirtualAmiibo> amiibo;
+        u64 id = 0;
+        {
+            EMU_LOCK_SCOPE_WITH(g_playlist_lock);
+            if(g_playlist_ids.empty()) {
+                return nullptr;
+            }
+            const auto position = GetNextPosition();
+            if((g_prefetched_amiibo != nullptr) && (g_prefetched_position == position)) {
+                amiibo = std::move(g_prefetched_amiibo);
+            }
+            id = g_playlist_ids[position];
+            g_playlist_position = position;
+            g_playlist_generation++;
+            g_prefetched_amiibo.reset();
+        }
+
+        // Only when advancing faster than the prefetch thread can load entries
+        if(amiibo == nullptr) {
+            amiibo = LoadPlaylistEntry(id);
+        }
+        RequestPrefetch();
+        return amiibo;
+    }
+
+    bool ShouldAdvancePlaylistOn(PlaylistAdvanceFlag flag) {
+        EMU_LOCK_SCOPE_WITH(g_playlist_lock);
+        return !g_playlist_ids.empty() && (g_playlist_advance_flags & flag);
+    }
+
+    void NotifyPlaylistTagSessionFinished() {
+        if(!ShouldAdvancePlaylistOn(PlaylistAdvanceFlag_TagSession)) {
+            return;
+        }
+        auto amiibo = AdvancePlaylist();
+        if(amiibo != nullptr) {
+            EMU_LOG_FMT("Advancing playlist to virtual amiibo '" << amiibo->GetName() << "'")
+            SetActiveVirtualAmiibo(std::move(amiibo));
+        }
+    }
+
+    bool QueueBackgroundLoad(BackgroundLoadFunction fn) {
+        EMU_LOCK_SCOPE_WITH(g_playlist_lock);
+        if(!EnsurePrefetchThreadStarted()) {
+            return false;
+        }
+        g_pending_background_load = fn;
+        ueventSignal(&g_prefetch_request_event);
+        return true;
+    }
+
+}
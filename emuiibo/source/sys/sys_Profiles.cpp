@@ -0,0 +1,249 @@
+#include <sys/sys_Profiles.hpp>
+#include <sys/sys_Locator.hpp>
+#include <sys/sys_Emulation.hpp>
+#include <sys/sys_Playlist.hpp>
+#include <fs/fs_FileSystem.hpp>
+
+namespace sys {
+
+    namespace {
+
+        // Open addressing (linear probing) over a power of two sized table, at most half full
+        // Program id zero isn't a valid title, so it marks empty slots
+        std::vector<TitleProfile> g_profile_table;
+        std::vector<char> g_profile_paths;
+        std::vector<u64> g_profile_playlist_ids;
+        u32 g_profile_count = 0;
+        Lock g_profiles_lock;
+
+        // Signaled unless a queued profile is waiting to be applied
+        UEvent g_profile_applied_event;
+        bool g_profile_applied_event_created = false;
+        u64 g_queued_profile_program_id = 0;
+
+        inline u32 GetProfileSlot(u64 program_id, size_t table_size) {
+            return static_cast<u32>(HashFnv1a(&program_id, sizeof(program_id)) & (table_size - 1));
+        }
+
+        // Expects the profiles lock to be held
+        const TitleProfile *FindProfile(u64 program_id) {
+            if(g_profile_table.empty()) {
+                return nullptr;
+            }
+            const auto table_size = g_profile_table.size();
+            auto slot = GetProfileSlot(program_id, table_size);
+            while(g_profile_table[slot].program_id != 0) {
+                if(g_profile_table[slot].program_id == program_id) {
+                    return &g_profile_table[slot];
+                }
+                slot = (slot + 1) & (table_size - 1);
+            }
+            return nullptr;
+        }
+
+        void InsertProfile(std::vector<TitleProfile> &table, const TitleProfile &profile) {
+            const auto table_size = table.size();
+            auto slot = GetProfileSlot(profile.program_id, table_size);
+            while((table[slot].program_id != 0) && (table[slot].program_id != profile.program_id)) {
+                slot = (slot + 1) & (table_size - 1);
+            }
+            // A repeated title just keeps the last profile
+            table[slot] = profile;
+        }
+
+        void ApplyQueuedTitleProfile() {
+            u64 program_id = 0;
+            {
+                EMU_LOCK_SCOPE_WITH(g_profiles_lock);
+                program_id = g_queued_profile_program_id;
+            }
+            ApplyTitleProfile(program_id);
+
+            // Another title might have queued its profile meanwhile, which will be applied next
+            EMU_LOCK_SCOPE_WITH(g_profiles_lock);
+            if(program_id == g_queued_profile_program_id) {
+                g_queued_profile_program_id = 0;
+                ueventSignal(&g_profile_applied_event);
+            }
+        }
+
+        bool ParseProgramId(const std::string &str, u64 &out_program_id) {
+            char *str_end = nullptr;
+            out_program_id = strtoull(str.c_str(), &str_end, 16);
+            return (str_end != str.c_str()) && (*str_end == '\0') && (out_program_id != 0);
+        }
+
+        // Same as single virtual amiibos, either an id or a path relative to the amiibo directory
+        bool ParseVirtualAmiiboId(const JSON &value, u64 &out_id) {
+            if(value.is_string()) {
+                out_id = ComputeVirtualAmiiboId(value.get<std::string>().c_str());
+                return true;
+            }
+            if(value.is_number_unsigned()) {
+                out_id = value.get<u64>();
+                return true;
+            }
+            return false;
+        }
+
+    }
+
+    void LoadTitleProfiles() {
+        EMU_FS_SUBSYSTEM_SCOPE(Settings);
+        std::vector<TitleProfile> profiles;
+        std::vector<char> paths;
+        std::vector<u64> playlist_ids;
+        {
+            mem::ScratchScope scratch;
+            auto json = fs::LoadJSONFile(consts::TitleProfilesPath);
+            if(json.is_object()) {
+                for(auto &[key, value]: json.items()) {
+                    TitleProfile profile = {};
+                    if(!ParseProgramId(key, profile.program_id)) {
+                        EMU_LOG_ERR_FMT("Invalid title profile program id: '" << key << "'")
+                        continue;
+                    }
+                    if(value.is_string()) {
+                        const auto relative_path = value.get<std::string>();
+                        profile.virtual_amiibo_id = ComputeVirtualAmiiboId(relative_path.c_str());
+                        profile.path_offset = static_cast<u32>(paths.size());
+                        paths.insert(paths.end(), relative_path.begin(), relative_path.end());
+                        paths.push_back('\0');
+                    }
+                    else if(value.is_number_unsigned()) {
+                        profile.virtual_amiibo_id = value.get<u64>();
+                        profile.path_offset = TitleProfileInvalidPathOffset;
+                    }
+                    else if(value.is_array() && !value.empty() && (value.size() <= PlaylistMaxEntryCount)) {
+                        profile.path_offset = TitleProfileInvalidPathOffset;
+                        profile.playlist_offset = static_cast<u32>(playlist_ids.size());
+                        for(const auto &item: value) {
+                            u64 id = 0;
+                            if(ParseVirtualAmiiboId(item, id)) {
+                                playlist_ids.push_back(id);
+                            }
+                        }
+                        profile.playlist_entry_count = static_cast<u32>(playlist_ids.size()) - profile.playlist_offset;
+                        if(profile.playlist_entry_count == 0) {
+                            EMU_LOG_ERR_FMT("Invalid title profile playlist for program id: '" << key << "'")
+                            continue;
+                        }
+                    }
+                    else {
+                        EMU_LOG_ERR_FMT("Invalid title profile virtual amiibo for program id: '" << key << "'")
+                        continue;
+                    }
+                    profiles.push_back(profile);
+                }
+            }
+        }
+
+        std::vector<TitleProfile> table;
+        if(!profiles.empty()) {
+            size_t table_size = 8;
+            while(table_size < (profiles.size() * 2)) {
+                table_size *= 2;
+            }
+            table.resize(table_size);
+            for(const auto &profile: profiles) {
+                InsertProfile(table, profile);
+            }
+        }
+
+        EMU_LOCK_SCOPE_WITH(g_profiles_lock);
+        g_profile_table = std::move(table);
+        g_profile_paths = std::move(paths);
+        g_profile_playlist_ids = std::move(playlist_ids);
+        g_profile_count = profiles.size();
+        EMU_LOG_FMT("Loaded title profiles: " << g_profile_count)
+    }
+
+    u32 GetTitleProfileCount() {
+        EMU_LOCK_SCOPE_WITH(g_profiles_lock);
+        return g_profile_count;
+    }
+
+    bool ApplyTitleProfile(u64 program_id) {
+        char amiibo_path[FS_MAX_PATH] = {};
+        u64 virtual_amiibo_id = 0;
+        std::vector<u64> playlist_ids;
+        {
+            EMU_LOCK_SCOPE_WITH(g_profiles_lock);
+            const auto profile = FindProfile(program_id);
+            if(profile == nullptr) {
+                return false;
+            }
+            if(profile->playlist_entry_count > 0) {
+                const auto ids = g_profile_playlist_ids.data() + profile->playlist_offset;
+                playlist_ids.assign(ids, ids + profile->playlist_entry_count);
+            }
+            virtual_amiibo_id = profile->virtual_amiibo_id;
+            if(profile->path_offset != TitleProfileInvalidPathOffset) {
+                snprintf(amiibo_path, sizeof(amiibo_path), "%s/%s", consts::AmiiboDir.c_str(), g_profile_paths.data() + profile->path_offset);
+            }
+        }
+
+        // Playlists are always made of ids, so they need the library to be ready
+        if(!playlist_ids.empty()) {
+            const auto applied = SetPlaylist(playlist_ids.data(), playlist_ids.size(), PlaylistAdvanceFlag_TagSession);
+            EMU_LOG_FMT("Applied title profile playlist with " << playlist_ids.size() << " entries for program id 0x" << std::hex << program_id << "? " << std::boolalpha << applied)
+            return applied;
+        }
+
+        if(amiibo_path[0] == '\0') {
+            auto catalog = GetVirtualAmiiboCatalog();
+            if((catalog == nullptr) || !catalog->GetPathById(virtual_amiibo_id, amiibo_path, sizeof(amiibo_path))) {
+                EMU_LOG_ERR_FMT("Unable to find title profile virtual amiibo with id 0x" << std::hex << virtual_amiibo_id)
+                return false;
+            }
+        }
+
+        // The title might have been relaunched, there's nothing to load then
+        auto active_amiibo = GetActiveVirtualAmiibo();
+        if((active_amiibo != nullptr) && active_amiibo->IsValid() && (active_amiibo->GetPath() == amiibo_path)) {
+            active_amiibo->Prewarm();
+            return true;
+        }
+
+        auto amiibo = LoadVirtualAmiibo(amiibo_path);
+        if(amiibo == nullptr) {
+            EMU_LOG_ERR_FMT("Invalid title profile virtual amiibo at '" << amiibo_path << "'")
+            return false;
+        }
+        // Done before it's visible to the title, which can't scan it until it's active anyway
+        amiibo->Prewarm();
+        EMU_LOG_FMT("Activating title profile virtual amiibo '" << amiibo->GetName() << "' for program id 0x" << std::hex << program_id)
+        SetActiveVirtualAmiibo(std::move(amiibo));
+        return true;
+    }
+
+    void QueueTitleProfile(u64 program_id) {
+        {
+            EMU_LOCK_SCOPE_WITH(g_profiles_lock);
+            // Most titles have no profile, don't wake anything up for them
+            if(FindProfile(program_id) == nullptr) {
+                return;
+            }
+            if(!g_profile_applied_event_created) {
+                ueventCreate(&g_profile_applied_event, false);
+                g_profile_applied_event_created = true;
+            }
+            g_queued_profile_program_id = program_id;
+            ueventClear(&g_profile_applied_event);
+        }
+        if(!QueueBackgroundLoad(&ApplyQueuedTitleProfile)) {
+            ApplyQueuedTitleProfile();
+        }
+    }
+
+    void WaitForQueuedTitleProfile(s64 timeout_ns) {
+        {
+            EMU_LOCK_SCOPE_WITH(g_profiles_lock);
+            if(g_queued_profile_program_id == 0) {
+                return;
+            }
+        }
+        waitSingle(waiterForUEvent(&g_profile_applied_event), timeout_ns);
+    }
+
+}
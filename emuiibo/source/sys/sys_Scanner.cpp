@@ -0,0 +1,211 @@
+#include <sys/sys_Scanner.hpp>
+#include <sys/sys_Settings.hpp>
+#include <fs/fs_FileSystem.hpp>
+#include <deque>
+#include <atomic>
+
+namespace sys {
+
+    namespace {
+
+        constexpr size_t ScanThreadStackSize = 0x2000;
+
+        // Each worker has its own deque of directories to list: it takes work from its back, and idle workers steal from the front of the others
+
+        struct ScanWorkerQueue {
+            std::deque<std::string> dirs;
+            ams::os::Mutex lock;
+        };
+
+        struct ScanContext {
+            ScanWorkerQueue queues[MaxAmiiboScanThreadCount];
+            u32 worker_count;
+            // Directories queued or being listed, scanning is done once this reaches zero
+            std::atomic<u32> pending_dir_count;
+            std::atomic<u32> scanned_dir_count;
+
+            std::function<void(const std::string&)> &on_amiibo;
+            std::vector<std::pair<std::string, amiibo::VirtualAmiiboFormat>> *out_legacy_amiibos;
+            ams::os::Mutex result_lock;
+            // Idle workers wait for directories to be queued (or for the scan to finish), the counter tells them whether that happened since they last looked
+            Mutex idle_lock;
+            CondVar idle_condvar;
+            u64 queued_dir_counter;
+
+            ScanContext(u32 worker_count, std::function<void(const std::string&)> &on_amiibo, std::vector<std::pair<std::string, amiibo::VirtualAmiiboFormat>> *out_legacy_amiibos) : worker_count(worker_count), pending_dir_count(0), scanned_dir_count(0), on_amiibo(on_amiibo), out_legacy_amiibos(out_legacy_amiibos), queued_dir_counter(0) {
+                mutexInit(&this->idle_lock);
+                condvarInit(&this->idle_condvar);
+            }
+
+            inline u64 GetQueuedDirectoryCounter() {
+                mutexLock(&this->idle_lock);
+                const auto counter = this->queued_dir_counter;
+                mutexUnlock(&this->idle_lock);
+                return counter;
+            }
+
+            void PushDirectory(u32 worker_idx, std::string &&path) {
+                this->pending_dir_count++;
+                {
+                    auto &queue = this->queues[worker_idx];
+                    std::scoped_lock lk(queue.lock);
+                    queue.dirs.push_back(std::move(path));
+                }
+                mutexLock(&this->idle_lock);
+                this->queued_dir_counter++;
+                condvarWakeOne(&this->idle_condvar);
+                mutexUnlock(&this->idle_lock);
+            }
+
+            void NotifyDirectoryDone() {
+                // Children were queued before this, so the count can't reach zero while there's work left
+                if(this->pending_dir_count.fetch_sub(1) == 1) {
+                    mutexLock(&this->idle_lock);
+                    condvarWakeAll(&this->idle_condvar);
+                    mutexUnlock(&this->idle_lock);
+                }
+            }
+
+            void WaitForDirectories(u64 seen_counter) {
+                mutexLock(&this->idle_lock);
+                while((this->queued_dir_counter == seen_counter) && (this->pending_dir_count > 0)) {
+                    condvarWait(&this->idle_condvar, &this->idle_lock);
+                }
+                mutexUnlock(&this->idle_lock);
+            }
+
+            bool PopDirectory(u32 worker_idx, std::string &out_path) {
+                {
+                    auto &queue = this->queues[worker_idx];
+                    std::scoped_lock lk(queue.lock);
+                    if(!queue.dirs.empty()) {
+                        out_path = std::move(queue.dirs.back());
+                        queue.dirs.pop_back();
+                        return true;
+                    }
+                }
+                for(u32 i = 1; i < this->worker_count; i++) {
+                    auto &queue = this->queues[(worker_idx + i) % this->worker_count];
+                    std::scoped_lock lk(queue.lock);
+                    if(!queue.dirs.empty()) {
+                        out_path = std::move(queue.dirs.front());
+                        queue.dirs.pop_front();
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void ProcessDirectory(u32 worker_idx, const std::string &path) {
+                amiibo::DirectoryScanInfo info = {};
+                if(!amiibo::ScanDirectory(path, info)) {
+                    return;
+                }
+                this->scanned_dir_count++;
+                switch(info.format) {
+                    case amiibo::VirtualAmiiboFormat::Current: {
+                        std::scoped_lock lk(this->result_lock);
+                        this->on_amiibo(path);
+                        break;
+                    }
+                    case amiibo::VirtualAmiiboFormat::V2:
+                    case amiibo::VirtualAmiiboFormat::V3: {
+                        if(this->out_legacy_amiibos != nullptr) {
+                            std::scoped_lock lk(this->result_lock);
+                            this->out_legacy_amiibos->push_back(std::make_pair(path, info.format));
+                        }
+                        break;
+                    }
+                    default: {
+                        if(this->out_legacy_amiibos != nullptr) {
+                            std::scoped_lock lk(this->result_lock);
+                            for(const auto &bin_file: info.bin_files) {
+                                this->out_legacy_amiibos->push_back(std::make_pair(fs::Concat(path, bin_file), amiibo::VirtualAmiiboFormat::Bin));
+                            }
+                        }
+                        for(const auto &child_dir: info.child_dirs) {
+                            this->PushDirectory(worker_idx, fs::Concat(path, child_dir));
+                        }
+                        break;
+                    }
+                }
+            }
+
+            void RunWorker(u32 worker_idx) {
+                std::string path;
+                while(this->pending_dir_count > 0) {
+                    // Read before looking at the queues, so that directories queued meanwhile aren't missed
+                    const auto seen_counter = this->GetQueuedDirectoryCounter();
+                    if(this->PopDirectory(worker_idx, path)) {
+                        this->ProcessDirectory(worker_idx, path);
+                        this->NotifyDirectoryDone();
+                    }
+                    else {
+                        // Other workers are still listing, they might queue more directories
+                        this->WaitForDirectories(seen_counter);
+                    }
+                }
+            }
+
+        };
+
+        struct ScanWorkerArgs {
+            ScanContext *ctx;
+            u32 worker_idx;
+        };
+
+        void ScanWorkerMain(void *args_ptr) {
+            EMU_FS_SUBSYSTEM_SCOPE(Locator);
+            auto args = reinterpret_cast<ScanWorkerArgs*>(args_ptr);
+            args->ctx->RunWorker(args->worker_idx);
+        }
+
+    }
+
+    u32 ScanVirtualAmiibos(const std::string &base_path, u32 thread_count, std::function<void(const std::string&)> on_amiibo, std::vector<std::pair<std::string, amiibo::VirtualAmiiboFormat>> *out_legacy_amiibos) {
+        const auto worker_count = std::clamp<u32>(thread_count, MinAmiiboScanThreadCount, MaxAmiiboScanThreadCount);
+        ScanContext ctx(worker_count, on_amiibo, out_legacy_amiibos);
+
+        amiibo::DirectoryScanInfo base_info = {};
+        if(!amiibo::ScanDirectory(base_path, base_info)) {
+            return 0;
+        }
+        // Spread the top-level directories over the workers from the start
+        for(u32 i = 0; i < base_info.child_dirs.size(); i++) {
+            ctx.PushDirectory(i % worker_count, fs::Concat(base_path, base_info.child_dirs[i]));
+        }
+        if(out_legacy_amiibos != nullptr) {
+            for(const auto &bin_file: base_info.bin_files) {
+                out_legacy_amiibos->push_back(std::make_pair(fs::Concat(base_path, bin_file), amiibo::VirtualAmiiboFormat::Bin));
+            }
+        }
+
+        // The calling thread is worker 0, and the others run at its priority: scans started in the background must not preempt the IPC server
+        // These are plain libnx threads, since one which was created but failed to start has to be closed without waiting for it
+        s32 worker_priority = 0;
+        EMU_R_ASSERT(svcGetThreadPriority(&worker_priority, CUR_THREAD_HANDLE));
+        Thread threads[MaxAmiiboScanThreadCount] = {};
+        ScanWorkerArgs args[MaxAmiiboScanThreadCount];
+        u32 started_count = 1;
+        for(u32 i = 1; i < worker_count; i++) {
+            args[i] = { &ctx, i };
+            if(R_FAILED(threadCreate(&threads[i], &ScanWorkerMain, reinterpret_cast<void*>(&args[i]), nullptr, ScanThreadStackSize, worker_priority, -2))) {
+                break;
+            }
+            if(R_FAILED(threadStart(&threads[i]))) {
+                threadClose(&threads[i]);
+                break;
+            }
+            started_count++;
+        }
+        // If any thread failed to start, its queue is just stolen by the others (the calling thread at least)
+        ctx.RunWorker(0);
+        for(u32 i = 1; i < started_count; i++) {
+            EMU_R_ASSERT(threadWaitForExit(&threads[i]));
+            EMU_R_ASSERT(threadClose(&threads[i]));
+        }
+        // Including the base directory
+        return ctx.scanned_dir_count + 1;
+    }
+
+}
@@ -0,0 +1,154 @@
+#include <sys/sys_Settings.hpp>
+#include <fs/fs_FileSystem.hpp>
+#include <atomic>
+#include <algorithm>
+
+namespace sys {
+
+    static Settings g_settings = DefaultSettings;
+    static Lock g_settings_lock;
+
+    static std::atomic<u32> g_amiibo_scan_interval_ms = DefaultSettings.amiibo_scan_interval_ms;
+    static std::atomic<LogLevel> g_log_level = DefaultSettings.log_level;
+    static std::atomic_bool g_update_cache_on_emu_session = DefaultSettings.update_cache_on_emu_session;
+    static std::atomic_bool g_use_amiibo_metadata_cache = DefaultSettings.use_amiibo_metadata_cache;
+    static std::atomic_bool g_persist_emulation_state = DefaultSettings.persist_emulation_state;
+    static std::atomic<u32> g_emulation_state_flush_delay_ms = DefaultSettings.emulation_state_flush_delay_ms;
+
+    template<typename T>
+    static inline T ReadSetting(JSON &json, const std::string &key, T def) {
+        if(json.count(key)) {
+            auto &item = json[key];
+            if constexpr(std::is_same_v<T, bool>) {
+                if(item.is_boolean()) {
+                    return item.get<bool>();
+                }
+            }
+            else {
+                if(item.is_number_unsigned()) {
+                    // Narrowed only after saturating, so that out of range values get clamped instead of wrapping around
+                    const auto value = std::min(item.get<u64>(), static_cast<u64>(std::numeric_limits<T>::max()));
+                    return static_cast<T>(value);
+                }
+            }
+        }
+        return def;
+    }
+
+    static LogLevel ReadLogLevel(JSON &json) {
+        if(json.count("log_level")) {
+            auto &item = json["log_level"];
+            if(item.is_string()) {
+                const auto name = item.get<std::string>();
+                for(u32 i = 0; i < static_cast<u32>(LogLevel::Count); i++) {
+                    if(name == LogLevelNames[i]) {
+                        return static_cast<LogLevel>(i);
+                    }
+                }
+            }
+        }
+        // Older settings files only had an on/off switch
+        else if(!ReadSetting(json, "log_enabled", true)) {
+            return LogLevel::Off;
+        }
+        return DefaultSettings.log_level;
+    }
+
+    static void ApplySettingsImpl(Settings &settings) {
+        settings.amiibo_scan_interval_ms = std::clamp(settings.amiibo_scan_interval_ms, MinAmiiboScanIntervalMs, MaxAmiiboScanIntervalMs);
+        settings.amiibo_scan_thread_count = std::clamp(settings.amiibo_scan_thread_count, MinAmiiboScanThreadCount, MaxAmiiboScanThreadCount);
+        settings.catalog_cache_page_count = std::clamp(settings.catalog_cache_page_count, MinCatalogCachePageCount, MaxCatalogCachePageCount);
+        settings.emulation_state_flush_delay_ms = std::min(settings.emulation_state_flush_delay_ms, MaxEmulationStateFlushDelayMs);
+        if(settings.log_level >= LogLevel::Count) {
+            settings.log_level = DefaultSettings.log_level;
+        }
+        if(settings.emu_max_sessions == 0) {
+            settings.emu_max_sessions = DefaultSettings.emu_max_sessions;
+        }
+        g_settings = settings;
+        g_amiibo_scan_interval_ms = settings.amiibo_scan_interval_ms;
+        g_log_level = settings.log_level;
+        g_update_cache_on_emu_session = settings.update_cache_on_emu_session;
+        g_use_amiibo_metadata_cache = settings.use_amiibo_metadata_cache;
+        g_persist_emulation_state = settings.persist_emulation_state;
+        g_emulation_state_flush_delay_ms = settings.emulation_state_flush_delay_ms;
+    }
+
+    static void SaveSettingsImpl() {
+        EMU_FS_SUBSYSTEM_SCOPE(Settings);
+        mem::ScratchScope scratch;
+        auto json = JSON::object();
+        json["amiibo_scan_interval_ms"] = g_settings.amiibo_scan_interval_ms;
+        json["emu_max_sessions"] = g_settings.emu_max_sessions;
+        json["log_level"] = LogLevelNames[static_cast<u32>(g_settings.log_level)];
+        json["dump_miis_on_boot"] = g_settings.dump_miis_on_boot;
+        json["convert_legacy_amiibos_on_boot"] = g_settings.convert_legacy_amiibos_on_boot;
+        json["update_cache_on_emu_session"] = g_settings.update_cache_on_emu_session;
+        json["use_amiibo_metadata_cache"] = g_settings.use_amiibo_metadata_cache;
+        json["amiibo_scan_thread_count"] = g_settings.amiibo_scan_thread_count;
+        json["catalog_cache_page_count"] = g_settings.catalog_cache_page_count;
+        json["persist_emulation_state"] = g_settings.persist_emulation_state;
+        json["emulation_state_flush_delay_ms"] = g_settings.emulation_state_flush_delay_ms;
+        fs::SaveJSONFile(consts::SettingsPath, json);
+    }
+
+    void LoadSettings() {
+        EMU_FS_SUBSYSTEM_SCOPE(Settings);
+        EMU_LOCK_SCOPE_WITH(g_settings_lock);
+        Settings settings = DefaultSettings;
+        {
+            mem::ScratchScope scratch;
+            auto json = fs::LoadJSONFile(consts::SettingsPath);
+            settings.amiibo_scan_interval_ms = ReadSetting(json, "amiibo_scan_interval_ms", DefaultSettings.amiibo_scan_interval_ms);
+            settings.emu_max_sessions = ReadSetting(json, "emu_max_sessions", DefaultSettings.emu_max_sessions);
+            settings.log_level = ReadLogLevel(json);
+            settings.dump_miis_on_boot = ReadSetting(json, "dump_miis_on_boot", DefaultSettings.dump_miis_on_boot);
+            settings.convert_legacy_amiibos_on_boot = ReadSetting(json, "convert_legacy_amiibos_on_boot", DefaultSettings.convert_legacy_amiibos_on_boot);
+            settings.update_cache_on_emu_session = ReadSetting(json, "update_cache_on_emu_session", DefaultSettings.update_cache_on_emu_session);
+            settings.use_amiibo_metadata_cache = ReadSetting(json, "use_amiibo_metadata_cache", DefaultSettings.use_amiibo_metadata_cache);
+            settings.amiibo_scan_thread_count = ReadSetting(json, "amiibo_scan_thread_count", DefaultSettings.amiibo_scan_thread_count);
+            settings.catalog_cache_page_count = ReadSetting(json, "catalog_cache_page_count", DefaultSettings.catalog_cache_page_count);
+            settings.persist_emulation_state = ReadSetting(json, "persist_emulation_state", DefaultSettings.persist_emulation_state);
+            settings.emulation_state_flush_delay_ms = ReadSetting(json, "emulation_state_flush_delay_ms", DefaultSettings.emulation_state_flush_delay_ms);
+        }
+        ApplySettingsImpl(settings);
+        // Write it back, so that the file always contains every available setting
+        SaveSettingsImpl();
+    }
+
+    Settings GetSettings() {
+        EMU_LOCK_SCOPE_WITH(g_settings_lock);
+        return g_settings;
+    }
+
+    void SetSettings(Settings settings) {
+        EMU_LOCK_SCOPE_WITH(g_settings_lock);
+        ApplySettingsImpl(settings);
+        SaveSettingsImpl();
+    }
+
+    u32 GetAmiiboScanIntervalMs() {
+        return g_amiibo_scan_interval_ms.load(std::memory_order_relaxed);
+    }
+
+    LogLevel GetLogLevel() {
+        return g_log_level.load(std::memory_order_relaxed);
+    }
+
+    bool ShouldUpdateCacheOnEmuSession() {
+        return g_update_cache_on_emu_session.load(std::memory_order_relaxed);
+    }
+
+    bool ShouldUseAmiiboMetadataCache() {
+        return g_use_amiibo_metadata_cache.load(std::memory_order_relaxed);
+    }
+
+    bool ShouldPersistEmulationState() {
+        return g_persist_emulation_state.load(std::memory_order_relaxed);
+    }
+
+    u32 GetEmulationStateFlushDelayMs() {
+        return g_emulation_state_flush_delay_ms.load(std::memory_order_relaxed);
+    }
+
+}
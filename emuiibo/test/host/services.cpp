@@ -0,0 +1,21 @@
+// Host replacements for what emuiibo gets from libnx's runtime and from system services
+#include <ipc/mii/mii_Service.hpp>
+
+extern "C" {
+
+    // Only used for heap stats
+    static char g_fake_heap[0x1000];
+    char *fake_heap_start = g_fake_heap;
+    char *fake_heap_end = g_fake_heap + sizeof(g_fake_heap);
+
+}
+
+namespace ipc::mii {
+
+    Result BuildRandom(CharInfo *out, Age age, Gender gender, Race race) {
+        *out = {};
+        randomGet(out->create_id, sizeof(out->create_id));
+        return 0;
+    }
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+// Host replacement for the parts of libstratosphere the tested headers use
+#include <switch.h>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <map>
+
+namespace ams {
+
+    class Result {
+
+        private:
+            u32 value;
+
+        public:
+            constexpr Result(u32 value) : value(value) {}
+
+            constexpr u32 GetValue() const {
+                return this->value;
+            }
+
+    };
+
+}
+
+namespace ams::sf {
+
+    struct LargeData {};
+
+}
+
+namespace ams::os {
+
+    using Mutex = std::mutex;
+    using RecursiveMutex = std::recursive_mutex;
+
+}
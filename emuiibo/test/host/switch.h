@@ -0,0 +1,182 @@
+#pragma once
+// Host replacement for the parts of libnx the tested headers use, so that they can be built and run on a PC
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <string>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef u32 Result;
+typedef u32 Handle;
+
+#define FS_MAX_PATH 0x301
+#define PACKED __attribute__((packed))
+#define BIT(n) (1U << (n))
+#define MAKERESULT(module, description) ((((module) & 0x1FF)) | ((description) & 0x1FFF) << 9)
+#define R_SUCCEEDED(res) ((res) == 0)
+#define R_FAILED(res) ((res) != 0)
+
+// Only the fields emuiibo uses are laid out, the rest is kept as padding so that sizes match
+typedef struct {
+    u8 create_id[0x10];
+    u16 mii_name[10 + 1];
+    u8 reserved[0x32];
+} PACKED NfpMiiCharInfo;
+
+typedef struct {
+    u8 uuid[10];
+    u8 uuid_length;
+    u8 reserved1[0x15];
+    u32 protocol;
+    u32 tag_type;
+    u8 reserved2[0x30];
+} PACKED NfpTagInfo;
+
+typedef struct { u8 data[0x40]; } NfpModelInfo;
+typedef struct { u8 data[0x100]; } NfpRegisterInfo;
+
+typedef struct {
+    u16 last_write_year;
+    u8 last_write_month;
+    u8 last_write_day;
+    u16 write_counter;
+    u16 version;
+    u32 application_area_size;
+    u8 reserved[0x34];
+} PACKED NfpCommonInfo;
+
+static inline void randomGet(void *buf, size_t size) {
+    auto bytes = reinterpret_cast<u8*>(buf);
+    for(size_t i = 0; i < size; i++) {
+        bytes[i] = static_cast<u8>(rand());
+    }
+}
+
+// Only ASCII is needed here
+static inline ssize_t utf8_to_utf16(u16 *out, const u8 *in, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        out[i] = in[i];
+    }
+    return len;
+}
+
+// Backed by a POSIX rwlock, like libnx's it allows several readers or a single writer, and waiting writers go first
+typedef struct {
+    pthread_rwlock_t lock;
+} RwLock;
+
+static inline void rwlockInit(RwLock *r) {
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    #ifdef __GLIBC__
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    #endif
+    pthread_rwlock_init(&r->lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+}
+
+static inline void rwlockReadLock(RwLock *r) {
+    pthread_rwlock_rdlock(&r->lock);
+}
+
+static inline void rwlockReadUnlock(RwLock *r) {
+    pthread_rwlock_unlock(&r->lock);
+}
+
+static inline void rwlockWriteLock(RwLock *r) {
+    pthread_rwlock_wrlock(&r->lock);
+}
+
+static inline void rwlockWriteUnlock(RwLock *r) {
+    pthread_rwlock_unlock(&r->lock);
+}
+
+typedef pthread_mutex_t Mutex;
+
+static inline void mutexInit(Mutex *m) {
+    pthread_mutex_init(m, nullptr);
+}
+
+static inline void mutexLock(Mutex *m) {
+    pthread_mutex_lock(m);
+}
+
+static inline void mutexUnlock(Mutex *m) {
+    pthread_mutex_unlock(m);
+}
+
+typedef pthread_cond_t CondVar;
+
+static inline void condvarInit(CondVar *c) {
+    pthread_cond_init(c, nullptr);
+}
+
+static inline Result condvarWait(CondVar *c, Mutex *m) {
+    return pthread_cond_wait(c, m);
+}
+
+static inline Result condvarWakeOne(CondVar *c) {
+    return pthread_cond_signal(c);
+}
+
+static inline Result condvarWakeAll(CondVar *c) {
+    return pthread_cond_broadcast(c);
+}
+
+// Threads are POSIX ones, the stack size and priority are just ignored
+#define CUR_THREAD_HANDLE 0xFFFF8000
+
+typedef void (*ThreadFunc)(void*);
+
+typedef struct {
+    pthread_t pthread;
+    ThreadFunc entry;
+    void *arg;
+} Thread;
+
+static inline Result svcGetThreadPriority(s32 *out_priority, Handle) {
+    *out_priority = 0x2C;
+    return 0;
+}
+
+static inline Result threadCreate(Thread *t, ThreadFunc entry, void *arg, void *, size_t, int, int) {
+    t->entry = entry;
+    t->arg = arg;
+    return 0;
+}
+
+static inline Result threadStart(Thread *t) {
+    return pthread_create(&t->pthread, nullptr, [](void *t_ptr) -> void* {
+        auto t = reinterpret_cast<Thread*>(t_ptr);
+        t->entry(t->arg);
+        return nullptr;
+    }, t);
+}
+
+static inline Result threadWaitForExit(Thread *t) {
+    return pthread_join(t->pthread, nullptr);
+}
+
+static inline Result threadClose(Thread *) {
+    return 0;
+}
+
+static inline void fatalThrow(Result rc) {
+    fprintf(stderr, "Fatal error: 0x%X\n", rc);
+    abort();
+}
+
+static inline int fsdevDeleteDirectoryRecursively(const char *path) {
+    const auto cmd = std::string("rm -rf '") + path + "'";
+    return system(cmd.c_str());
+}
@@ -0,0 +1,402 @@
+// Host test of the paged catalog: builds it for a big library (in a shuffled order, like a parallel scan would add entries),
+// and checks lookups, paths and folder listings against what was added, while only a few pages are kept in memory
+// Queries are checked (and timed) against a library of actual virtual amiibos, since the indices are built from their metadata
+#include "test_Utils.hpp"
+#include <sys/sys_Catalog.hpp>
+#include <amiibo/amiibo_Formats.hpp>
+#include <strings.h>
+#include <tuple>
+
+namespace {
+
+    constexpr u32 SeriesCount = 100;
+    constexpr u32 FiguresPerSeries = 10;
+    constexpr u32 AmiibosPerFigure = 100;
+    constexpr u32 LargeLibraryCount = SeriesCount * FiguresPerSeries * AmiibosPerFigure;
+    constexpr u32 LongNameCount = 3;
+    constexpr u32 DeepPathDepth = 48;
+    constexpr u32 CachePageCount = 4;
+    constexpr u32 IndexedLibraryCount = 10000;
+    constexpr u32 QueryPageSize = 0x20;
+
+    std::string GetCatalogPath(const char *name) {
+        return consts::CatalogDir + "/" + name + ".bin";
+    }
+
+    std::string MakeLargeLibraryPath(u32 idx) {
+        char path[FS_MAX_PATH] = {};
+        const auto series = idx / (FiguresPerSeries * AmiibosPerFigure);
+        const auto figure = (idx / AmiibosPerFigure) % FiguresPerSeries;
+        snprintf(path, sizeof(path), "series_%03u/figure_%02u/amiibo_%06u", series, figure, idx);
+        return path;
+    }
+
+    // Not valid path components for the catalog's fixed-size names, so they end up in the name pool
+    std::string MakeLongName(u32 idx) {
+        return "long_" + std::string(0x90, static_cast<char>('a' + idx)) + "_" + std::to_string(idx);
+    }
+
+    std::string MakeDeepPath() {
+        std::string path;
+        for(u32 i = 0; i < DeepPathDepth; i++) {
+            path += "level_" + std::to_string(i) + "/";
+        }
+        return path + "deep_amiibo";
+    }
+
+    std::vector<std::string> MakeLargeLibrary() {
+        std::vector<std::string> paths;
+        paths.reserve(LargeLibraryCount + LongNameCount + 1);
+        for(u32 i = 0; i < LargeLibraryCount; i++) {
+            paths.push_back(MakeLargeLibraryPath(i));
+        }
+        for(u32 i = 0; i < LongNameCount; i++) {
+            paths.push_back("long_names/" + MakeLongName(i));
+        }
+        paths.push_back(MakeDeepPath());
+        // Deterministic shuffle, so that entries don't come in their final order
+        u64 state = 0x1234;
+        for(size_t i = paths.size() - 1; i > 0; i--) {
+            state = state * 6364136223846793005ul + 1442695040888963407ul;
+            std::swap(paths[i], paths[(state >> 33) % (i + 1)]);
+        }
+        return paths;
+    }
+
+    bool BuildCatalog(const std::vector<std::string> &paths, const std::string &catalog_path, sys::Catalog *base = nullptr) {
+        sys::CatalogBuilder builder;
+        for(const auto &path: paths) {
+            if(!builder.Add(path.c_str())) {
+                return false;
+            }
+        }
+        return builder.Finalize(catalog_path, base);
+    }
+
+    void CheckPaths(sys::Catalog &catalog, const std::vector<std::string> &paths) {
+        u32 mismatch_count = 0;
+        char path[FS_MAX_PATH] = {};
+        for(const auto &relative_path: paths) {
+            if(!catalog.GetPathById(sys::ComputeVirtualAmiiboId(relative_path.c_str()), path, sizeof(path)) || (fs::Concat(consts::AmiiboDir, relative_path) != path)) {
+                if(mismatch_count < 5) {
+                    fprintf(stderr, "Lookup mismatch for '%s'\n", relative_path.c_str());
+                }
+                mismatch_count++;
+            }
+        }
+        TEST_CHECK(mismatch_count == 0);
+    }
+
+    void CheckOrder(sys::Catalog &catalog) {
+        // Entries are grouped by directory, and sorted by (full) name inside it
+        u32 unsorted_count = 0;
+        u32 prev_dir_idx = sys::CatalogInvalidDirectoryIndex;
+        std::string prev_path;
+        char path[FS_MAX_PATH] = {};
+        const auto listed_count = catalog.ListEntries(0, catalog.GetCount(), [&](const sys::CatalogEntry &entry) {
+            if(!catalog.GetEntryPath(entry, path, sizeof(path))) {
+                unsorted_count++;
+                return;
+            }
+            if((entry.dir_idx < prev_dir_idx) && (prev_dir_idx != sys::CatalogInvalidDirectoryIndex)) {
+                unsorted_count++;
+            }
+            else if((entry.dir_idx == prev_dir_idx) && (prev_path >= path)) {
+                unsorted_count++;
+            }
+            prev_dir_idx = entry.dir_idx;
+            prev_path = path;
+        });
+        TEST_CHECK(listed_count == catalog.GetCount());
+        TEST_CHECK(unsorted_count == 0);
+    }
+
+    // Finds a folder by walking the listing from the root, like a client would
+    bool FindFolderId(sys::Catalog &catalog, const std::vector<std::string> &components, u64 &out_folder_id) {
+        auto folder_id = sys::CatalogRootFolderId;
+        for(const auto &component: components) {
+            sys::VirtualAmiiboFolderItem items[0x20];
+            u32 offset = 0;
+            auto found = false;
+            while(!found) {
+                u32 count = 0;
+                u32 total_count = 0;
+                if(!catalog.ListFolder(folder_id, offset, items, 0x20, count, total_count) || (count == 0)) {
+                    return false;
+                }
+                for(u32 i = 0; i < count; i++) {
+                    if((items[i].type == sys::VirtualAmiiboFolderItemType_Folder) && (component == items[i].name)) {
+                        folder_id = items[i].id;
+                        found = true;
+                        break;
+                    }
+                }
+                offset += count;
+            }
+        }
+        out_folder_id = folder_id;
+        return true;
+    }
+
+    void CheckFolders(sys::Catalog &catalog) {
+        sys::VirtualAmiiboFolderItem items[0x20];
+        u32 count = 0;
+        u32 total_count = 0;
+        // The root has every series folder, plus the long names and deep path folders
+        TEST_CHECK(catalog.ListFolder(sys::CatalogRootFolderId, 0, items, 0x20, count, total_count));
+        TEST_CHECK(total_count == (SeriesCount + 2));
+        TEST_CHECK((count == 0x20) && (strcmp(items[0].name, "level_0") == 0) && (strcmp(items[1].name, "long_names") == 0) && (strcmp(items[2].name, "series_000") == 0));
+
+        u64 folder_id = 0;
+        TEST_CHECK(FindFolderId(catalog, { "series_042", "figure_07" }, folder_id));
+        u32 listed_count = 0;
+        u32 mismatch_count = 0;
+        while(catalog.ListFolder(folder_id, listed_count, items, 0x20, count, total_count) && (count > 0)) {
+            for(u32 i = 0; i < count; i++) {
+                const auto expected_path = MakeLargeLibraryPath(42 * FiguresPerSeries * AmiibosPerFigure + 7 * AmiibosPerFigure + listed_count + i);
+                if((items[i].type != sys::VirtualAmiiboFolderItemType_VirtualAmiibo) || (items[i].id != sys::ComputeVirtualAmiiboId(expected_path.c_str())) || (expected_path.compare(expected_path.rfind('/') + 1, std::string::npos, items[i].name) != 0)) {
+                    mismatch_count++;
+                }
+            }
+            listed_count += count;
+        }
+        TEST_CHECK(total_count == AmiibosPerFigure);
+        TEST_CHECK(listed_count == AmiibosPerFigure);
+        TEST_CHECK(mismatch_count == 0);
+
+        // Names which don't fit in folder items are truncated there, ids still refer to the full ones
+        TEST_CHECK(FindFolderId(catalog, { "long_names" }, folder_id));
+        TEST_CHECK(catalog.ListFolder(folder_id, 0, items, 0x20, count, total_count));
+        TEST_CHECK((count == LongNameCount) && (total_count == LongNameCount));
+        for(u32 i = 0; i < count; i++) {
+            const auto name = MakeLongName(i);
+            TEST_CHECK(items[i].id == sys::ComputeVirtualAmiiboId(("long_names/" + name).c_str()));
+            TEST_CHECK(name.compare(0, sizeof(items[i].name) - 1, items[i].name) == 0);
+        }
+
+        std::vector<std::string> deep_components;
+        for(u32 i = 0; i < DeepPathDepth; i++) {
+            deep_components.push_back("level_" + std::to_string(i));
+        }
+        TEST_CHECK(FindFolderId(catalog, deep_components, folder_id));
+        TEST_CHECK(catalog.ListFolder(folder_id, 0, items, 0x20, count, total_count));
+        TEST_CHECK((count == 1) && (strcmp(items[0].name, "deep_amiibo") == 0));
+    }
+
+    void TestLargeLibrary() {
+        const auto paths = MakeLargeLibrary();
+        const auto catalog_path = GetCatalogPath("large");
+
+        test::Timer build_timer;
+        TEST_CHECK(BuildCatalog(paths, catalog_path));
+        const auto build_us = build_timer.GetElapsedUs();
+        const auto catalog_size = fs::GetFileSize(catalog_path);
+
+        sys::Catalog catalog(catalog_path, CachePageCount);
+        TEST_CHECK(catalog.IsValid());
+        TEST_CHECK(catalog.GetCount() == paths.size());
+
+        test::Timer lookup_timer;
+        CheckPaths(catalog, paths);
+        const auto lookup_us = lookup_timer.GetElapsedUs();
+        CheckOrder(catalog);
+        CheckFolders(catalog);
+
+        printf("%zu entries: built in %.0f ms, %zu KiB catalog (%u KiB of cached pages), %.2f us per id lookup\n", paths.size(), build_us / 1000.0, catalog_size / 1024, static_cast<u32>((CachePageCount * sys::CatalogPageSize) / 1024), lookup_us / paths.size());
+    }
+
+    void TestSharedPageCache() {
+        // Sessions might pin different generations, which share the same pages
+        const std::vector<std::string> old_paths = { "a/one", "a/two", "b/three" };
+        const std::vector<std::string> new_paths = { "a/one", "a/two", "b/three", "b/four" };
+        TEST_CHECK(BuildCatalog(old_paths, GetCatalogPath("old")));
+        TEST_CHECK(BuildCatalog(new_paths, GetCatalogPath("new")));
+        auto old_catalog = std::make_unique<sys::Catalog>(GetCatalogPath("old"), 1);
+        sys::Catalog new_catalog(GetCatalogPath("new"), 1);
+        TEST_CHECK(old_catalog->IsValid() && new_catalog.IsValid());
+        for(u32 i = 0; i < 4; i++) {
+            CheckPaths(*old_catalog, old_paths);
+            CheckPaths(new_catalog, new_paths);
+        }
+        u32 idx = 0;
+        TEST_CHECK(!old_catalog->FindEntry(sys::ComputeVirtualAmiiboId("b/four"), idx));
+        old_catalog.reset();
+        TEST_CHECK(!fs::IsFile(GetCatalogPath("old")));
+        CheckPaths(new_catalog, new_paths);
+    }
+
+    struct IndexedAmiibo {
+        std::string relative_path;
+        std::string name;
+        u8 series;
+        u16 game_character_id;
+        u8 figure_type;
+        u64 id;
+    };
+
+    IndexedAmiibo MakeIndexedAmiibo(u32 idx) {
+        IndexedAmiibo amiibo = {};
+        amiibo.relative_path = "indexed/amiibo_" + std::to_string(idx);
+        // Mixed case, so that names only sort right if compared case-insensitively
+        amiibo.name = std::string(1, static_cast<char>(((idx % 2) ? 'A' : 'a') + (idx * 7) % 26)) + "miibo " + std::to_string(idx);
+        amiibo.series = idx % 50;
+        amiibo.game_character_id = idx % 300;
+        amiibo.figure_type = idx % 3;
+        amiibo.id = sys::ComputeVirtualAmiiboId(amiibo.relative_path.c_str());
+        return amiibo;
+    }
+
+    void CreateIndexedAmiibo(const IndexedAmiibo &amiibo) {
+        const auto path = fs::Concat(consts::AmiiboDir, amiibo.relative_path);
+        fs::CreateDirectory(path);
+        fs::CreateEmptyFile(fs::Concat(path, "amiibo.flag"));
+        char json[0x200] = {};
+        snprintf(json, sizeof(json), R"({ "name": "%s", "id": { "game_character_id": %u, "character_variant": 0, "series": %u, "model_number": 0, "figure_type": %u }, "mii_charinfo_file": "mii-charinfo.bin" })", amiibo.name.c_str(), amiibo.game_character_id, amiibo.series, amiibo.figure_type);
+        test::WriteTextFile(fs::Concat(path, "amiibo.json"), json);
+    }
+
+    struct QueryTiming {
+        u32 call_count;
+        double total_us;
+        double max_us;
+    };
+
+    // Fetches every page of results, like a client would
+    std::vector<u64> RunQuery(sys::Catalog &catalog, sys::VirtualAmiiboQuery query, QueryTiming &timing) {
+        std::vector<u64> ids;
+        u64 page_ids[QueryPageSize];
+        query.cursor = 0;
+        while(query.cursor != sys::VirtualAmiiboQueryEndCursor) {
+            test::Timer timer;
+            u32 next_cursor = 0;
+            const auto count = catalog.Query(query, page_ids, QueryPageSize, next_cursor);
+            const auto elapsed_us = timer.GetElapsedUs();
+            timing.call_count++;
+            timing.total_us += elapsed_us;
+            timing.max_us = std::max(timing.max_us, elapsed_us);
+            ids.insert(ids.end(), page_ids, page_ids + count);
+            query.cursor = next_cursor;
+        }
+        return ids;
+    }
+
+    bool MatchesExpected(const sys::VirtualAmiiboQuery &query, const IndexedAmiibo &amiibo) {
+        const auto prefix_len = strlen(query.name_prefix);
+        if(strncasecmp(amiibo.name.c_str(), query.name_prefix, prefix_len) != 0) {
+            return false;
+        }
+        if((query.flags & sys::VirtualAmiiboQueryFlag_Series) && (amiibo.series != query.series)) {
+            return false;
+        }
+        if((query.flags & sys::VirtualAmiiboQueryFlag_GameCharacterId) && (amiibo.game_character_id != query.game_character_id)) {
+            return false;
+        }
+        if((query.flags & sys::VirtualAmiiboQueryFlag_FigureType) && (amiibo.figure_type != query.figure_type)) {
+            return false;
+        }
+        return true;
+    }
+
+    // Sorted the same way as the index the catalog picks for the query
+    std::vector<u64> GetExpectedIds(const std::vector<IndexedAmiibo> &amiibos, const sys::VirtualAmiiboQuery &query) {
+        std::vector<const IndexedAmiibo*> matches;
+        for(const auto &amiibo: amiibos) {
+            if(MatchesExpected(query, amiibo)) {
+                matches.push_back(&amiibo);
+            }
+        }
+        const auto by_amiibo_id = (strlen(query.name_prefix) == 0) && (query.flags & sys::VirtualAmiiboQueryFlag_Series);
+        std::sort(matches.begin(), matches.end(), [&](const IndexedAmiibo *a, const IndexedAmiibo *b) {
+            if(by_amiibo_id) {
+                return std::make_tuple(a->series, a->game_character_id, a->figure_type, a->id) < std::make_tuple(b->series, b->game_character_id, b->figure_type, b->id);
+            }
+            const auto name_cmp = strcasecmp(a->name.c_str(), b->name.c_str());
+            return (name_cmp != 0) ? (name_cmp < 0) : (a->id < b->id);
+        });
+        std::vector<u64> ids;
+        for(auto match: matches) {
+            ids.push_back(match->id);
+        }
+        return ids;
+    }
+
+    sys::VirtualAmiiboQuery MakeQuery(const char *name_prefix, u32 flags, u8 series = 0, u16 game_character_id = 0, u8 figure_type = 0) {
+        sys::VirtualAmiiboQuery query = {};
+        strncpy(query.name_prefix, name_prefix, sizeof(query.name_prefix) - 1);
+        query.flags = flags;
+        query.series = series;
+        query.game_character_id = game_character_id;
+        query.figure_type = figure_type;
+        return query;
+    }
+
+    void TestQueries() {
+        std::vector<IndexedAmiibo> amiibos;
+        std::vector<std::string> paths;
+        fs::CreateDirectory(fs::Concat(consts::AmiiboDir, "indexed"));
+        for(u32 i = 0; i < IndexedLibraryCount; i++) {
+            amiibos.push_back(MakeIndexedAmiibo(i));
+            CreateIndexedAmiibo(amiibos.back());
+            paths.push_back(amiibos.back().relative_path);
+        }
+        const auto catalog_path = GetCatalogPath("indexed");
+        TEST_CHECK(BuildCatalog(paths, catalog_path));
+        // Indexing only reads the virtual amiibos' metadata
+        TEST_CHECK(!fs::IsFile(fs::Concat(consts::AmiiboDir, amiibos[0].relative_path, "amiibo.cache")));
+        TEST_CHECK(!fs::IsDirectory(fs::Concat(consts::AmiiboDir, amiibos[0].relative_path, "areas")));
+        auto catalog = std::make_unique<sys::Catalog>(catalog_path, CachePageCount);
+        TEST_CHECK(catalog->IsValid());
+
+        const std::pair<const char*, sys::VirtualAmiiboQuery> queries[] = {
+            { "everything", MakeQuery("", 0) },
+            { "name prefix", MakeQuery("m", 0) },
+            { "long name prefix", MakeQuery("Pmiibo 12", 0) },
+            { "name prefix and figure type", MakeQuery("B", sys::VirtualAmiiboQueryFlag_FigureType, 0, 0, 1) },
+            { "series", MakeQuery("", sys::VirtualAmiiboQueryFlag_Series, 7) },
+            { "series and character", MakeQuery("", sys::VirtualAmiiboQueryFlag_Series | sys::VirtualAmiiboQueryFlag_GameCharacterId, 7, 157) },
+            { "series and figure type", MakeQuery("", sys::VirtualAmiiboQueryFlag_Series | sys::VirtualAmiiboQueryFlag_FigureType, 12, 0, 2) },
+            // Only the name index helps here, most of the library is scanned
+            { "character", MakeQuery("", sys::VirtualAmiiboQueryFlag_GameCharacterId, 0, 42) },
+            { "nothing matches", MakeQuery("zzz", 0) },
+        };
+        printf("%u indexed entries, %u results per page:\n", IndexedLibraryCount, QueryPageSize);
+        for(const auto &[name, query]: queries) {
+            QueryTiming timing = {};
+            const auto ids = RunQuery(*catalog, query, timing);
+            const auto expected_ids = GetExpectedIds(amiibos, query);
+            if(ids != expected_ids) {
+                fprintf(stderr, "Query '%s' returned %zu ids, %zu expected\n", name, ids.size(), expected_ids.size());
+            }
+            TEST_CHECK(ids == expected_ids);
+            printf("  %-28s %5zu results, %3u calls, %7.2f us per call (%7.2f us max)\n", name, ids.size(), timing.call_count, timing.total_us / timing.call_count, timing.max_us);
+        }
+
+        // Adding one virtual amiibo reuses the other ones' index records, so they aren't read again (here they couldn't be)
+        for(u32 i = 0; i < IndexedLibraryCount; i++) {
+            fs::DeleteFile(fs::Concat(consts::AmiiboDir, amiibos[i].relative_path, "amiibo.json"));
+        }
+        amiibos.push_back(MakeIndexedAmiibo(IndexedLibraryCount));
+        CreateIndexedAmiibo(amiibos.back());
+        paths.push_back(amiibos.back().relative_path);
+        const auto added_catalog_path = GetCatalogPath("indexed_added");
+        TEST_CHECK(BuildCatalog(paths, added_catalog_path, catalog.get()));
+        catalog = std::make_unique<sys::Catalog>(added_catalog_path, CachePageCount);
+        TEST_CHECK(catalog->IsValid() && (catalog->GetCount() == amiibos.size()));
+        for(const auto &query: { MakeQuery("", 0), MakeQuery("", sys::VirtualAmiiboQueryFlag_Series, amiibos.back().series) }) {
+            QueryTiming timing = {};
+            TEST_CHECK(RunQuery(*catalog, query, timing) == GetExpectedIds(amiibos, query));
+        }
+    }
+
+}
+
+int main(int argc, char **argv) {
+    if(!test::PrepareSdCard((argc > 1) ? argv[1] : "/tmp/emuiibo_test_catalog")) {
+        return 1;
+    }
+    fs::CreateDirectory(consts::CatalogDir);
+    TestLargeLibrary();
+    TestSharedPageCache();
+    TestQueries();
+    return test::Finish();
+}
@@ -0,0 +1,351 @@
+// Host test of the single-listing directory classification: checks every format is told apart from a directory's entry names,
+// and counts the SD operations per directory of a boot scan against the per-format probes (IsValidVirtualAmiibo<V>) it replaced
+// The parallel scan is then checked and timed against the recursive single-threaded one it replaced, on wide and deep trees
+#include "test_Utils.hpp"
+#include <amiibo/amiibo_Formats.hpp>
+#include <sys/sys_Scanner.hpp>
+#include <algorithm>
+
+namespace {
+
+    constexpr u32 FolderCount = 50;
+    constexpr u32 AmiibosPerFolder = 20;
+    constexpr u32 LegacyCount = 5;
+    constexpr u32 RoundCount = 5;
+    constexpr u32 WideFolderCount = 200;
+    constexpr u32 WideAmiibosPerFolder = 25;
+    constexpr u32 DeepBranchCount = 8;
+    constexpr u32 DeepBranchDepth = 100;
+
+    struct WalkResult {
+        std::vector<std::string> amiibos;
+        u32 bin_count;
+        u32 v2_count;
+        u32 v3_count;
+    };
+
+    void CreateFiles(const std::string &path, std::initializer_list<const char*> files) {
+        fs::CreateDirectory(path);
+        for(const auto file: files) {
+            if(file != nullptr) {
+                fs::CreateEmptyFile(fs::Concat(path, file));
+            }
+        }
+    }
+
+    // Like a loaded virtual amiibo, with its cache, mii and areas directory
+    void CreateCurrentAmiibo(const std::string &path) {
+        CreateFiles(path, { "amiibo.flag", "amiibo.json", "amiibo.cache", "mii-charinfo.bin" });
+        fs::CreateDirectory(fs::Concat(path, "areas"));
+    }
+
+    void CreateV2Amiibo(const std::string &path) {
+        CreateFiles(path, { "amiibo.json", "amiibo.bin", "mii.dat" });
+    }
+
+    void CreateV3Amiibo(const std::string &path) {
+        CreateFiles(path, { "tag.json", "common.json", "model.json", "register.json" });
+    }
+
+    void CreateLibrary() {
+        for(u32 i = 0; i < FolderCount; i++) {
+            const auto folder = fs::Concat(consts::AmiiboDir, "folder_" + std::to_string(i));
+            fs::CreateDirectory(folder);
+            for(u32 j = 0; j < AmiibosPerFolder; j++) {
+                CreateCurrentAmiibo(fs::Concat(folder, "amiibo_" + std::to_string(j)));
+            }
+        }
+        const auto legacy_dir = fs::Concat(consts::AmiiboDir, "legacy");
+        fs::CreateDirectory(legacy_dir);
+        for(u32 i = 0; i < LegacyCount; i++) {
+            CreateV2Amiibo(fs::Concat(legacy_dir, "v2_" + std::to_string(i)));
+            CreateV3Amiibo(fs::Concat(legacy_dir, "v3_" + std::to_string(i)));
+            fs::CreateEmptyFile(fs::Concat(legacy_dir, "raw_" + std::to_string(i) + ".bin"));
+        }
+    }
+
+    void TestClassification() {
+        const auto base_dir = fs::Concat(consts::AmiiboDir, "classify");
+        fs::CreateDirectory(base_dir);
+        const struct {
+            const char *files[4];
+            amiibo::VirtualAmiiboFormat format;
+        } cases[] = {
+            { { "amiibo.flag", "amiibo.json", "mii-charinfo.bin" }, amiibo::VirtualAmiiboFormat::Current },
+            // Current amiibos converted from V2 ones keep their old files, they must not be converted again
+            { { "amiibo.flag", "amiibo.json", "amiibo.bin", "mii.dat" }, amiibo::VirtualAmiiboFormat::Current },
+            { { "amiibo.json", "amiibo.bin", "mii.dat" }, amiibo::VirtualAmiiboFormat::V2 },
+            { { "tag.json", "common.json", "model.json", "register.json" }, amiibo::VirtualAmiiboFormat::V3 },
+            // Disabled (no amiibo.flag) or incomplete ones
+            { { "amiibo.json", "mii-charinfo.bin" }, amiibo::VirtualAmiiboFormat::Invalid },
+            { { "tag.json", "common.json", "model.json" }, amiibo::VirtualAmiiboFormat::Invalid },
+            { { "amiibo.json", "amiibo.bin" }, amiibo::VirtualAmiiboFormat::Invalid },
+        };
+        u32 case_idx = 0;
+        for(const auto &[files, format]: cases) {
+            const auto path = fs::Concat(base_dir, "case_" + std::to_string(case_idx));
+            CreateFiles(path, { files[0], files[1], files[2], files[3] });
+            amiibo::DirectoryScanInfo info = {};
+            TEST_CHECK(amiibo::ScanDirectory(path, info));
+            if(info.format != format) {
+                fprintf(stderr, "Unexpected format for case %u\n", case_idx);
+            }
+            TEST_CHECK(info.format == format);
+            case_idx++;
+        }
+
+        // Other directories report their subdirectories and raw bin files (and nothing from the virtual amiibos inside them)
+        const auto folder = fs::Concat(base_dir, "folder");
+        CreateFiles(folder, { "raw.bin", "notes.txt" });
+        CreateCurrentAmiibo(fs::Concat(folder, "amiibo"));
+        fs::CreateDirectory(fs::Concat(folder, "empty"));
+        amiibo::DirectoryScanInfo info = {};
+        TEST_CHECK(amiibo::ScanDirectory(folder, info));
+        TEST_CHECK(info.format == amiibo::VirtualAmiiboFormat::Invalid);
+        std::sort(info.child_dirs.begin(), info.child_dirs.end());
+        TEST_CHECK(info.child_dirs == std::vector<std::string>({ "amiibo", "empty" }));
+        TEST_CHECK(info.bin_files == std::vector<std::string>({ "raw.bin" }));
+        TEST_CHECK(!amiibo::ScanDirectory(fs::Concat(base_dir, "missing"), info));
+        fs::DeleteDirectory(base_dir);
+    }
+
+    // What a boot used to do: the legacy conversion pass probed every entry for each old format, and then the locator probed it for the current one
+
+    void ListEntryPaths(const std::string &base_path, std::vector<std::string> &out_paths) {
+        out_paths.clear();
+        fs::ListDirectory(base_path, [&](const char *name, bool) {
+            out_paths.push_back(fs::Concat(base_path, name));
+        });
+    }
+
+    void ProbeLegacyAmiibos(const std::string &base_path, WalkResult &out_result) {
+        std::vector<std::string> paths;
+        ListEntryPaths(base_path, paths);
+        for(const auto &path: paths) {
+            if(amiibo::VirtualAmiibo::IsValidVirtualAmiibo<amiibo::VirtualBinAmiibo>(path)) {
+                out_result.bin_count++;
+            }
+            else if(amiibo::VirtualAmiibo::IsValidVirtualAmiibo<amiibo::VirtualAmiiboV2>(path)) {
+                out_result.v2_count++;
+            }
+            else if(amiibo::VirtualAmiibo::IsValidVirtualAmiibo<amiibo::VirtualAmiiboV3>(path)) {
+                out_result.v3_count++;
+            }
+            else if(fs::IsDirectory(path)) {
+                ProbeLegacyAmiibos(path, out_result);
+            }
+        }
+    }
+
+    void ProbeVirtualAmiibos(const std::string &base_path, WalkResult &out_result) {
+        std::vector<std::string> paths;
+        ListEntryPaths(base_path, paths);
+        for(const auto &path: paths) {
+            if(amiibo::VirtualAmiibo::IsValidVirtualAmiibo<amiibo::VirtualAmiibo>(path)) {
+                out_result.amiibos.push_back(path);
+            }
+            else if(fs::IsDirectory(path)) {
+                ProbeVirtualAmiibos(path, out_result);
+            }
+        }
+    }
+
+    void ProbeWalk(WalkResult &out_result) {
+        ProbeLegacyAmiibos(consts::AmiiboDir, out_result);
+        ProbeVirtualAmiibos(consts::AmiiboDir, out_result);
+    }
+
+    // What the locator does now: every directory is listed once, which both classifies it and tells which subdirectories to scan
+
+    void ScanWalkImpl(const std::string &base_path, const amiibo::DirectoryScanInfo &info, WalkResult &out_result, u32 &dir_count) {
+        out_result.bin_count += info.bin_files.size();
+        for(const auto &child_dir: info.child_dirs) {
+            const auto path = fs::Concat(base_path, child_dir);
+            amiibo::DirectoryScanInfo child_info = {};
+            if(!amiibo::ScanDirectory(path, child_info)) {
+                continue;
+            }
+            dir_count++;
+            switch(child_info.format) {
+                case amiibo::VirtualAmiiboFormat::Current:
+                    out_result.amiibos.push_back(path);
+                    break;
+                case amiibo::VirtualAmiiboFormat::V2:
+                    out_result.v2_count++;
+                    break;
+                case amiibo::VirtualAmiiboFormat::V3:
+                    out_result.v3_count++;
+                    break;
+                default:
+                    ScanWalkImpl(path, child_info, out_result, dir_count);
+                    break;
+            }
+        }
+    }
+
+    u32 ScanWalk(WalkResult &out_result) {
+        amiibo::DirectoryScanInfo info = {};
+        u32 dir_count = 0;
+        if(amiibo::ScanDirectory(consts::AmiiboDir, info)) {
+            dir_count++;
+            ScanWalkImpl(consts::AmiiboDir, info, out_result, dir_count);
+        }
+        return dir_count;
+    }
+
+    template<typename F>
+    fs::IoStats MeasureWalk(const char *name, F walk_fn, u32 dir_count, WalkResult &out_result) {
+        fs::ResetIoStats();
+        walk_fn(out_result);
+        const auto stats = test::GetTotalIoStats();
+        test::Timer timer;
+        for(u32 i = 0; i < RoundCount; i++) {
+            WalkResult result = {};
+            walk_fn(result);
+        }
+        const auto elapsed_us = timer.GetElapsedUs() / RoundCount;
+
+        const auto per_dir = [&](u32 count) {
+            return static_cast<double>(count) / dir_count;
+        };
+        const auto total_count = stats.stat_count + stats.dir_open_count + stats.dir_entry_count;
+        printf("  %s: %.2f stat + %.2f opendir + %.2f readdir = %.2f ops/dir, %.0f us per scan\n", name, per_dir(stats.stat_count), per_dir(stats.dir_open_count), per_dir(stats.dir_entry_count), per_dir(total_count), elapsed_us);
+        std::sort(out_result.amiibos.begin(), out_result.amiibos.end());
+        return stats;
+    }
+
+    void BenchmarkBootScan() {
+        CreateLibrary();
+
+        WalkResult scan_result = {};
+        const auto dir_count = ScanWalk(scan_result);
+        // The base, folders, virtual amiibos and legacy ones
+        const auto expected_dir_count = 1 + FolderCount + (FolderCount * AmiibosPerFolder) + 1 + (LegacyCount * 2);
+        TEST_CHECK(dir_count == expected_dir_count);
+
+        printf("%u directories (%u virtual amiibos, %u legacy ones):\n", dir_count, FolderCount * AmiibosPerFolder, LegacyCount * 3);
+        WalkResult probe_result = {};
+        const auto probe_stats = MeasureWalk("Probes", ProbeWalk, dir_count, probe_result);
+        scan_result = {};
+        const auto scan_stats = MeasureWalk("Listing", ScanWalk, dir_count, scan_result);
+
+        // Both find the same, but the listing needs no stat at all (entry types come with it) and opens each directory once
+        TEST_CHECK(scan_result.amiibos.size() == (FolderCount * AmiibosPerFolder));
+        TEST_CHECK(scan_result.amiibos == probe_result.amiibos);
+        // The probes went into current virtual amiibos too, taking their mii-charinfo.bin for raw bins
+        TEST_CHECK(scan_result.bin_count == LegacyCount);
+        TEST_CHECK(probe_result.bin_count == (LegacyCount + (FolderCount * AmiibosPerFolder)));
+        TEST_CHECK((scan_result.v2_count == LegacyCount) && (probe_result.v2_count == LegacyCount));
+        TEST_CHECK((scan_result.v3_count == LegacyCount) && (probe_result.v3_count == LegacyCount));
+        TEST_CHECK(scan_stats.stat_count == 0);
+        TEST_CHECK(scan_stats.dir_open_count == dir_count);
+        TEST_CHECK(probe_stats.stat_count > (dir_count * 4));
+    }
+
+    // What the locator did before the parallel scan: every level returned its own vector, copied into its parent's, and took the lock again
+
+    Lock g_recursive_scan_lock;
+
+    std::vector<std::string> RecursiveScanImpl(const std::string &base_path) {
+        EMU_LOCK_SCOPE_WITH(g_recursive_scan_lock);
+        std::vector<std::string> amiibos;
+        amiibo::DirectoryScanInfo info = {};
+        if(!amiibo::ScanDirectory(base_path, info)) {
+            return amiibos;
+        }
+        for(const auto &child_dir: info.child_dirs) {
+            const auto path = fs::Concat(base_path, child_dir);
+            amiibo::DirectoryScanInfo child_info = {};
+            if(!amiibo::ScanDirectory(path, child_info)) {
+                continue;
+            }
+            if(child_info.format == amiibo::VirtualAmiiboFormat::Current) {
+                amiibos.push_back(path);
+            }
+            else {
+                const auto inner_amiibos = RecursiveScanImpl(path);
+                amiibos.insert(amiibos.end(), inner_amiibos.begin(), inner_amiibos.end());
+            }
+        }
+        return amiibos;
+    }
+
+    std::string CreateWideTree() {
+        const auto base_path = fs::Concat(consts::AmiiboDir, "wide");
+        fs::CreateDirectory(base_path);
+        for(u32 i = 0; i < WideFolderCount; i++) {
+            const auto folder = fs::Concat(base_path, "folder_" + std::to_string(i));
+            fs::CreateDirectory(folder);
+            for(u32 j = 0; j < WideAmiibosPerFolder; j++) {
+                CreateCurrentAmiibo(fs::Concat(folder, "amiibo_" + std::to_string(j)));
+            }
+        }
+        return base_path;
+    }
+
+    // Every level of each branch has a virtual amiibo and the next level
+    std::string CreateDeepTree() {
+        const auto base_path = fs::Concat(consts::AmiiboDir, "deep");
+        fs::CreateDirectory(base_path);
+        for(u32 i = 0; i < DeepBranchCount; i++) {
+            auto level_path = fs::Concat(base_path, "branch_" + std::to_string(i));
+            for(u32 j = 0; j < DeepBranchDepth; j++) {
+                fs::CreateDirectory(level_path);
+                CreateCurrentAmiibo(fs::Concat(level_path, "a"));
+                level_path = fs::Concat(level_path, "d");
+            }
+        }
+        return base_path;
+    }
+
+    template<typename F>
+    double MeasureScan(F scan_fn, const std::vector<std::string> &expected_amiibos) {
+        bool matches = true;
+        test::Timer timer;
+        for(u32 i = 0; i < RoundCount; i++) {
+            auto amiibos = scan_fn();
+            std::sort(amiibos.begin(), amiibos.end());
+            matches &= amiibos == expected_amiibos;
+        }
+        TEST_CHECK(matches);
+        return timer.GetElapsedUs() / RoundCount;
+    }
+
+    void BenchmarkTraversal(const char *name, const std::string &base_path, u32 expected_count) {
+        auto expected_amiibos = RecursiveScanImpl(base_path);
+        std::sort(expected_amiibos.begin(), expected_amiibos.end());
+        TEST_CHECK(expected_amiibos.size() == expected_count);
+
+        printf("%s tree (%u virtual amiibos):\n", name, expected_count);
+        const auto recursive_us = MeasureScan([&]() {
+            return RecursiveScanImpl(base_path);
+        }, expected_amiibos);
+        printf("  Recursive:   %8.0f us per scan\n", recursive_us);
+        for(u32 thread_count = sys::MinAmiiboScanThreadCount; thread_count <= sys::MaxAmiiboScanThreadCount; thread_count++) {
+            u32 dir_count = 0;
+            const auto scan_us = MeasureScan([&]() {
+                std::vector<std::string> amiibos;
+                amiibos.reserve(expected_count);
+                dir_count = sys::ScanVirtualAmiibos(base_path, thread_count, [&](const std::string &path) {
+                    amiibos.push_back(path);
+                }, nullptr);
+                return amiibos;
+            }, expected_amiibos);
+            printf("  %u thread(s): %8.0f us per scan (%.2fx), %u directories\n", thread_count, scan_us, recursive_us / scan_us, dir_count);
+        }
+    }
+
+}
+
+int main(int argc, char **argv) {
+    if(!test::PrepareSdCard((argc > 1) ? argv[1] : "/tmp/emuiibo_test_directory_scan")) {
+        return 1;
+    }
+    TestClassification();
+    BenchmarkBootScan();
+
+    // There's no SD latency to hide on the host, so this mostly shows the scheduling overhead of the workers
+    BenchmarkTraversal("Wide", CreateWideTree(), WideFolderCount * WideAmiibosPerFolder);
+    BenchmarkTraversal("Deep", CreateDeepTree(), DeepBranchCount * DeepBranchDepth);
+    return test::Finish();
+}
@@ -0,0 +1,172 @@
+// Host test of the SD I/O accounting: goes through what a game session does with a virtual amiibo (one step per IPC command),
+// dumps what each step and each subsystem cost, and checks there's no write amplification (nor reads which prewarming should have avoided)
+#include "test_Utils.hpp"
+#include <amiibo/amiibo_Formats.hpp>
+
+namespace {
+
+    constexpr amiibo::AreaId AreaId = 0x10110100;
+
+    constexpr const char *SubsystemNames[] = { "Other", "Areas", "VirtualAmiibo", "Mii", "Locator", "Settings", "Log", "Emulation" };
+    static_assert(std::size(SubsystemNames) == static_cast<u32>(fs::Subsystem::Count), "Missing subsystem names");
+
+    void PrintStats(const char *name, const fs::IoStats &stats) {
+        printf("  %-24s %4u stat %4u open %4u read %4u write %4u dir %4u entry %4u meta, %6lu bytes read, %6lu bytes written\n", name, stats.stat_count, stats.open_count, stats.read_count, stats.write_count, stats.dir_open_count, stats.dir_entry_count, stats.metadata_count, static_cast<unsigned long>(stats.read_size), static_cast<unsigned long>(stats.written_size));
+    }
+
+    // Like the IPC server does for every command, operations are counted for the step besides their subsystem
+    template<typename F>
+    fs::IoStats RunStep(const char *name, F fn) {
+        fs::IoCounters counters;
+        counters.Reset();
+        const auto prev_counters = fs::BindThreadCommandIoCounters(&counters);
+        fn();
+        fs::BindThreadCommandIoCounters(prev_counters);
+        fs::IoStats stats = {};
+        counters.Load(stats);
+        PrintStats(name, stats);
+        return stats;
+    }
+
+    inline u32 GetOperationCount(const fs::IoStats &stats) {
+        return stats.stat_count + stats.open_count + stats.read_count + stats.write_count + stats.dir_open_count + stats.dir_entry_count + stats.metadata_count;
+    }
+
+    std::string CreateAmiibo() {
+        const auto path = fs::Concat(consts::AmiiboDir, "amiibo");
+        fs::CreateDirectory(path);
+        fs::CreateEmptyFile(fs::Concat(path, "amiibo.flag"));
+        test::WriteTextFile(fs::Concat(path, "amiibo.json"), R"({
+    "name": "Test amiibo",
+    "uuid": [ 4, 1, 2, 3, 4, 5, 6, 7, 0, 0 ],
+    "id": { "game_character_id": 1, "character_variant": 0, "series": 0, "model_number": 0, "figure_type": 0 },
+    "mii_charinfo_file": "mii-charinfo.bin",
+    "first_write_date": { "y": 2020, "m": 1, "d": 1 },
+    "last_write_date": { "y": 2020, "m": 1, "d": 1 },
+    "write_counter": 0,
+    "version": 0
+})");
+        return path;
+    }
+
+    void TestFirstLoad(const std::string &path) {
+        // Without a cache or a mii yet, both get written once (and only once)
+        printf("First load:\n");
+        const auto load_stats = RunStep("Load", [&]() {
+            amiibo::VirtualAmiibo amiibo(path);
+            TEST_CHECK(amiibo.IsValid());
+            amiibo.Prewarm();
+        });
+        TEST_CHECK(load_stats.write_count == 2);
+        TEST_CHECK(load_stats.written_size == (fs::GetFileSize(fs::Concat(path, "amiibo.cache")) + sizeof(CharInfo)));
+    }
+
+    void TestGameSession(const std::string &path) {
+        fs::ResetIoStats();
+        printf("Game session:\n");
+        fs::IoStats step_totals = {};
+        const auto add_step = [&](const fs::IoStats &stats) {
+            step_totals.stat_count += stats.stat_count;
+            step_totals.open_count += stats.open_count;
+            step_totals.read_count += stats.read_count;
+            step_totals.write_count += stats.write_count;
+            step_totals.dir_open_count += stats.dir_open_count;
+            step_totals.dir_entry_count += stats.dir_entry_count;
+            step_totals.metadata_count += stats.metadata_count;
+            step_totals.read_size += stats.read_size;
+            step_totals.written_size += stats.written_size;
+            return stats;
+        };
+
+        amiibo::VirtualAmiibo *amiibo_ptr = nullptr;
+        // Metadata comes from the cache, and nothing is written back
+        const auto load_stats = add_step(RunStep("Load", [&]() {
+            amiibo_ptr = new amiibo::VirtualAmiibo(path);
+        }));
+        auto &amiibo = *amiibo_ptr;
+        TEST_CHECK(amiibo.IsValid());
+        TEST_CHECK((load_stats.write_count == 0) && (load_stats.written_size == 0));
+        TEST_CHECK(load_stats.read_size == sizeof(amiibo::VirtualAmiiboCache));
+
+        const auto prewarm_stats = add_step(RunStep("Prewarm", [&]() {
+            amiibo.Prewarm();
+        }));
+        TEST_CHECK(prewarm_stats.written_size == 0);
+        TEST_CHECK(prewarm_stats.read_size == sizeof(CharInfo));
+        TEST_CHECK(prewarm_stats.dir_open_count == 1);
+
+        // Everything these need is in memory by now
+        const auto info_stats = add_step(RunStep("GetTagInfo/RegisterInfo", [&]() {
+            amiibo.ProduceTagInfo();
+            amiibo.ProduceRegisterInfo();
+            amiibo.ProduceCommonInfo();
+        }));
+        TEST_CHECK(GetOperationCount(info_stats) == 0);
+
+        u8 area[amiibo::AreaManager::DefaultSize] = {};
+        const auto open_stats = add_step(RunStep("OpenApplicationArea", [&]() {
+            TEST_CHECK(amiibo.GetAreaManager().Exists(AreaId));
+        }));
+        TEST_CHECK(GetOperationCount(open_stats) == 0);
+
+        const auto read_stats = add_step(RunStep("GetApplicationArea", [&]() {
+            amiibo.GetAreaManager().Read(AreaId, area, sizeof(area));
+        }));
+        TEST_CHECK(read_stats.stat_count == 0);
+        TEST_CHECK((read_stats.open_count == 1) && (read_stats.read_size == sizeof(area)));
+
+        // Only the area itself gets written, no stat nor metadata operation on the way
+        area[0] = 0xAA;
+        const auto write_stats = add_step(RunStep("SetApplicationArea", [&]() {
+            amiibo.GetAreaManager().Write(AreaId, area, sizeof(area));
+        }));
+        TEST_CHECK((write_stats.stat_count == 0) && (write_stats.metadata_count == 0));
+        TEST_CHECK((write_stats.write_count == 1) && (write_stats.written_size == sizeof(area)));
+
+        // Flushing rewrites amiibo.json and its cache, and nothing else
+        const auto flush_stats = add_step(RunStep("Flush", [&]() {
+            amiibo.NotifyWritten();
+        }));
+        TEST_CHECK(flush_stats.read_size == 0);
+        delete amiibo_ptr;
+
+        // Every operation was counted for its subsystem as well as for its step
+        printf("Per subsystem:\n");
+        fs::IoStats subsystem_stats[static_cast<u32>(fs::Subsystem::Count)] = {};
+        const auto count = fs::GetIoStats(subsystem_stats, static_cast<u32>(fs::Subsystem::Count));
+        for(u32 i = 0; i < count; i++) {
+            if(GetOperationCount(subsystem_stats[i]) > 0) {
+                PrintStats(SubsystemNames[i], subsystem_stats[i]);
+            }
+        }
+        const auto total_stats = test::GetTotalIoStats();
+        // Not counted for the session, since stats were already taken
+        const auto json_size = fs::GetFileSize(fs::Concat(path, "amiibo.json"));
+        const auto cache_size = fs::GetFileSize(fs::Concat(path, "amiibo.cache"));
+        TEST_CHECK(flush_stats.written_size == (json_size + cache_size));
+        TEST_CHECK(GetOperationCount(total_stats) == GetOperationCount(step_totals));
+        TEST_CHECK((total_stats.read_size == step_totals.read_size) && (total_stats.written_size == step_totals.written_size));
+        TEST_CHECK(subsystem_stats[static_cast<u32>(fs::Subsystem::Areas)].written_size == sizeof(area));
+        TEST_CHECK(subsystem_stats[static_cast<u32>(fs::Subsystem::Mii)].read_size == sizeof(CharInfo));
+        TEST_CHECK(subsystem_stats[static_cast<u32>(fs::Subsystem::VirtualAmiibo)].written_size == (json_size + cache_size));
+        TEST_CHECK(GetOperationCount(subsystem_stats[static_cast<u32>(fs::Subsystem::Other)]) == 0);
+    }
+
+}
+
+int main(int argc, char **argv) {
+    auto settings = sys::DefaultSettings;
+    settings.use_amiibo_metadata_cache = true;
+    if(!test::PrepareSdCard((argc > 1) ? argv[1] : "/tmp/emuiibo_test_io_stats", settings)) {
+        return 1;
+    }
+    const auto path = CreateAmiibo();
+    TestFirstLoad(path);
+    {
+        amiibo::AreaManager area_manager(path);
+        const u8 area[amiibo::AreaManager::DefaultSize] = {};
+        area_manager.Create(AreaId, area, sizeof(area));
+    }
+    TestGameSession(path);
+    return test::Finish();
+}
@@ -0,0 +1,188 @@
+// Host test of the streaming (SAX) amiibo.json decoding: checks the decoded fields and the rejection of malformed files,
+// and compares its throughput against building a DOM (what loading virtual amiibos used to do) on a few thousand files
+#include "test_Utils.hpp"
+#include <amiibo/amiibo_Formats.hpp>
+
+namespace {
+
+    constexpr u32 FileCount = 2000;
+    constexpr u32 RoundCount = 5;
+
+    std::string MakeAmiiboJSON(u32 idx) {
+        char json[0x400] = {};
+        snprintf(json, sizeof(json), R"({
+    "name": "Amiibo %u",
+    "uuid": [ 4, 1, 2, 3, 4, 5, 6, %u, 0, 0 ],
+    "id": {
+        "game_character_id": %u,
+        "character_variant": 1,
+        "series": %u,
+        "model_number": %u,
+        "figure_type": 2
+    },
+    "mii_charinfo_file": "mii-charinfo.bin",
+    "first_write_date": { "y": 2020, "m": 1, "d": 2 },
+    "last_write_date": { "y": 2021, "m": 3, "d": %u },
+    "write_counter": %u,
+    "version": 0,
+    "user_notes": { "rating": -1, "scale": 1.5, "tags": [ "a", "b" ] }
+})", idx, idx & 0xFF, idx % 0x1000, idx % 0x40, idx % 0x400, (idx % 28) + 1, idx % 0x100);
+        return json;
+    }
+
+    std::string GetAmiiboPath(u32 idx) {
+        char path[FS_MAX_PATH] = {};
+        snprintf(path, sizeof(path), "%s/amiibo_%04u", consts::AmiiboDir.c_str(), idx);
+        return path;
+    }
+
+    void CreateAmiibo(const std::string &path, const std::string &json) {
+        fs::CreateDirectory(path);
+        fs::CreateEmptyFile(fs::Concat(path, "amiibo.flag"));
+        test::WriteTextFile(fs::Concat(path, "amiibo.json"), json);
+    }
+
+    bool CheckDecodedFields(const amiibo::VirtualAmiiboData &data, u32 idx) {
+        const auto id = data.id;
+        return (data.name == ("Amiibo " + std::to_string(idx))) && !data.uuid_info.random_uuid && (data.uuid_info.uuid[7] == (idx & 0xFF))
+            && (id.character_id.game_character_id == (idx % 0x1000)) && (id.character_id.character_variant == 1) && (id.series == (idx % 0x40)) && (id.model_number == (idx % 0x400)) && (id.figure_type == 2)
+            && (data.mii_charinfo_file == "mii-charinfo.bin") && (data.first_write_date.year == 2020) && (data.last_write_date.day == ((idx % 28) + 1)) && (data.write_counter == (idx % 0x100));
+    }
+
+    // What loading a virtual amiibo used to do: a DOM for the whole file, and then a lookup per field
+    bool ReadWithDOM(const std::string &path, amiibo::VirtualAmiiboData &out_data) {
+        mem::ScratchScope scratch;
+        auto json = fs::LoadJSONFile(fs::Concat(path, "amiibo.json"));
+        if(!json.count("name") || !json.count("id")) {
+            return false;
+        }
+        out_data.name = json["name"].get<std::string>();
+        out_data.uuid_info.random_uuid = !json.count("uuid");
+        if(!out_data.uuid_info.random_uuid) {
+            for(u32 i = 0; i < sizeof(out_data.uuid_info.uuid); i++) {
+                out_data.uuid_info.uuid[i] = json["uuid"][i].get<u8>();
+            }
+        }
+        auto &id_obj = json["id"];
+        out_data.id.character_id.game_character_id = id_obj["game_character_id"].get<u16>();
+        out_data.id.character_id.character_variant = id_obj["character_variant"].get<u8>();
+        out_data.id.series = id_obj["series"].get<u8>();
+        out_data.id.model_number = id_obj["model_number"].get<u16>();
+        out_data.id.figure_type = id_obj["figure_type"].get<u8>();
+        out_data.mii_charinfo_file = json["mii_charinfo_file"].get<std::string>();
+        for(auto [date, key]: { std::make_pair(&out_data.first_write_date, "first_write_date"), std::make_pair(&out_data.last_write_date, "last_write_date") }) {
+            date->year = json[key]["y"].get<u16>();
+            date->month = json[key]["m"].get<u8>();
+            date->day = json[key]["d"].get<u8>();
+        }
+        out_data.write_counter = json["write_counter"].get<u16>();
+        out_data.version = json["version"].get<u32>();
+        return true;
+    }
+
+    void TestDecoding() {
+        const auto path = GetAmiiboPath(0);
+        CreateAmiibo(path, MakeAmiiboJSON(1234));
+
+        // Reading metadata must not write anything, not even an outdated cache
+        amiibo::VirtualAmiiboData data = {};
+        bool from_cache = true;
+        TEST_CHECK(amiibo::ReadVirtualAmiiboData(path, data, from_cache));
+        TEST_CHECK(!from_cache);
+        TEST_CHECK(CheckDecodedFields(data, 1234));
+        TEST_CHECK(!fs::IsFile(fs::Concat(path, "amiibo.cache")));
+        TEST_CHECK(!fs::IsDirectory(fs::Concat(path, "areas")));
+
+        // Loading it does regenerate the cache, which is then used instead of the JSON
+        {
+            amiibo::VirtualAmiibo amiibo(path);
+            TEST_CHECK(amiibo.IsValid());
+            TEST_CHECK(amiibo.GetName() == "Amiibo 1234");
+        }
+        TEST_CHECK(fs::IsFile(fs::Concat(path, "amiibo.cache")));
+        amiibo::VirtualAmiiboData cached_data = {};
+        TEST_CHECK(amiibo::ReadVirtualAmiiboData(path, cached_data, from_cache));
+        TEST_CHECK(from_cache);
+        TEST_CHECK(CheckDecodedFields(cached_data, 1234));
+
+        // Malformed files (or known fields with invalid values) are rejected, unknown fields are ignored
+        const std::pair<const char*, bool> cases[] = {
+            { R"({ "name": "Truncated", "id": { "series": 1)", false },
+            { R"({ "name": "Negative", "id": { "series": -1 } })", false },
+            { R"({ "name": "Negative counter", "write_counter": -5 })", false },
+            { R"({ "a": { "b": { "c": { "d": { "e": { "f": { "g": { "h": { "i": 0 } } } } } } } } })", false },
+            { R"([ 1, 2, )", false },
+            { R"({ "name": "Unknown negative", "extra": -1, "float": 0.5, "nothing": null })", true },
+        };
+        const auto malformed_path = GetAmiiboPath(1);
+        for(const auto &[json, valid]: cases) {
+            fs::DeleteDirectory(malformed_path);
+            CreateAmiibo(malformed_path, json);
+            amiibo::VirtualAmiiboData malformed_data = {};
+            const auto decoded = amiibo::ReadVirtualAmiiboData(malformed_path, malformed_data, from_cache);
+            if(decoded != valid) {
+                fprintf(stderr, "Unexpected result for %s\n", json);
+            }
+            TEST_CHECK(decoded == valid);
+        }
+        fs::DeleteDirectory(path);
+        fs::DeleteDirectory(malformed_path);
+    }
+
+    template<typename F>
+    double MeasureReads(F read_fn, u32 &out_failed_count) {
+        out_failed_count = 0;
+        test::Timer timer;
+        for(u32 round = 0; round < RoundCount; round++) {
+            for(u32 i = 0; i < FileCount; i++) {
+                amiibo::VirtualAmiiboData data = {};
+                if(!read_fn(GetAmiiboPath(i), data) || !CheckDecodedFields(data, i)) {
+                    out_failed_count++;
+                }
+            }
+        }
+        return timer.GetElapsedUs();
+    }
+
+    void BenchmarkDecoding() {
+        size_t total_size = 0;
+        for(u32 i = 0; i < FileCount; i++) {
+            const auto json = MakeAmiiboJSON(i);
+            CreateAmiibo(GetAmiiboPath(i), json);
+            total_size += json.length();
+        }
+        const auto total_mib = (static_cast<double>(total_size) * RoundCount) / (1024.0 * 1024.0);
+        const auto file_reads = static_cast<double>(FileCount) * RoundCount;
+
+        u32 dom_failed_count = 0;
+        const auto dom_us = MeasureReads(ReadWithDOM, dom_failed_count);
+        u32 sax_failed_count = 0;
+        const auto sax_us = MeasureReads([](const std::string &path, amiibo::VirtualAmiiboData &out_data) {
+            bool from_cache = false;
+            return amiibo::ReadVirtualAmiiboData(path, out_data, from_cache);
+        }, sax_failed_count);
+        TEST_CHECK(dom_failed_count == 0);
+        TEST_CHECK(sax_failed_count == 0);
+
+        printf("%u files x %u rounds (%.1f MiB):\n", FileCount, RoundCount, total_mib);
+        printf("  DOM: %.2f us/file, %.1f MiB/s\n", dom_us / file_reads, total_mib / (dom_us / 1'000'000.0));
+        printf("  SAX: %.2f us/file, %.1f MiB/s (%.2fx)\n", sax_us / file_reads, total_mib / (sax_us / 1'000'000.0), dom_us / sax_us);
+    }
+
+}
+
+int main(int argc, char **argv) {
+    auto settings = sys::DefaultSettings;
+    settings.use_amiibo_metadata_cache = true;
+    if(!test::PrepareSdCard((argc > 1) ? argv[1] : "/tmp/emuiibo_test_json_reader", settings)) {
+        return 1;
+    }
+    TestDecoding();
+
+    // Every read has to parse the JSON for the benchmark
+    settings.use_amiibo_metadata_cache = false;
+    settings.log_level = sys::LogLevel::Off;
+    sys::SetSettings(settings);
+    BenchmarkDecoding();
+    return test::Finish();
+}
@@ -0,0 +1,149 @@
+// Host stress test of the per virtual amiibo locking: many readers and writers share one RwMutex and the AreaManager it protects
+// Readers must never see a partially written area (or size), writers must never overlap with anyone else
+#include <amiibo/amiibo_Areas.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace sys {
+
+    LogLevel GetLogLevel() {
+        return LogLevel::Off;
+    }
+
+}
+
+namespace {
+
+    constexpr u32 ReaderCount = 8;
+    constexpr u32 WriterCount = 4;
+    constexpr u32 AreaCount = 4;
+    constexpr auto TestDuration = std::chrono::seconds(2);
+
+    struct SharedState {
+        RwMutex lock;
+        amiibo::AreaManager areas;
+        // Plain (non-atomic) fields, only ever accessed with the lock held
+        u64 generation;
+        u64 generation_copy;
+
+        std::atomic_bool done;
+        std::atomic_int readers_inside;
+        std::atomic_int writers_inside;
+        std::atomic_int max_readers_inside;
+        std::atomic_uint64_t read_count;
+        std::atomic_uint64_t write_count;
+        std::atomic_uint64_t error_count;
+
+        SharedState(const std::string &dir) : areas(dir), generation(0), generation_copy(0), done(false), readers_inside(0), writers_inside(0), max_readers_inside(0), read_count(0), write_count(0), error_count(0) {}
+    };
+
+    void ReportError(SharedState &state, const char *msg) {
+        if(state.error_count.fetch_add(1) < 10) {
+            fprintf(stderr, "error: %s\n", msg);
+        }
+    }
+
+    void ReaderMain(SharedState &state, u32 idx) {
+        u8 area[amiibo::AreaManager::DefaultSize];
+        u32 area_idx = idx;
+        while(!state.done) {
+            EMU_READ_LOCK_SCOPE_WITH(state.lock);
+            const auto inside = state.readers_inside.fetch_add(1) + 1;
+            auto max_inside = state.max_readers_inside.load();
+            while((inside > max_inside) && !state.max_readers_inside.compare_exchange_weak(max_inside, inside));
+            if(state.writers_inside != 0) {
+                ReportError(state, "reader inside together with a writer");
+            }
+            if(state.generation != state.generation_copy) {
+                ReportError(state, "torn generation");
+            }
+
+            const auto id = static_cast<amiibo::AreaId>(area_idx++ % AreaCount);
+            if(state.areas.Exists(id)) {
+                if(state.areas.GetSize(id) != sizeof(area)) {
+                    ReportError(state, "unexpected area size");
+                }
+                state.areas.Read(id, area, sizeof(area));
+                // Every write fills the whole area with the same byte
+                for(size_t i = 1; i < sizeof(area); i++) {
+                    if(area[i] != area[0]) {
+                        ReportError(state, "torn area contents");
+                        break;
+                    }
+                }
+            }
+            state.readers_inside.fetch_sub(1);
+            state.read_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void WriterMain(SharedState &state, u32 idx) {
+        u8 area[amiibo::AreaManager::DefaultSize];
+        u32 area_idx = idx;
+        while(!state.done) {
+            EMU_WRITE_LOCK_SCOPE_WITH(state.lock);
+            if(state.writers_inside.fetch_add(1) != 0) {
+                ReportError(state, "two writers inside");
+            }
+            if(state.readers_inside != 0) {
+                ReportError(state, "writer inside together with a reader");
+            }
+
+            state.generation++;
+            memset(area, static_cast<u8>(state.generation), sizeof(area));
+            const auto id = static_cast<amiibo::AreaId>(area_idx++ % AreaCount);
+            // Mix plain writes and recreations, which drop the area from the cache first
+            if((state.generation % 8) == 0) {
+                state.areas.Recreate(id, area, sizeof(area));
+            }
+            else {
+                state.areas.Write(id, area, sizeof(area));
+            }
+            state.generation_copy = state.generation;
+
+            state.writers_inside.fetch_sub(1);
+            state.write_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool RunStressTest(const char *name, const std::string &dir, bool prewarm) {
+        fs::DeleteDirectory(dir);
+        fs::CreateDirectory(dir);
+        SharedState state(dir);
+        if(prewarm) {
+            state.areas.Prewarm();
+        }
+
+        std::vector<std::thread> threads;
+        for(u32 i = 0; i < ReaderCount; i++) {
+            threads.emplace_back(ReaderMain, std::ref(state), i);
+        }
+        for(u32 i = 0; i < WriterCount; i++) {
+            threads.emplace_back(WriterMain, std::ref(state), i);
+        }
+        std::this_thread::sleep_for(TestDuration);
+        state.done = true;
+        for(auto &thread: threads) {
+            thread.join();
+        }
+        fs::DeleteDirectory(dir);
+
+        const auto secs = std::chrono::duration<double>(TestDuration).count();
+        printf("%s: %llu reads (%.0f/s), %llu writes (%.0f/s), up to %d readers at once, %llu errors\n", name,
+            static_cast<unsigned long long>(state.read_count.load()), state.read_count / secs,
+            static_cast<unsigned long long>(state.write_count.load()), state.write_count / secs,
+            state.max_readers_inside.load(), static_cast<unsigned long long>(state.error_count.load()));
+        // Both sides must have made progress, otherwise one of them is starved
+        return (state.error_count == 0) && (state.read_count > 0) && (state.write_count > 0);
+    }
+
+}
+
+int main(int argc, char **argv) {
+    const std::string base_dir = (argc > 1) ? argv[1] : "/tmp/emuiibo_test_locking";
+    auto ok = RunStressTest("Uncached areas", base_dir + "_uncached", false);
+    ok &= RunStressTest("Prewarmed areas", base_dir + "_prewarmed", true);
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#pragma once
+// Shared by the host tests which go through emuiibo's SD card paths
+#include <sys/sys_Settings.hpp>
+#include <fs/fs_FileSystem.hpp>
+#include <chrono>
+#include <unistd.h>
+
+namespace test {
+
+    // Failed checks are reported (with their line) and counted, so that a test reports every failure instead of only the first one
+    inline u32 g_failed_check_count = 0;
+
+    #define TEST_CHECK(cond) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            ::test::g_failed_check_count++; \
+        } \
+    } while(0)
+
+    // SD card paths ("sdmc:/emuiibo/...") are relative ones on the host, so each test runs inside its own (fresh) directory
+    inline bool PrepareSdCard(const std::string &base_dir, sys::Settings settings = sys::DefaultSettings) {
+        fs::DeleteDirectory(base_dir);
+        if((mkdir(base_dir.c_str(), 0755) != 0) || (chdir(base_dir.c_str()) != 0)) {
+            fprintf(stderr, "Unable to use '%s' as the SD card\n", base_dir.c_str());
+            return false;
+        }
+        fs::CreateDirectory("sdmc:");
+        fs::EnsureEmuiiboDirectories();
+        // Logging would only slow the benchmarks down
+        settings.log_level = sys::LogLevel::Off;
+        sys::SetSettings(settings);
+        return true;
+    }
+
+    // Sums the stats of every subsystem
+    inline fs::IoStats GetTotalIoStats() {
+        fs::IoStats stats[static_cast<u32>(fs::Subsystem::Count)] = {};
+        const auto count = fs::GetIoStats(stats, static_cast<u32>(fs::Subsystem::Count));
+        fs::IoStats total = {};
+        for(u32 i = 0; i < count; i++) {
+            total.stat_count += stats[i].stat_count;
+            total.open_count += stats[i].open_count;
+            total.read_count += stats[i].read_count;
+            total.write_count += stats[i].write_count;
+            total.dir_open_count += stats[i].dir_open_count;
+            total.dir_entry_count += stats[i].dir_entry_count;
+            total.metadata_count += stats[i].metadata_count;
+            total.read_size += stats[i].read_size;
+            total.written_size += stats[i].written_size;
+        }
+        return total;
+    }
+
+    inline void WriteTextFile(const std::string &path, const std::string &text) {
+        auto f = fopen(path.c_str(), "wb");
+        if(f) {
+            fwrite(text.data(), 1, text.length(), f);
+            fclose(f);
+        }
+    }
+
+    class Timer {
+
+        private:
+            std::chrono::steady_clock::time_point start;
+
+        public:
+            Timer() : start(std::chrono::steady_clock::now()) {}
+
+            inline double GetElapsedUs() {
+                return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - this->start).count();
+            }
+
+    };
+
+    inline int Finish() {
+        printf("%s\n", (g_failed_check_count == 0) ? "OK" : "FAILED");
+        return (g_failed_check_count == 0) ? 0 : 1;
+    }
+
+}
@@ -50,6 +50,30 @@ namespace emu {
         bool dev_build;
     };
 
+    struct EmulationStatusSnapshot {
+        u64 sequence_number;
+        // Only valid when there is an active virtual amiibo
+        u64 active_virtual_amiibo_id;
+        EmulationStatus emulation_status;
+        VirtualAmiiboStatus active_virtual_amiibo_status;
+    };
+
+    enum class VirtualAmiiboFolderItemType : u8 {
+        Folder,
+        VirtualAmiibo
+    };
+
+    struct VirtualAmiiboFolderItem {
+        u64 id;
+        VirtualAmiiboFolderItemType type;
+        u8 reserved[3];
+        char name[0x74];
+    };
+
+    static_assert(sizeof(VirtualAmiiboFolderItem) == 0x80, "Invalid VirtualAmiiboFolderItem struct!");
+
+    constexpr u64 RootFolderId = 0;
+
     bool IsAvailable();
 
     Result Initialize();
@@ -68,19 +92,17 @@ namespace emu {
 
     Version GetVersion();
 
-    // Utils
-
-    inline std::vector<VirtualAmiibo> ListAmiibos() {
-        std::vector<VirtualAmiibo> amiibos;
-        auto count = GetVirtualAmiiboCount();
-        for(u32 i = 0; i < count; i++) {
-            VirtualAmiibo amiibo = {};
-            if(R_FAILED(OpenVirtualAmiibo(i, amiibo))) {
-                break;
-            }
-            amiibos.push_back(amiibo);
-        }
-        return amiibos;
-    }
+    // Ids are stable across rescans and reboots, unlike indices
+    Result OpenVirtualAmiiboById(u64 id, VirtualAmiibo &amiibo);
+    Result SetActiveVirtualAmiiboById(u64 id);
+    Result GetActiveVirtualAmiiboId(u64 &out_id);
+    u32 GetVirtualAmiiboIds(u32 offset, u64 *out_ids, size_t out_ids_count);
+
+    // Child folders come first, then virtual amiibos
+    Result ListFolder(u64 folder_id, u32 offset, VirtualAmiiboFolderItem *out_items, size_t out_items_count, u32 &out_count, u32 &out_total_count);
+
+    // Signaled every time the emulation status, the active virtual amiibo or its status changes
+    Result GetStatusChangeEvent(Event &out_event);
+    EmulationStatusSnapshot GetEmulationStatusSnapshot();
 
 }
\ No newline at end of file
@@ -8,19 +8,104 @@ namespace {
     bool g_emuiibo_init_ok = false;
     bool g_in_second_menu = false;
     emu::VirtualAmiibo g_active_amiibo;
-    std::vector<emu::VirtualAmiibo> g_amiibo_list;
+    bool g_has_active_amiibo_id = false;
+    u64 g_active_amiibo_id = 0;
+    Event g_status_change_event;
+    bool g_has_status_change_event = false;
+    u64 g_status_sequence_number = 0;
+    // Bumped every time emuiibo's status changes, so that every open menu can refresh its text
+    u32 g_status_generation = 0;
+
+    inline void UpdateActiveAmiibo() {
+        g_active_amiibo.Close();
+        emu::GetActiveVirtualAmiibo(g_active_amiibo);
+        g_has_active_amiibo_id = R_SUCCEEDED(emu::GetActiveVirtualAmiiboId(g_active_amiibo_id));
+        g_status_generation++;
+    }
 
-    inline void ClearAmiiboList() {
-        for(auto &amiibo: g_amiibo_list) {
-            amiibo.Close();
+    // Doesn't block, emuiibo signals the event whenever something changes
+    inline void PollStatusChange() {
+        if(g_has_status_change_event && R_SUCCEEDED(eventWait(&g_status_change_event, 0))) {
+            const auto snapshot = emu::GetEmulationStatusSnapshot();
+            if(snapshot.sequence_number != g_status_sequence_number) {
+                g_status_sequence_number = snapshot.sequence_number;
+                UpdateActiveAmiibo();
+            }
         }
-        g_amiibo_list.clear();
     }
 
-    inline std::string MakeAvailableAmiibosText() {
-        return "Available virtual amiibos (" + std::to_string(g_amiibo_list.size()) + ")";
+    inline std::string MakeAvailableAmiibosText(const std::string &folder_name, u32 item_count) {
+        if(folder_name.empty()) {
+            return "Available virtual amiibos (" + std::to_string(item_count) + ")";
+        }
+        return folder_name + " (" + std::to_string(item_count) + ")";
     }
 
+    // Only a few pages of a folder's items are kept around, fetched as they're needed
+
+    class FolderItemSource {
+        private:
+            static constexpr u32 PageItemCount = 0x10;
+            static constexpr u32 CachedPageCount = 3;
+
+            struct Page {
+                u32 offset;
+                u32 item_count;
+                u64 last_use;
+                emu::VirtualAmiiboFolderItem items[PageItemCount];
+            };
+
+            u64 folder_id;
+            u32 total_count;
+            Page pages[CachedPageCount];
+            u64 use_counter;
+
+        public:
+            FolderItemSource(u64 folder_id) : folder_id(folder_id), total_count(0), pages(), use_counter(0) {
+                // The first page also tells us how many items there are
+                auto &page = this->pages[0];
+                if(R_SUCCEEDED(emu::ListFolder(this->folder_id, 0, page.items, PageItemCount, page.item_count, this->total_count))) {
+                    page.last_use = ++this->use_counter;
+                }
+            }
+
+            inline u32 GetCount() {
+                return this->total_count;
+            }
+
+            bool GetItem(u32 idx, emu::VirtualAmiiboFolderItem &out_item) {
+                const auto page_offset = idx - (idx % PageItemCount);
+                Page *lru_page = &this->pages[0];
+                for(u32 i = 0; i < CachedPageCount; i++) {
+                    auto &page = this->pages[i];
+                    if((page.last_use > 0) && (page.offset == page_offset)) {
+                        if((idx - page_offset) >= page.item_count) {
+                            return false;
+                        }
+                        page.last_use = ++this->use_counter;
+                        out_item = page.items[idx - page_offset];
+                        return true;
+                    }
+                    if(page.last_use < lru_page->last_use) {
+                        lru_page = &page;
+                    }
+                }
+
+                lru_page->last_use = 0;
+                u32 total_count = 0;
+                if(R_FAILED(emu::ListFolder(this->folder_id, page_offset, lru_page->items, PageItemCount, lru_page->item_count, total_count))) {
+                    return false;
+                }
+                lru_page->offset = page_offset;
+                lru_page->last_use = ++this->use_counter;
+                if((idx - page_offset) >= lru_page->item_count) {
+                    return false;
+                }
+                out_item = lru_page->items[idx - page_offset];
+                return true;
+            }
+    };
+
     inline std::string MakeActiveAmiiboText() {
         if(g_active_amiibo.IsValid()) {
             return "Active virtual amiibo: " + g_active_amiibo.GetName();
@@ -41,8 +126,8 @@ namespace {
             return "Unable to access emuiibo...";
         }
         std::string msg = "Emulation: ";
-        auto e_status = emu::GetEmulationStatus();
-        switch(e_status) {
+        const auto snapshot = emu::GetEmulationStatusSnapshot();
+        switch(snapshot.emulation_status) {
             case emu::EmulationStatus::On: {
                 msg += "on";
                 break;
@@ -53,8 +138,7 @@ namespace {
             }
         }
         msg += ", ";
-        auto v_status = emu::GetActiveVirtualAmiiboStatus();
-        switch(v_status) {
+        switch(snapshot.active_virtual_amiibo_status) {
             case emu::VirtualAmiiboStatus::Invalid: {
                 msg += "no active virtual amiibo";
                 break;
@@ -73,71 +157,157 @@ namespace {
 
 }
 
+// Only the visible rows exist, and they get their text replaced when scrolling past the first/last one
+
 class AmiibosList : public tsl::Gui {
 
     private:
+        static constexpr u32 RowCount = 10;
+        static constexpr u32 ScrollRepeatDelayFrames = 20;
+        static constexpr u32 ScrollRepeatIntervalFrames = 3;
+
+        std::string folder_name;
+        FolderItemSource item_source;
+        u32 window_offset;
+        u32 scroll_held_frames;
+        tsl::elm::SmallListItem *rows[RowCount];
+        u32 row_count;
+        u32 status_generation;
         tsl::elm::CustomOverlayFrame *root_frame;
         tsl::elm::BigCategoryHeader *selected_header;
-        tsl::elm::CategoryHeader *count_header;
-        tsl::elm::List *list;
-        tsl::elm::List *header_list;
+
+        void UpdateRows() {
+            for(u32 i = 0; i < this->row_count; i++) {
+                emu::VirtualAmiiboFolderItem item = {};
+                if(this->item_source.GetItem(this->window_offset + i, item)) {
+                    this->rows[i]->setText(item.name);
+                    this->rows[i]->setValue((item.type == emu::VirtualAmiiboFolderItemType::Folder) ? "\u2192" : "", true);
+                }
+                else {
+                    this->rows[i]->setText("...");
+                    this->rows[i]->setValue("", true);
+                }
+            }
+        }
+
+        bool ScrollRows(s32 delta) {
+            const auto max_offset = this->item_source.GetCount() - this->row_count;
+            if(((delta < 0) && (this->window_offset == 0)) || ((delta > 0) && (this->window_offset == max_offset))) {
+                return false;
+            }
+            this->window_offset += delta;
+            this->UpdateRows();
+            return true;
+        }
+
+        bool SelectRow(u32 row_idx) {
+            emu::VirtualAmiiboFolderItem item = {};
+            if(!this->item_source.GetItem(this->window_offset + row_idx, item)) {
+                return false;
+            }
+            if(item.type == emu::VirtualAmiiboFolderItemType::Folder) {
+                tsl::changeTo<AmiibosList>(item.id, item.name);
+                return true;
+            }
+
+            if(g_has_active_amiibo_id) {
+                if(item.id == g_active_amiibo_id) {
+                    // User selected the active amiibo, so let's change connection then
+                    auto status = emu::GetActiveVirtualAmiiboStatus();
+                    switch(status) {
+                        case emu::VirtualAmiiboStatus::Connected: {
+                            emu::SetActiveVirtualAmiiboStatus(emu::VirtualAmiiboStatus::Disconnected);
+                            root_frame->setSubtitle(MakeStatusText());
+                            break;
+                        }
+                        case emu::VirtualAmiiboStatus::Disconnected: {
+                            emu::SetActiveVirtualAmiiboStatus(emu::VirtualAmiiboStatus::Connected);
+                            root_frame->setSubtitle(MakeStatusText());
+                            break;
+                        }
+                        default:
+                            break;
+                    }
+                    return true;
+                }
+            }
+            // Set active amiibo and update our active amiibo value
+            emu::SetActiveVirtualAmiiboById(item.id);
+            UpdateActiveAmiibo();
+            selected_header->setText(MakeActiveAmiiboText());
+            root_frame->setSubtitle(MakeStatusText());
+            return true;
+        }
 
     public:
-        AmiibosList() : root_frame(new tsl::elm::CustomOverlayFrame(MakeTitleText(), MakeStatusText())) {}
+        AmiibosList(u64 folder_id = emu::RootFolderId, const std::string &folder_name = "") : folder_name(folder_name), item_source(folder_id), window_offset(0), scroll_held_frames(0), rows(), row_count(std::min(RowCount, item_source.GetCount())), status_generation(g_status_generation), root_frame(new tsl::elm::CustomOverlayFrame(MakeTitleText(), MakeStatusText())) {}
 
         virtual tsl::elm::Element *createUI() override {
-            list = new tsl::elm::List();
-            header_list = new tsl::elm::List();
+            auto list = new tsl::elm::List();
+            auto header_list = new tsl::elm::List();
 
             selected_header = new tsl::elm::BigCategoryHeader(MakeActiveAmiiboText(), true);
-            count_header = new tsl::elm::CategoryHeader(MakeAvailableAmiibosText(), true);
+            auto count_header = new tsl::elm::CategoryHeader(MakeAvailableAmiibosText(this->folder_name, this->item_source.GetCount()), true);
 
             header_list->addItem(selected_header);
             header_list->addItem(count_header);
-            
-            for(auto &amiibo: g_amiibo_list) {
-                auto *item = new tsl::elm::SmallListItem(amiibo.GetName());
-                item->setClickListener([&](u64 keys) {
+
+            for(u32 i = 0; i < this->row_count; i++) {
+                auto *item = new tsl::elm::SmallListItem("");
+                item->setClickListener([this, i](u64 keys) {
                     if(keys & KEY_A) {
-                        if(g_active_amiibo.IsValid()) {
-                            if(amiibo.GetName() == g_active_amiibo.GetName()) {
-                                // User selected the active amiibo, so let's change connection then
-                                auto status = emu::GetActiveVirtualAmiiboStatus();
-                                switch(status) {
-                                    case emu::VirtualAmiiboStatus::Connected: {
-                                        emu::SetActiveVirtualAmiiboStatus(emu::VirtualAmiiboStatus::Disconnected);
-                                        root_frame->setSubtitle(MakeStatusText());
-                                        break;
-                                    }
-                                    case emu::VirtualAmiiboStatus::Disconnected: {
-                                        emu::SetActiveVirtualAmiiboStatus(emu::VirtualAmiiboStatus::Connected);
-                                        root_frame->setSubtitle(MakeStatusText());
-                                        break;
-                                    }
-                                    default:
-                                        break;
-                                }
-                                return true;
-                            }
-                        }
-                        // Set active amiibo and update our active amiibo value
-                        amiibo.SetAsActiveVirtualAmiibo();
-                        g_active_amiibo.Close();
-                        emu::GetActiveVirtualAmiibo(g_active_amiibo);
-                        selected_header->setText(MakeActiveAmiiboText());
-                        root_frame->setSubtitle(MakeStatusText());
-                        return true;   
+                        return this->SelectRow(i);
                     }
                     return false;
                 });
+                this->rows[i] = item;
                 list->addItem(item);
             }
+            this->UpdateRows();
 
             root_frame->setHeader(header_list);
             root_frame->setContent(list);
             return root_frame;
         }
 
+        virtual bool handleInput(u64 keys_down, u64 keys_held, touchPosition touch_input, JoystickPosition left_joystick, JoystickPosition right_joystick) override {
+            if(this->row_count == 0) {
+                return false;
+            }
+            // Moving past the first/last row scrolls the rows instead of the focus
+            const auto focused = this->getFocusedElement();
+            s32 delta = 0;
+            if((focused == this->rows[this->row_count - 1]) && (keys_held & KEY_DOWN)) {
+                delta = 1;
+            }
+            else if((focused == this->rows[0]) && (keys_held & KEY_UP)) {
+                delta = -1;
+            }
+            if(delta == 0) {
+                this->scroll_held_frames = 0;
+                return false;
+            }
+
+            // Same as holding a direction in any other list: one step on press, then repeatedly after a short delay
+            this->scroll_held_frames++;
+            const auto pressed = (keys_down & (KEY_UP | KEY_DOWN)) != 0;
+            const auto repeat = (this->scroll_held_frames > ScrollRepeatDelayFrames) && ((this->scroll_held_frames % ScrollRepeatIntervalFrames) == 0);
+            if(pressed || repeat) {
+                return this->ScrollRows(delta);
+            }
+            return false;
+        }
+
+        virtual void update() override {
+            // Changes might come from other menus or from other clients
+            PollStatusChange();
+            if(this->status_generation != g_status_generation) {
+                this->status_generation = g_status_generation;
+                selected_header->setText(MakeActiveAmiiboText());
+                root_frame->setSubtitle(MakeStatusText());
+            }
+        }
+
 };
 
 class EmuiiboGui : public tsl::Gui {
@@ -145,9 +315,10 @@ class EmuiiboGui : public tsl::Gui {
     private:
         tsl::elm::BigCategoryHeader *amiibo_header;
         tsl::elm::OverlayFrame *root_frame;
+        u32 status_generation;
 
     public:
-        EmuiiboGui() : amiibo_header(new tsl::elm::BigCategoryHeader(MakeActiveAmiiboText(), true)), root_frame(new tsl::elm::OverlayFrame(MakeTitleText(), MakeStatusText())) {}
+        EmuiiboGui() : amiibo_header(new tsl::elm::BigCategoryHeader(MakeActiveAmiiboText(), true)), root_frame(new tsl::elm::OverlayFrame(MakeTitleText(), MakeStatusText())), status_generation(g_status_generation) {}
 
         virtual tsl::elm::Element *createUI() override {
             auto list = new tsl::elm::List();
@@ -207,7 +378,10 @@ class EmuiiboGui : public tsl::Gui {
         }
 
         virtual void update() override {
-            if(g_in_second_menu) {
+            PollStatusChange();
+            if(g_in_second_menu || (this->status_generation != g_status_generation)) {
+                this->status_generation = g_status_generation;
+                amiibo_header->setText(MakeActiveAmiiboText());
                 root_frame->setSubtitle(MakeStatusText());
                 g_in_second_menu = false;
             }
@@ -225,13 +399,17 @@ class Overlay : public tsl::Overlay {
                 }
             });
             if(g_emuiibo_init_ok) {
-                emu::GetActiveVirtualAmiibo(g_active_amiibo);
-                g_amiibo_list = emu::ListAmiibos();
+                g_has_status_change_event = R_SUCCEEDED(emu::GetStatusChangeEvent(g_status_change_event));
+                g_status_sequence_number = emu::GetEmulationStatusSnapshot().sequence_number;
+                UpdateActiveAmiibo();
             }
         }
         
         virtual void exitServices() override {
-            ClearAmiiboList();
+            if(g_has_status_change_event) {
+                eventClose(&g_status_change_event);
+            }
+            g_active_amiibo.Close();
             emu::Exit();
         }
         
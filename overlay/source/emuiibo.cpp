@@ -80,4 +80,67 @@ namespace emu {
         return ver;
     }
 
+    Result OpenVirtualAmiiboById(u64 id, VirtualAmiibo &amiibo) {
+        return serviceDispatchIn(&g_emuiibo_srv, 13, id,
+            .out_num_objects = 1,
+            .out_objects = &amiibo.srv,
+        );
+    }
+
+    Result SetActiveVirtualAmiiboById(u64 id) {
+        return serviceDispatchIn(&g_emuiibo_srv, 14, id);
+    }
+
+    Result GetActiveVirtualAmiiboId(u64 &out_id) {
+        return serviceDispatchOut(&g_emuiibo_srv, 15, out_id);
+    }
+
+    u32 GetVirtualAmiiboIds(u32 offset, u64 *out_ids, size_t out_ids_count) {
+        u32 count = 0;
+        serviceDispatchInOut(&g_emuiibo_srv, 16, offset, count,
+            .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out },
+            .buffers = { { out_ids, out_ids_count * sizeof(u64) } },
+        );
+        return count;
+    }
+
+    Result ListFolder(u64 folder_id, u32 offset, VirtualAmiiboFolderItem *out_items, size_t out_items_count, u32 &out_count, u32 &out_total_count) {
+        const struct {
+            u64 folder_id;
+            u32 offset;
+            u32 pad;
+        } in = { folder_id, offset, 0 };
+        struct {
+            u32 count;
+            u32 total_count;
+        } out = {};
+        auto rc = serviceDispatchInOut(&g_emuiibo_srv, 18, in, out,
+            .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out },
+            .buffers = { { out_items, out_items_count * sizeof(VirtualAmiiboFolderItem) } },
+        );
+        if(R_SUCCEEDED(rc)) {
+            out_count = out.count;
+            out_total_count = out.total_count;
+        }
+        return rc;
+    }
+
+    Result GetStatusChangeEvent(Event &out_event) {
+        Handle event_handle = INVALID_HANDLE;
+        auto rc = serviceDispatch(&g_emuiibo_srv, 19,
+            .out_handle_attrs = { SfOutHandleAttr_HipcCopy },
+            .out_handles = &event_handle,
+        );
+        if(R_SUCCEEDED(rc)) {
+            eventLoadRemote(&out_event, event_handle, true);
+        }
+        return rc;
+    }
+
+    EmulationStatusSnapshot GetEmulationStatusSnapshot() {
+        EmulationStatusSnapshot snapshot = {};
+        serviceDispatchOut(&g_emuiibo_srv, 20, snapshot);
+        return snapshot;
+    }
+
 }
\ No newline at end of file